@@ -0,0 +1,118 @@
+//
+//  AnnexGEquations.swift
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-18.
+//
+
+// Generic versions of the Annex G equations in C57_91_Functions.c. They are written for any ThermalScalar so that the same code can be run with plain Doubles or with DualNumbers (to get derivatives with respect to the design data in a single pass). The names and parameters match the C functions exactly - see C57_91_Functions.h for the descriptions. The C functions remain the reference implementation and are what the regular (Double) calculations use.
+
+import Foundation
+
+enum AnnexG {
+    
+    /// G.2: Bottom Oil Temperature
+    static func Theta_BO<T:ThermalScalar>(_ theta_AO:T, _ delta_theta_ToverB:T) -> T {
+        
+        return theta_AO - delta_theta_ToverB / 2.0
+    }
+    
+    /// G.3: Top Oil Temperature
+    static func Theta_TO<T:ThermalScalar>(_ theta_AO:T, _ delta_theta_ToverB:T) -> T {
+        
+        return theta_AO + delta_theta_ToverB / 2.0
+    }
+    
+    /// G.5: Temperature Correction for Winding Losses
+    static func Kw<T:ThermalScalar>(_ theta_W_R:T, _ theta_W_1:T, _ theta_K:T) -> T {
+        
+        return (theta_W_1 + theta_K) / (theta_W_R + theta_K)
+    }
+    
+    /// G.6: The heat lost by the windings
+    static func QLOST_W<T:ThermalScalar>(_ cType:C57_91_CoolingType, _ Pe:T, _ Pw:T, _ theta_DAO_1:T, _ theta_DAO_R:T, _ theta_W_1:T, _ theta_W_R:T, _ delta_T:T, _ mu_W_1:T, _ mu_W_R:T) -> T {
+        
+        // if the cooling type is ODAF, we ignore the μ values
+        var muFactor:T = 1.0
+        if cType != .ODAF {
+            
+            muFactor = T.Pow(mu_W_R / mu_W_1, 0.25)
+        }
+        
+        return T.Pow((theta_W_1 - theta_DAO_1) / (theta_W_R - theta_DAO_R), 1.25) * muFactor * (Pw + Pe) * delta_T
+    }
+    
+    /// G.7: The mass and thermal capacitance of the windings
+    static func MCp_W<T:ThermalScalar>(_ Pw:T, _ Pe:T, _ tau_W:T, _ theta_DAO_R:T, _ theta_W_R:T) -> T {
+        
+        return tau_W * (Pw + Pe) / (theta_W_R - theta_DAO_R)
+    }
+    
+    /// G.8: The average winding temperature at time t = t2
+    static func Theta_W_2<T:ThermalScalar>(_ QGEN_W:T, _ QLOST_W:T, _ MCp_W:T, _ theta_W_1:T) -> T {
+        
+        return (QGEN_W - QLOST_W + MCp_W * theta_W_1) / MCp_W
+    }
+    
+    /// G.9: The temperature rise of fluid at top of duct over bottom fluid
+    static func Delta_Theta_DOoverBO<T:ThermalScalar>(_ QLOST_W:T, _ x:T, _ delta_T:T, _ Pw:T, _ Pe:T, _ theta_TDO_R:T, _ theta_BO_R:T) -> T {
+        
+        return T.Pow(QLOST_W / (delta_T * (Pw + Pe)), x) * (theta_TDO_R - theta_BO_R)
+    }
+    
+    /// G.10: The temperature rise of oil at winding hot-spot location over bottom oil
+    static func Delta_Theta_WOoverBO<T:ThermalScalar>(_ HHS:T, _ theta_BO:T, _ theta_TDO:T) -> T {
+        
+        return HHS * (theta_TDO - theta_BO)
+    }
+    
+    /// G.16: The heat lost at the hot-spot location (identical to G.6)
+    static func QLOST_HS<T:ThermalScalar>(_ cType:C57_91_CoolingType, _ PEHS:T, _ PHS:T, _ theta_H_1:T, _ theta_H_R:T, _ theta_WO:T, _ theta_WO_R:T, _ delta_T:T, _ mu_HS_1:T, _ mu_HS_R:T) -> T {
+        
+        return QLOST_W(cType, PEHS, PHS, theta_WO, theta_WO_R, theta_H_1, theta_H_R, delta_T, mu_HS_1, mu_HS_R)
+    }
+    
+    /// G.17: The winding hotspot temperature at time t2 (identical to G.8)
+    static func Theta_H_2<T:ThermalScalar>(_ QGEN_HS:T, _ QLOST_HS:T, _ MCp_W:T, _ theta_H_1:T) -> T {
+        
+        return Theta_W_2(QGEN_HS, QLOST_HS, MCp_W, theta_H_1)
+    }
+    
+    /// G.21 Heat lost by the oil
+    static func QLOST_O<T:ThermalScalar>(_ theta_AO_1:T, _ theta_A_1:T, _ theta_AO_R:T, _ theta_A_R:T, _ y:T, _ PT:T, _ delta_T:T) -> T {
+        
+        return T.Pow((theta_AO_1 - theta_A_1) / (theta_AO_R - theta_A_R), 1.0 / y) * PT * delta_T
+    }
+    
+    /// G.24: Total mass times specific heat of oil, tank, and core
+    static func SumMCp<T:ThermalScalar>(_ MTANK:T, _ CPTANK:T, _ MCORE:T, _ CPCORE:T, _ MOIL:T, _ CPOIL:T) -> T {
+        
+        return MTANK * CPTANK + MCORE * CPCORE + MOIL * CPOIL
+    }
+    
+    /// G.25: Average oil temperature at time t2
+    static func Theta_AO_2<T:ThermalScalar>(_ QLOST_W:T, _ QS:T, _ QC:T, _ QLOST_O:T, _ theta_AO_1:T, _ SumMCp:T) -> T {
+        
+        return (QLOST_W + QS + QC - QLOST_O + theta_AO_1 * SumMCp) / SumMCp
+    }
+    
+    /// G.26 Temperature rise of top-oil (radiator) over bottom-oil
+    static func Delta_Theta_ToverB<T:ThermalScalar>(_ QLOST_O:T, _ PT:T, _ delta_T:T, _ z:T, _ theta_TO_R:T, _ theta_BO_R:T) -> T {
+        
+        return T.Pow(QLOST_O / (PT * delta_T), z) * (theta_TO_R - theta_BO_R)
+    }
+    
+    /// G.28 Fluid viscosity at different temperatures
+    static func MU<T:ThermalScalar>(_ fType:C57_91_FluidType, _ theta:T) -> T {
+        
+        let fluid = AppController.StdFluids[Int(fType.rawValue)]
+        
+        return T(fluid.D) * T.Exp(T(fluid.G) / (theta + 273.0))
+    }
+    
+    /// Insulation aging acceleration factor (C57.91-2011 Clause 5.2), for a hot-spot temperature in °C
+    static func F_AA<T:ThermalScalar>(_ theta_H:T) -> T {
+        
+        return T.Exp(T(15000.0 / 383.0) - 15000.0 / (theta_H + 273.0))
+    }
+}
@@ -19,6 +19,7 @@ class AppController: NSObject {
     static var X:[Double] = []
     static var Y:[Double] = []
     static var Z:[Double] = []
+    static var M:[Double] = []
     
     override func awakeFromNib() {
         
@@ -34,10 +35,13 @@ class AppController: NSObject {
         AppController.Y = [onan, onaf, ofaf, odaf]
         (onan, onaf, ofaf, odaf) = C57_91_Z
         AppController.Z = [onan, onaf, ofaf, odaf]
+        (onan, onaf, ofaf, odaf) = C57_91_M
+        AppController.M = [onan, onaf, ofaf, odaf]
     }
 
-    @IBAction func handle_C57_91_Demo(_ sender: Any) {
-                
+    // The example from Annex G of the standard
+    static func C57_91_DemoCase() -> PrecisionValidation.Case {
+        
         let loss = Losses(conductorType: .CU, referenceTemperature: 75.0, coreLoss: 36986.0, coreLossWithOverexcitation: 36986.0, windingResistiveLoss: 51690, windingEddyLoss: 0.0, windingHotspotEddyLossPU: 0.0, strayLoss: 21078.0)
         
         // let temperature = Temperatures(ambientTemperature: 20.0, averageWdgTempRise: 63.0, hotspotWdgTempRise: 80.0, hotSpotLocationPU: 1.0, topOilRise: 55.0, bottomOilRise: 25.0)
@@ -60,6 +64,15 @@ class AppController: NSObject {
         // create an array of load cycles
         let loadCycles:[LoadCycle] = [LoadCycle(cycleStartTime: 0.0, ambient: 30.0, puLoad: 0.73), LoadCycle(cycleStartTime: 1.0, ambient: 29.5, puLoad: 0.64), LoadCycle(cycleStartTime: 6.0, ambient: 28.2, puLoad: 0.56), LoadCycle(cycleStartTime: 7.0, ambient: 29.8, puLoad: 0.62), LoadCycle(cycleStartTime: 10.0, ambient: 35.9, puLoad: 0.88), LoadCycle(cycleStartTime: 13.0, ambient: 39.6, puLoad: 1.03), LoadCycle(cycleStartTime: 14.0, ambient: 40.0, puLoad: 1.07), LoadCycle(cycleStartTime: 15.0, ambient: 40.0, puLoad: 1.1), LoadCycle(cycleStartTime:16.0, ambient: 39.6, puLoad: 1.1), LoadCycle(cycleStartTime: 18.0, ambient: 36.8, puLoad: 1.04), LoadCycle(cycleStartTime: 21.0, ambient: 32.5, puLoad: 0.88), LoadCycle(cycleStartTime: 24.0, ambient: 30.0, puLoad: 0.73)]
         
+        return PrecisionValidation.Case(name: "C57.91", model: model, loadCycles: loadCycles)
+    }
+    
+    @IBAction func handle_C57_91_Demo(_ sender: Any) {
+        
+        let demo = AppController.C57_91_DemoCase()
+        let model = demo.model
+        let loadCycles = demo.loadCycles
+        
         let result = model.DoOverloadCalculations(loadCycles: loadCycles, saveInterval: 0.5)
         
         print(model.OutputAsString())
@@ -67,7 +80,8 @@ class AppController: NSObject {
         // print("Max hotspot temp of \(result.maxWdgHotspot.temp)°C occurs at \(result.maxWdgHotspot.time / 60.0) hours")
     }
     
-    @IBAction func handleT159_Summer(_ sender: Any) {
+    // The summer case from IEEE Std. 1538 (the T159 transformer)
+    static func T159_SummerCase() -> PrecisionValidation.Case {
         
         let loss = Losses(conductorType: .CU, referenceTemperature: 85.0, coreLoss: 4809.0, coreLossWithOverexcitation: 4809.0, windingResistiveLoss: 12360 + 15169, windingEddyLoss: 470 + 303, windingHotspotEddyLossPU: 0.061, strayLoss: 1205)
         
@@ -78,12 +92,22 @@ class AppController: NSObject {
         
         let loadCycles:[LoadCycle] = [LoadCycle(cycleStartTime: 0.0, ambient: testAmb, puLoad: 1.0), LoadCycle(cycleStartTime: 0.5 / 60, ambient: 30.0, puLoad: 1.0), LoadCycle(cycleStartTime: 12.0, ambient: 30.0, puLoad: 1.0), LoadCycle(cycleStartTime: 12.0, ambient: 30.0, puLoad: 1.15), LoadCycle(cycleStartTime: 20.0, ambient: 30.0, puLoad: 1.15), LoadCycle(cycleStartTime: 20.0, ambient: 30.0, puLoad: 1.22), LoadCycle(cycleStartTime: 24.0, ambient: 30.0, puLoad: 1.22), LoadCycle(cycleStartTime: 24.0, ambient: testAmb, puLoad: 1.0)]
         
+        return PrecisionValidation.Case(name: "T159 Sum", model: model, loadCycles: loadCycles)
+    }
+    
+    @IBAction func handleT159_Summer(_ sender: Any) {
+        
+        let t159 = AppController.T159_SummerCase()
+        let model = t159.model
+        let loadCycles = t159.loadCycles
+        
         let result = model.DoOverloadCalculations(loadCycles: loadCycles, saveInterval: 0.25)
         
         print(model.OutputAsString())
     }
     
-    @IBAction func handleT159_Winter(_ sender: Any) {
+    // The winter case from IEEE Std. 1538 (the T159 transformer)
+    static func T159_WinterCase() -> PrecisionValidation.Case {
         
         let loss = Losses(conductorType: .CU, referenceTemperature: 85.0, coreLoss: 4809.0, coreLossWithOverexcitation: 4809.0, windingResistiveLoss: 12360 + 15169, windingEddyLoss: 470 + 303, windingHotspotEddyLossPU: 0.061, strayLoss: 1205)
         
@@ -94,9 +118,38 @@ class AppController: NSObject {
         
         let loadCycles:[LoadCycle] = [LoadCycle(cycleStartTime: 0.0, ambient: testAmb, puLoad: 1.0), LoadCycle(cycleStartTime: 0.5 / 60, ambient: -20.0, puLoad: 1.35), LoadCycle(cycleStartTime: 12.0, ambient: -20.0, puLoad: 1.35), LoadCycle(cycleStartTime: 12.0, ambient: -20.0, puLoad: 1.48), LoadCycle(cycleStartTime: 20.0, ambient: -20.0, puLoad: 1.48), LoadCycle(cycleStartTime: 20.0, ambient: -20.0, puLoad: 1.5), LoadCycle(cycleStartTime: 24.0, ambient: -20.0, puLoad: 1.5), LoadCycle(cycleStartTime: 24.0, ambient: testAmb, puLoad: 1.0)]
         
+        return PrecisionValidation.Case(name: "T159 Win", model: model, loadCycles: loadCycles)
+    }
+    
+    @IBAction func handleT159_Winter(_ sender: Any) {
+        
+        let t159 = AppController.T159_WinterCase()
+        let model = t159.model
+        let loadCycles = t159.loadCycles
+        
         let result = model.DoOverloadCalculations(loadCycles: loadCycles, saveInterval: 0.25)
         
         print(model.OutputAsString())
     }
     
+    @IBAction func handlePrecisionValidation(_ sender: Any) {
+        
+        guard let deviations = PrecisionValidation.Validate(cases: [AppController.C57_91_DemoCase(), AppController.T159_SummerCase(), AppController.T159_WinterCase()]) else {
+            
+            DLog("Could not run the validation cases!")
+            return
+        }
+        
+        print(PrecisionValidation.Report(deviations))
+        
+        // the calibration promises that the last load is held past the end of the load cycles
+        for testCase in [AppController.C57_91_DemoCase(), AppController.T159_SummerCase(), AppController.T159_WinterCase()] {
+            
+            if let rmsError = ThermalCalibration.HeldLoadCheck(testCase) {
+                
+                print(String(format: "%@: held load past the end, RMS difference = %0.3e °C%@", testCase.name, rmsError, rmsError < 1.0E-6 ? "" : " - FAIL"))
+            }
+        }
+    }
+    
 }
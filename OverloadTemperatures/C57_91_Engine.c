@@ -0,0 +1,242 @@
+//
+//  C57_91_Engine.c
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-25.
+//
+
+#include "C57_91_Engine.h"
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdatomic.h>
+
+// The table for C57_91_APPROX_MU_TABLE: μ^(-1/4) (G.28) for each fluid, every MU_TABLE_STEP °C from MU_TABLE_MIN. It is built the first time it is needed.
+#define MU_TABLE_MIN -50.0
+#define MU_TABLE_STEP 0.5
+#define MU_TABLE_SIZE 801
+
+static double MuQuarterTable[C57_91_FLUIDTYPE_LAST_ENTRY][MU_TABLE_SIZE];
+static _Atomic int MuTableState = 0; // 0: not built, 1: being built, 2: ready
+
+/// Build the viscosity table if required
+/// - Returns: true if the table is ready (false if another thread is building it, in which case the caller should use the exact equations)
+static bool MuTableReady(void) {
+    
+    int state = atomic_load_explicit(&MuTableState, memory_order_acquire);
+    if (state == 2) {
+        
+        return true;
+    }
+    
+    int expected = 0;
+    if (state == 0 && atomic_compare_exchange_strong(&MuTableState, &expected, 1)) {
+        
+        for (int fType = MINERAL_OIL; fType < C57_91_FLUIDTYPE_LAST_ENTRY; fType++) {
+            
+            for (int i = 0; i < MU_TABLE_SIZE; i++) {
+                
+                MuQuarterTable[fType][i] = pow(MU((C57_91_FluidType)fType, MU_TABLE_MIN + i * MU_TABLE_STEP), -0.25);
+            }
+        }
+        
+        atomic_store_explicit(&MuTableState, 2, memory_order_release);
+        return true;
+    }
+    
+    return false;
+}
+
+/// μ^(-1/4) from the table (G.28 is used outside the range of the table)
+static inline double TableMuQuarter(C57_91_FluidType fType, double theta) {
+    
+    const double position = (theta - MU_TABLE_MIN) / MU_TABLE_STEP;
+    if (position >= 0.0 && position < MU_TABLE_SIZE - 1) {
+        
+        const int index = (int)position;
+        const double *row = MuQuarterTable[fType];
+        
+        return row[index] + (position - index) * (row[index + 1] - row[index]);
+    }
+    
+    return pow(MU(fType, theta), -0.25);
+}
+
+/// μ from the table
+static inline double TableMU(C57_91_FluidType fType, double theta) {
+    
+    const double quarter = TableMuQuarter(fType, theta);
+    const double half = quarter * quarter;
+    
+    return 1.0 / (half * half);
+}
+
+void C57_91_PrepareDesign(C57_91_Design *design) {
+    
+    design->theta_K = C57_91_StandardConductors[design->wType].Tk;
+    
+    // the rated losses are at the overload kVA base and the rated average winding temperature (see OverloadModel.ComputeStepInvariants())
+    const double kSquared = design->lossK * design->lossK;
+    const double ratedFactor = Kw(design->theta_REF, design->theta_A_R + design->ratedAverageWindingRise, design->theta_K);
+    design->Pw_R = design->Pw * kSquared * ratedFactor;
+    design->Pe_R = design->Pe * kSquared / ratedFactor;
+    design->Ps_R = design->Ps * kSquared / ratedFactor;
+    
+    // the rated hot-spot losses are at the tested hot-spot temperature
+    const double hsFactor = Kw(design->theta_REF, design->theta_H_R, design->theta_K);
+    design->PHS_R = design->Pw * kSquared * hsFactor;
+    design->PEHS_R = design->PHS_R * design->EHS;
+    
+    design->theta_DAO_R = (design->theta_TDO_R + design->theta_BO_R) / 2.0;
+    design->theta_WO_R = design->theta_BO_R + Delta_Theta_WOoverBO(design->HHS, design->theta_BO_R, design->theta_TDO_R);
+    design->theta_AO_R = (design->theta_TO_R + design->theta_BO_R) / 2.0;
+    
+    design->mu_W_R = MU(design->fType, (design->theta_W_R + design->theta_DAO_R) / 2.0);
+    design->mu_HS_R = MU(design->fType, (design->theta_H_R + design->theta_WO_R) / 2.0);
+    
+    // the stability test (G.27) uses the rated (not tested) average winding temperature, the same as OverloadModel.DoOverloadCalculations()
+    design->mu_W_Stability_R = MU(design->fType, (design->theta_A_R + design->ratedAverageWindingRise + design->theta_DAO_R) / 2.0);
+    
+    design->mu_W_R_Quarter = pow(design->mu_W_R, 0.25);
+    design->mu_HS_R_Quarter = pow(design->mu_HS_R, 0.25);
+    
+    const double fluidG = C57_91_StandardFluids[design->fType].G;
+    design->mu_W_R_Exponent = fluidG / ((design->theta_W_R + design->theta_DAO_R) / 2.0 + 273);
+    design->mu_HS_R_Exponent = fluidG / ((design->theta_H_R + design->theta_WO_R) / 2.0 + 273);
+    
+    const C57_91_LossDescriptor losses = {design->theta_K, design->theta_REF, design->Pw, design->Pe, design->Ps, design->EHS};
+    design->losses = losses;
+}
+
+const char *const C57_91_DesignFieldNames[C57_91_DESIGN_FIELDS] = {"cType", "fType", "wType", "x", "y", "z", "lossK", "tau_W", "theta_REF", "Pw", "Pe", "EHS", "Ps", "PC", "PC_OE", "theta_A_R", "theta_W_R", "theta_H_R", "theta_TDO_R", "theta_TO_R", "theta_BO_R", "HHS", "ratedAverageWindingRise", "MCp_W", "SumMCp"};
+
+// The offsets of the fields of a design row that follow the three types
+static const size_t DesignValueOffsets[C57_91_DESIGN_FIELDS - 3] = {offsetof(C57_91_Design, x), offsetof(C57_91_Design, y), offsetof(C57_91_Design, z), offsetof(C57_91_Design, lossK), offsetof(C57_91_Design, tau_W), offsetof(C57_91_Design, theta_REF), offsetof(C57_91_Design, Pw), offsetof(C57_91_Design, Pe), offsetof(C57_91_Design, EHS), offsetof(C57_91_Design, Ps), offsetof(C57_91_Design, PC), offsetof(C57_91_Design, PC_OE), offsetof(C57_91_Design, theta_A_R), offsetof(C57_91_Design, theta_W_R), offsetof(C57_91_Design, theta_H_R), offsetof(C57_91_Design, theta_TDO_R), offsetof(C57_91_Design, theta_TO_R), offsetof(C57_91_Design, theta_BO_R), offsetof(C57_91_Design, HHS), offsetof(C57_91_Design, ratedAverageWindingRise), offsetof(C57_91_Design, MCp_W), offsetof(C57_91_Design, SumMCp)};
+
+// A type field is checked before it is converted (converting a double that is not a number, or is out of the range of int, is undefined behaviour)
+static bool ValidTypeField(double value, int first, int last) {
+    
+    return isfinite(value) && value >= (double)first && value <= (double)last && value == floor(value);
+}
+
+bool C57_91_DesignFromFields(const double *fields, C57_91_Design *design) {
+    
+    memset(design, 0, sizeof(C57_91_Design));
+    
+    if (!ValidTypeField(fields[0], ONAN, ODAF) || !ValidTypeField(fields[1], MINERAL_OIL, C57_91_FLUIDTYPE_LAST_ENTRY - 1) || !ValidTypeField(fields[2], CU, AL)) {
+        
+        return false;
+    }
+    
+    design->cType = (C57_91_CoolingType)(int)fields[0];
+    design->fType = (C57_91_FluidType)(int)fields[1];
+    design->wType = (C57_91_ConductorType)(int)fields[2];
+    
+    for (int i = 0; i < C57_91_DESIGN_FIELDS - 3; i++) {
+        
+        *(double *)((char *)design + DesignValueOffsets[i]) = fields[i + 3];
+    }
+    
+    C57_91_PrepareDesign(design);
+    
+    return true;
+}
+
+void C57_91_DesignToFields(const C57_91_Design *design, double *fields) {
+    
+    fields[0] = (double)design->cType;
+    fields[1] = (double)design->fType;
+    fields[2] = (double)design->wType;
+    
+    for (int i = 0; i < C57_91_DESIGN_FIELDS - 3; i++) {
+        
+        fields[i + 3] = *(const double *)((const char *)design + DesignValueOffsets[i]);
+    }
+}
+
+C57_91_State C57_91_TestedState(const C57_91_Design *design) {
+    
+    C57_91_State result = {design->theta_A_R, design->theta_W_R, design->theta_H_R, design->theta_TDO_R, design->theta_TO_R, design->theta_BO_R};
+    
+    return result;
+}
+
+// True if TestStability() would certainly pass G.27A and G.27B, without calculating the viscosities or calling pow(): a^(1/4)·b^(1/4) is below τW / Δt when a·b is below (τW / Δt)^4, and b (μR / μ) is never more than μR / D, since μ = D·e^(G / (Θ + 273)) is never less than D. The margin is far larger than the rounding of pow(). Anything else (including a temperature ratio that is not positive) is left to TestStability().
+/// - Parameter viscosityRatioBound: μR / D for the average winding and the hot-spot
+static inline bool ClearlyStable(double tau_W, double delta_T, const double *wdgTemp_1, const double *wdgTemp_R, const double *oilTemp_1, const double *oilTemp_R, const double *viscosityRatioBound) {
+    
+    const double testValue = tau_W / delta_T;
+    const double limit = 0.999 * (testValue * testValue) * (testValue * testValue);
+    
+    for (int i = 0; i < 2; i++) {
+        
+        const double temperatureRatio = (wdgTemp_1[i] - oilTemp_1[i]) / (wdgTemp_R[i] - oilTemp_R[i]);
+        
+        if (!(temperatureRatio > 0.0 && temperatureRatio * viscosityRatioBound[i] < limit)) {
+            
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+// The single-precision step and run loop
+#define C57_91_REAL     float
+#define C57_91_POW      powf
+#define C57_91_EXP      expf
+#define C57_91_SQRT     sqrtf
+#define C57_91_STATE    C57_91_StateF
+#define C57_91_STEP     C57_91_StepF
+#define C57_91_STEP_OPTIONS     StepSingle
+#define C57_91_RUN      RunSingle
+#define C57_91_STEP_LOSSES      C57_91_StepLossesF
+#define C57_91_PREPARE_LOSSES   C57_91_PrepareStepLossesF
+#define C57_91_WINDING_HEAT     C57_91_WindingHeatF
+#define C57_91_HOTSPOT_HEAT     C57_91_HotspotHeatF
+#include "C57_91_EngineStep.h"
+
+// The double-precision step and run loop
+#define C57_91_REAL     double
+#define C57_91_POW      pow
+#define C57_91_EXP      exp
+#define C57_91_SQRT     sqrt
+#define C57_91_STATE    C57_91_State
+#define C57_91_STEP     C57_91_Step
+#define C57_91_STEP_OPTIONS     StepDouble
+#define C57_91_RUN      RunDouble
+#define C57_91_STEP_LOSSES      C57_91_StepLosses
+#define C57_91_PREPARE_LOSSES   C57_91_PrepareStepLosses
+#define C57_91_WINDING_HEAT     C57_91_WindingHeat
+#define C57_91_HOTSPOT_HEAT     C57_91_HotspotHeat
+#include "C57_91_EngineStep.h"
+
+void C57_91_Run(const C57_91_Design *design, const C57_91_State *start, const C57_91_ProfilePoint *profile, int count, double delta_T, bool withOverexcitation, C57_91_Precision precision, C57_91_State *trace, double traceInterval, int traceCapacity, C57_91_RunResult *result) {
+    
+    C57_91_RunApproximate(design, start, profile, count, delta_T, withOverexcitation, precision, C57_91_APPROX_NONE, trace, traceInterval, traceCapacity, result);
+}
+
+void C57_91_RunApproximate(const C57_91_Design *design, const C57_91_State *start, const C57_91_ProfilePoint *profile, int count, double delta_T, bool withOverexcitation, C57_91_Precision precision, unsigned int approximations, C57_91_State *trace, double traceInterval, int traceCapacity, C57_91_RunResult *result) {
+    
+    // the exact engine is the fallback, so it is never stopped
+    const bool oscillationGuard = precision == C57_91_SINGLE || approximations != C57_91_APPROX_NONE;
+    bool finished;
+    
+    if (precision == C57_91_SINGLE) {
+        
+        finished = RunSingle(design, start, profile, count, delta_T, withOverexcitation, approximations, oscillationGuard, trace, traceInterval, traceCapacity, result);
+    }
+    else {
+        
+        finished = RunDouble(design, start, profile, count, delta_T, withOverexcitation, approximations, oscillationGuard, trace, traceInterval, traceCapacity, result);
+    }
+    
+    result->exactFallback = !finished;
+    if (!finished) {
+        
+        // the steps of the stopped run are counted too, since they were paid for
+        const int stoppedSteps = result->steps;
+        RunDouble(design, start, profile, count, delta_T, withOverexcitation, C57_91_APPROX_NONE, false, trace, traceInterval, traceCapacity, result);
+        result->steps += stoppedSteps;
+    }
+}
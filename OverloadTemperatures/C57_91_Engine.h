@@ -0,0 +1,232 @@
+//
+//  C57_91_Engine.h
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-25.
+//
+
+// A self-contained native version of the Annex G time-stepping engine (the equivalent of OverloadModel.CalculateTempsForLoadCycle() and DoOverloadCalculations()). The design is described by a single flat struct that holds everything the step needs, including the rated values that do not change during a run, so the inner loop does no allocation and no struct copying. This is the engine to use for large batches (fleets, sweeps, services) and from other languages.
+
+// The engine can run in double precision or in single precision. In single precision, the state and all the equations are evaluated as floats, except for the accumulations that are sensitive to cancellation: the heat balances of G.8, G.17 and G.25 (which subtract two nearly-equal heats and add the result to MCp·Θ) and the aging sum, which are always done in double precision.
+
+#ifndef C57_91_Engine_h
+#define C57_91_Engine_h
+
+#include "C57_91_Functions.h"
+#include "C57_91_StepLosses.h"
+
+// Tell the C++ compiler that this is C code
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The version of the engine's equations and run loop. It is part of every result-cache key and of the header of the on-disk cache (see C57_91_ResultCache.h), so it must be incremented whenever a change to the engine can change the result of a run.
+#define C57_91_ENGINE_VERSION 6
+
+// The precision that the engine uses for the state and the equations
+typedef enum {
+    
+    C57_91_DOUBLE = 0,
+    C57_91_SINGLE
+    
+} C57_91_Precision;
+
+// Approximations that trade accuracy for speed (see C57_91_RunApproximate()). They can be combined with a bitwise OR. The validation harness (validation/C57_91_Validation.c) measures the error and the speedup of each of them against the reference equations.
+#define C57_91_APPROX_NONE          0x00u
+#define C57_91_APPROX_MU_TABLE      0x01u   // fluid viscosities (G.6, G.16, G.27 and G.28) from a table with linear interpolation, instead of exp() and pow()
+#define C57_91_APPROX_LARGE_STEPS   0x04u   // Δt grows while the hot-spot and the top duct oil are settled and the oil next to the hot-spot is clear of its switch, up to half of the G.27 stability limit (but at most C57_91_LARGE_STEP_FACTOR times the starting Δt), and restarts at each profile point (steps end on the profile points, and the step that ends on one is the starting Δt)
+
+// The largest Δt with C57_91_APPROX_LARGE_STEPS, as a multiple of the starting Δt
+#define C57_91_LARGE_STEP_FACTOR 4.0
+
+// With C57_91_APPROX_LARGE_STEPS, Δt only grows after a step in which the hot-spot and top duct oil temperatures changed more slowly than this, °C/min
+#define C57_91_LARGE_STEP_SETTLED 0.1
+
+// With C57_91_APPROX_LARGE_STEPS, Δt does not grow while the top duct oil is within this of the top oil, °C: the oil next to the hot-spot switches between the two there (G.9 to G.11), and a longer step can move the switch by enough to change the maximum hot-spot
+#define C57_91_LARGE_STEP_SWITCH_MARGIN 1.0
+
+// With single precision or any approximation, a run is stopped and redone with the exact engine (double precision, no approximations) if its top duct oil changes direction on C57_91_OSCILLATION_STEPS steps in a row, by more than C57_91_OSCILLATION_AMPLITUDE (°C) each time. G.9 has no time constant, and with some designs the top duct oil overshoots and oscillates from one step to the next: the maximum hot-spot then depends on the phase of the oscillation, which a different Δt or precision does not reproduce (the validation harness measured several °C).
+#define C57_91_OSCILLATION_STEPS 20
+#define C57_91_OSCILLATION_AMPLITUDE 0.1
+
+// Everything the engine needs to know about a transformer. The fields in the first group must be set by the caller, then C57_91_PrepareDesign() must be called to set the rest.
+typedef struct {
+    
+    C57_91_CoolingType cType;
+    C57_91_FluidType fType;
+    C57_91_ConductorType wType;
+    
+    // exponents (G.9, G.21 and G.26)
+    double x;
+    double y;
+    double z;
+    
+    // ratio of the kVA base for the overload to the kVA base for the losses
+    double lossK;
+    
+    // winding time constant, min
+    double tau_W;
+    
+    // losses at the loss reference temperature (theta_REF, °C) and the kVA base for the losses, W
+    double theta_REF;
+    double Pw;
+    double Pe;
+    double EHS; // eddy loss at the hot-spot, per unit of I2R loss (never less than Pe / Pw)
+    double Ps;
+    double PC;
+    double PC_OE;
+    
+    // tested temperatures, °C
+    double theta_A_R;
+    double theta_W_R;
+    double theta_H_R;
+    double theta_TDO_R;
+    double theta_TO_R;
+    double theta_BO_R;
+    double HHS;
+    double ratedAverageWindingRise;
+    
+    // winding mass times specific heat and the sum of the mass times specific heat of the tank, core and fluid, W-min/°C
+    double MCp_W;
+    double SumMCp;
+    
+    // Set by C57_91_PrepareDesign(): the rated losses (at the overload kVA base and the rated average winding temperature), the rated hot-spot losses (at the tested hot-spot temperature), the rated fluid temperatures and the rated viscosities
+    double theta_K;
+    double Pw_R;
+    double Pe_R;
+    double Ps_R;
+    double PHS_R;
+    double PEHS_R;
+    double theta_DAO_R;
+    double theta_WO_R;
+    double theta_AO_R;
+    double mu_W_R;
+    double mu_HS_R;
+    double mu_W_Stability_R;
+    
+    // the rated viscosities to the power 1/4 (for C57_91_APPROX_MU_TABLE)
+    double mu_W_R_Quarter;
+    double mu_HS_R_Quarter;
+    
+    // G / (Θ + 273) at the temperatures of the rated viscosities (μ = D·e^(G / (Θ + 273)), so (μR / μ)^(1/4) in G.6 and G.16 is a single exponential)
+    double mu_W_R_Exponent;
+    double mu_HS_R_Exponent;
+    
+    // the descriptor for the fused loss kernel (C57_91_StepLosses.h), with the load and Δt of a step still to be folded in
+    C57_91_LossDescriptor losses;
+    
+} C57_91_Design;
+
+// The state of the transformer (double precision)
+typedef struct {
+    
+    double theta_A;
+    double theta_W;
+    double theta_H;
+    double theta_TDO;
+    double theta_TO;
+    double theta_BO;
+    
+} C57_91_State;
+
+// The state of the transformer (single precision)
+typedef struct {
+    
+    float theta_A;
+    float theta_W;
+    float theta_H;
+    float theta_TDO;
+    float theta_TO;
+    float theta_BO;
+    
+} C57_91_StateF;
+
+// One point of a load profile. The load and ambient vary linearly between points (a step change is two points with the same time).
+typedef struct {
+    
+    double time; // min
+    double K; // per unit of the overload kVA base
+    double theta_A; // °C
+    
+} C57_91_ProfilePoint;
+
+// The result of a run
+typedef struct {
+    
+    double maxHotspot;
+    double maxHotspotTime;
+    double maxTopOil;
+    double maxTopOilTime;
+    double maxAverageWinding;
+    double maxAverageWindingTime;
+    double agingFactor;
+    
+    // the state at the end of the run, the Δt that was in use, and the number of steps
+    C57_91_State finalState;
+    double finalDeltaT;
+    int steps;
+    
+    // the number of entries written to the trace
+    int traceCount;
+    
+    // true if the run was redone with the exact engine because the top duct oil oscillated (see C57_91_OSCILLATION_STEPS)
+    bool exactFallback;
+    
+} C57_91_RunResult;
+
+/// Calculate the derived fields of a design (must be called once after the caller's fields are set, and again if any of them change)
+void C57_91_PrepareDesign(C57_91_Design *_Nonnull design);
+
+// The number of fields in a design row: the caller's fields of C57_91_Design, in declaration order, with the three types first (as whole numbers). This is the layout that the Python module, the rating daemon and the result-cache key all use.
+#define C57_91_DESIGN_FIELDS 25
+
+// The names of the fields of a design row, in order
+extern const char *const _Nonnull C57_91_DesignFieldNames[C57_91_DESIGN_FIELDS];
+
+/// Set the caller's fields of a design from a design row, then prepare it (see C57_91_PrepareDesign())
+/// - Parameter fields: the C57_91_DESIGN_FIELDS values of the row
+/// - Parameter design: the design to set (it is cleared first)
+/// - Returns: false if any of the types is not finite, not a whole number or out of range (the design is not prepared)
+bool C57_91_DesignFromFields(const double *_Nonnull fields, C57_91_Design *_Nonnull design);
+
+/// The design row of a design (the inverse of C57_91_DesignFromFields())
+/// - Parameter design: the design
+/// - Parameter fields: the C57_91_DESIGN_FIELDS values of the row
+void C57_91_DesignToFields(const C57_91_Design *_Nonnull design, double *_Nonnull fields);
+
+/// The starting state at the tested temperatures
+C57_91_State C57_91_TestedState(const C57_91_Design *_Nonnull design);
+
+/// One Annex G step in double precision (the same equations as OverloadModel.CalculateTempsForLoadCycle())
+/// - Parameter design: the prepared design
+/// - Parameter state: the state at the start of the step, replaced by the state at the end of the step
+/// - Parameter K: the load at the end of the step, per unit of the overload kVA base
+/// - Parameter theta_A_2: the ambient at the end of the step, °C
+/// - Parameter delta_T: the step length, min
+/// - Parameter withOverexcitation: use the core losses with overexcitation
+void C57_91_Step(const C57_91_Design *_Nonnull design, C57_91_State *_Nonnull state, double K, double theta_A_2, double delta_T, bool withOverexcitation);
+
+/// One Annex G step in single precision (with the heat balances in double precision)
+void C57_91_StepF(const C57_91_Design *_Nonnull design, C57_91_StateF *_Nonnull state, float K, float theta_A_2, float delta_T, bool withOverexcitation);
+
+/// Run a load profile (the equivalent of OverloadModel.DoOverloadCalculations()).
+/// - Parameter design: the prepared design
+/// - Parameter start: the starting state
+/// - Parameter profile: the profile points (the first one must be at time 0)
+/// - Parameter count: the number of profile points (at least 1)
+/// - Parameter delta_T: the starting Δt (it is reduced if required by G.27), min
+/// - Parameter withOverexcitation: use the core losses with overexcitation
+/// - Parameter precision: the precision to use
+/// - Parameter trace: if non-NULL, the state is saved here every 'traceInterval' minutes (starting at time 0), up to 'traceCapacity' entries
+void C57_91_Run(const C57_91_Design *_Nonnull design, const C57_91_State *_Nonnull start, const C57_91_ProfilePoint *_Nonnull profile, int count, double delta_T, bool withOverexcitation, C57_91_Precision precision, C57_91_State *_Nullable trace, double traceInterval, int traceCapacity, C57_91_RunResult *_Nonnull result);
+
+/// Run a load profile with approximations (the arguments are the same as C57_91_Run(), with the addition of 'approximations'). With C57_91_APPROX_NONE, this is identical to C57_91_Run(). With single precision or any approximation, a run whose top duct oil oscillates is redone with the exact engine (see C57_91_OSCILLATION_STEPS).
+/// - Parameter approximations: a combination of the C57_91_APPROX_ flags
+void C57_91_RunApproximate(const C57_91_Design *_Nonnull design, const C57_91_State *_Nonnull start, const C57_91_ProfilePoint *_Nonnull profile, int count, double delta_T, bool withOverexcitation, C57_91_Precision precision, unsigned int approximations, C57_91_State *_Nullable trace, double traceInterval, int traceCapacity, C57_91_RunResult *_Nonnull result);
+
+// Close the braces for extern "C"
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* C57_91_Engine_h */
@@ -0,0 +1,308 @@
+//
+//  C57_91_EngineStep.h
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-25.
+//
+
+// NOTE: This is not a normal header file. It holds the body of the step and the run loop of the engine, written once for both precisions, and it is included (twice) only by C57_91_Engine.c. Before each inclusion, the following macros must be defined:
+//
+//  C57_91_REAL     the floating-point type of the state and the equations (float or double)
+//  C57_91_POW      the pow() function for that type
+//  C57_91_EXP      the exp() function for that type
+//  C57_91_SQRT     the sqrt() function for that type
+//  C57_91_STATE    the state type (C57_91_StateF or C57_91_State)
+//  C57_91_STEP     the name of the step function
+//  C57_91_STEP_OPTIONS the name of the (internal) step function that takes the approximations
+//  C57_91_RUN      the name of the run function
+//  C57_91_STEP_LOSSES, C57_91_PREPARE_LOSSES, C57_91_WINDING_HEAT and C57_91_HOTSPOT_HEAT
+//                  the loss kernel for that type (see C57_91_StepLosses.h)
+//
+// All the macros are undefined at the end of this file.
+
+static inline void C57_91_STEP_OPTIONS(const C57_91_Design *design, C57_91_STATE *state, C57_91_REAL K, C57_91_REAL theta_A_2, C57_91_REAL delta_T, bool withOverexcitation, bool muTable) {
+    
+    const C57_91_REAL fluidG = (C57_91_REAL)C57_91_StandardFluids[design->fType].G;
+    
+    const C57_91_REAL ratedWindingLoss = (C57_91_REAL)(design->Pw_R + design->Pe_R);
+    
+    // G.4, G.5 & G.19: heat generated by the windings and by the stray loss (both at the average winding temperature)
+    const C57_91_STEP_LOSSES losses = C57_91_PREPARE_LOSSES(design->losses, K * (C57_91_REAL)design->lossK, delta_T);
+    C57_91_REAL QS;
+    const C57_91_REAL QGEN_W = C57_91_WINDING_HEAT(losses, state->theta_W, &QS);
+    
+    // G.6: heat lost by the windings
+    const C57_91_REAL theta_DAO = (state->theta_TDO + state->theta_BO) / 2;
+    C57_91_REAL QLOST_W = 0;
+    if (state->theta_W > theta_DAO) {
+        
+        C57_91_REAL muFactor = 1;
+        if (design->cType != ODAF && muTable) {
+            
+            muFactor = (C57_91_REAL)(design->mu_W_R_Quarter * TableMuQuarter(design->fType, (double)((state->theta_W + theta_DAO) / 2)));
+        }
+        else if (design->cType != ODAF) {
+            
+            // (μR / μ)^(1/4), with the D of both viscosities cancelled
+            muFactor = C57_91_EXP((C57_91_REAL)0.25 * ((C57_91_REAL)design->mu_W_R_Exponent - fluidG / ((state->theta_W + theta_DAO) / 2 + 273)));
+        }
+        
+        // the power 1.25 is x·√√x
+        const C57_91_REAL riseRatio = (state->theta_W - theta_DAO) / (C57_91_REAL)(design->theta_W_R - design->theta_DAO_R);
+        QLOST_W = riseRatio * C57_91_SQRT(C57_91_SQRT(riseRatio)) * muFactor * ratedWindingLoss * delta_T;
+    }
+    
+    // G.8: the heat balance is always done in double precision
+    const double theta_W_1 = state->theta_W > state->theta_BO ? state->theta_W : state->theta_BO;
+    const C57_91_REAL theta_W_2 = (C57_91_REAL)(((double)QGEN_W - (double)QLOST_W + design->MCp_W * theta_W_1) / design->MCp_W);
+    
+    // G.9 to G.11: duct oil and the oil adjacent to the hot-spot
+    const C57_91_REAL rise = C57_91_POW(QLOST_W / (delta_T * ratedWindingLoss), (C57_91_REAL)design->x) * (C57_91_REAL)(design->theta_TDO_R - design->theta_BO_R);
+    C57_91_REAL theta_TDO_2 = state->theta_BO + rise;
+    const C57_91_REAL theta_WO = (theta_TDO_2 + (C57_91_REAL)0.1) < state->theta_TO ? state->theta_TO : state->theta_BO + (C57_91_REAL)design->HHS * rise;
+    
+    C57_91_REAL theta_H_fixed = state->theta_H;
+    if (theta_W_2 > theta_H_fixed) {
+        
+        theta_H_fixed = theta_W_2;
+    }
+    if (theta_WO > theta_H_fixed) {
+        
+        theta_H_fixed = theta_WO;
+    }
+    
+    // G.12 to G.15: heat generated at the hot-spot (the hot-spot eddy loss is corrected like the I2R loss, as in Losses.windingHotspotLoss)
+    const C57_91_REAL QGEN_HS = C57_91_HOTSPOT_HEAT(losses, theta_H_fixed);
+    
+    // G.16: heat lost at the hot-spot
+    C57_91_REAL muHsFactor = 1;
+    if (design->cType != ODAF && muTable) {
+        
+        muHsFactor = (C57_91_REAL)(design->mu_HS_R_Quarter * TableMuQuarter(design->fType, (double)((theta_H_fixed + theta_WO) / 2)));
+    }
+    else if (design->cType != ODAF) {
+        
+        muHsFactor = C57_91_EXP((C57_91_REAL)0.25 * ((C57_91_REAL)design->mu_HS_R_Exponent - fluidG / ((theta_H_fixed + theta_WO) / 2 + 273)));
+    }
+    
+    const C57_91_REAL hotspotRiseRatio = (theta_H_fixed - theta_WO) / (C57_91_REAL)(design->theta_H_R - design->theta_WO_R);
+    const C57_91_REAL QLOST_HS = hotspotRiseRatio * C57_91_SQRT(C57_91_SQRT(hotspotRiseRatio)) * muHsFactor * (C57_91_REAL)(design->PHS_R + design->PEHS_R) * delta_T;
+    
+    // G.17 (double precision heat balance)
+    const C57_91_REAL theta_H_2 = (C57_91_REAL)(((double)QGEN_HS - (double)QLOST_HS + design->MCp_W * (double)state->theta_H) / design->MCp_W);
+    
+    // G.20 & G.21: heat lost to the ambient
+    const double ratedCoreLoss = withOverexcitation ? (design->PC_OE > design->PC ? design->PC_OE : design->PC) : design->PC;
+    const C57_91_REAL PT = (C57_91_REAL)(design->Pw_R + design->Pe_R + design->Ps_R + ratedCoreLoss);
+    const C57_91_REAL theta_AO = (state->theta_TO + state->theta_BO) / 2;
+    const C57_91_REAL QLOST_O = C57_91_POW((theta_AO - state->theta_A) / (C57_91_REAL)(design->theta_AO_R - design->theta_A_R), 1 / (C57_91_REAL)design->y) * PT * delta_T;
+    
+    // G.18: same (inverted) selection of the core loss as OverloadModel.CalculateTempsForLoadCycle()
+    const C57_91_REAL QC = delta_T * (C57_91_REAL)(withOverexcitation ? design->PC : design->PC_OE);
+    
+    // G.25 (double precision heat balance)
+    const double theta_AO_2 = ((double)QLOST_W + (double)QS + (double)QC - (double)QLOST_O + (double)theta_AO * design->SumMCp) / design->SumMCp;
+    
+    // G.26, G.23 & G.24
+    const C57_91_REAL riseToverB = C57_91_POW(QLOST_O / (PT * delta_T), (C57_91_REAL)design->z) * (C57_91_REAL)(design->theta_TO_R - design->theta_BO_R);
+    const C57_91_REAL theta_TO_2 = (C57_91_REAL)theta_AO_2 + riseToverB / 2;
+    C57_91_REAL theta_BO_2 = (C57_91_REAL)theta_AO_2 - riseToverB / 2;
+    if (theta_BO_2 < theta_A_2) {
+        
+        theta_BO_2 = theta_A_2;
+    }
+    
+    if (theta_TDO_2 < theta_BO_2) {
+        
+        theta_TDO_2 = theta_BO_2;
+    }
+    
+    state->theta_A = theta_A_2;
+    state->theta_W = theta_W_2;
+    state->theta_H = theta_H_2;
+    state->theta_TDO = theta_TDO_2;
+    state->theta_TO = theta_TO_2;
+    state->theta_BO = theta_BO_2;
+}
+
+void C57_91_STEP(const C57_91_Design *design, C57_91_STATE *state, C57_91_REAL K, C57_91_REAL theta_A_2, C57_91_REAL delta_T, bool withOverexcitation) {
+    
+    C57_91_STEP_OPTIONS(design, state, K, theta_A_2, delta_T, withOverexcitation, false);
+}
+
+// Returns false if 'oscillationGuard' is set and the run was stopped because the top duct oil oscillated (the result then holds the partial run)
+static bool C57_91_RUN(const C57_91_Design *design, const C57_91_State *start, const C57_91_ProfilePoint *profile, int count, double delta_T, bool withOverexcitation, unsigned int approximations, bool oscillationGuard, C57_91_State *trace, double traceInterval, int traceCapacity, C57_91_RunResult *result) {
+    
+    C57_91_STATE state = {(C57_91_REAL)start->theta_A, (C57_91_REAL)start->theta_W, (C57_91_REAL)start->theta_H, (C57_91_REAL)start->theta_TDO, (C57_91_REAL)start->theta_TO, (C57_91_REAL)start->theta_BO};
+    
+    result->maxHotspot = start->theta_H;
+    result->maxHotspotTime = 0.0;
+    result->maxTopOil = start->theta_TO;
+    result->maxTopOilTime = 0.0;
+    result->maxAverageWinding = start->theta_W;
+    result->maxAverageWindingTime = 0.0;
+    result->steps = 0;
+    result->traceCount = 0;
+    
+    const bool muTable = (approximations & C57_91_APPROX_MU_TABLE) != 0 && MuTableReady();
+    const bool largeSteps = (approximations & C57_91_APPROX_LARGE_STEPS) != 0;
+    
+    double currentDeltaT = delta_T > 0.0 ? delta_T : 0.5;
+    const double largestDeltaT = C57_91_LARGE_STEP_FACTOR * currentDeltaT;
+    double maxDeltaT = 0.0;
+    if (!TestStability(true, design->cType, design->tau_W, currentDeltaT, &maxDeltaT, NULL, NULL, NULL, NULL, NULL, NULL)) {
+        
+        currentDeltaT = maxDeltaT;
+    }
+    
+    const double startDeltaT = currentDeltaT;
+    
+    double wdgTempR[2] = {design->theta_A_R + design->ratedAverageWindingRise, design->theta_H_R};
+    double oilTempR[2] = {design->theta_DAO_R, design->theta_WO_R};
+    double viscosityR[2] = {design->mu_W_Stability_R, design->mu_HS_R};
+    const double viscosityRatioBound[2] = {design->mu_W_Stability_R / C57_91_StandardFluids[design->fType].D, design->mu_HS_R / C57_91_StandardFluids[design->fType].D};
+    
+    double lastTime = -currentDeltaT;
+    double currentTime = 0.0;
+    double nextTraceTime = 0.0;
+    const double endTime = profile[count - 1].time;
+    double agingSum = 0.0;
+    double lastTopDuctOilChange = 0.0;
+    int reversals = 0;
+    
+    for (int segment = 0; segment < count - 1; segment++) {
+        
+        const double segmentLength = profile[segment + 1].time - profile[segment].time > 1.0E-12 ? profile[segment + 1].time - profile[segment].time : 1.0E-12;
+        const double loadSlope = (profile[segment + 1].K - profile[segment].K) / segmentLength;
+        const double ambientSlope = (profile[segment + 1].theta_A - profile[segment].theta_A) / segmentLength;
+        
+        while (currentTime < profile[segment + 1].time && currentTime < endTime) {
+            
+            const double K = profile[segment].K + loadSlope * (currentTime - profile[segment].time);
+            const double theta_A_2 = state.theta_A + ambientSlope * (currentTime - lastTime);
+            
+            const C57_91_REAL lastHotspot = state.theta_H;
+            const C57_91_REAL lastTopDuctOil = state.theta_TDO;
+            C57_91_STEP_OPTIONS(design, &state, (C57_91_REAL)K, (C57_91_REAL)theta_A_2, (C57_91_REAL)(currentTime - lastTime), withOverexcitation, muTable);
+            result->steps += 1;
+            
+            if (oscillationGuard) {
+                
+                const double topDuctOilChange = (double)state.theta_TDO - (double)lastTopDuctOil;
+                reversals = topDuctOilChange * lastTopDuctOilChange < 0.0 && fabs(topDuctOilChange) > C57_91_OSCILLATION_AMPLITUDE ? reversals + 1 : 0;
+                lastTopDuctOilChange = topDuctOilChange;
+                
+                if (reversals >= C57_91_OSCILLATION_STEPS) {
+                    
+                    return false;
+                }
+            }
+            
+            // the aging sum is always accumulated in double precision
+            const C57_91_REAL agingExponent = (C57_91_REAL)(15000.0 / 383.0) - (C57_91_REAL)15000.0 / (state.theta_H + 273);
+            agingSum += (double)C57_91_EXP(agingExponent) * (largeSteps ? currentTime - lastTime : currentDeltaT);
+            
+            if (state.theta_H > result->maxHotspot) {
+                
+                result->maxHotspot = state.theta_H;
+                result->maxHotspotTime = currentTime;
+            }
+            
+            if (state.theta_TO > result->maxTopOil) {
+                
+                result->maxTopOil = state.theta_TO;
+                result->maxTopOilTime = currentTime;
+            }
+            
+            if (state.theta_W > result->maxAverageWinding) {
+                
+                result->maxAverageWinding = state.theta_W;
+                result->maxAverageWindingTime = currentTime;
+            }
+            
+            if (trace != NULL && result->traceCount < traceCapacity && currentTime >= nextTraceTime) {
+                
+                C57_91_State traceState = {state.theta_A, state.theta_W, state.theta_H, state.theta_TDO, state.theta_TO, state.theta_BO};
+                trace[result->traceCount] = traceState;
+                result->traceCount += 1;
+                nextTraceTime += traceInterval;
+            }
+            
+            // G.27A & G.27B
+            const double theta_DAO = ((double)state.theta_TDO + (double)state.theta_BO) / 2.0;
+            const double theta_WO = (double)state.theta_BO + design->HHS * ((double)state.theta_TDO - (double)state.theta_BO);
+            double wdgTemp1[2] = {state.theta_W, state.theta_H};
+            double oilTemp1[2] = {theta_DAO, theta_WO};
+            
+            // with large steps, the stability limit is needed on every step; otherwise G.27 is only evaluated when the step might be unstable
+            bool stable = !largeSteps && design->cType != ODAF && ClearlyStable(design->tau_W, currentDeltaT, wdgTemp1, wdgTempR, oilTemp1, oilTempR, viscosityRatioBound);
+            if (!stable) {
+                
+                double viscosity1[2];
+                if (muTable) {
+                    
+                    viscosity1[0] = TableMU(design->fType, (wdgTemp1[0] + theta_DAO) / 2.0);
+                    viscosity1[1] = TableMU(design->fType, (wdgTemp1[1] + theta_WO) / 2.0);
+                }
+                else {
+                    
+                    viscosity1[0] = MU(design->fType, (wdgTemp1[0] + theta_DAO) / 2.0);
+                    viscosity1[1] = MU(design->fType, (wdgTemp1[1] + theta_WO) / 2.0);
+                }
+                
+                stable = TestStability(false, design->cType, design->tau_W, currentDeltaT, &maxDeltaT, wdgTemp1, wdgTempR, oilTemp1, oilTempR, viscosity1, viscosityR);
+            }
+            
+            if (largeSteps) {
+                
+                // grow Δt while the hot-spot and the top duct oil are settled and the oil next to the hot-spot is clear of its switch, and go back to the starting Δt as soon as either moves (G.9 makes the top duct oil lag by one step, whatever the step length). maxDeltaT is the stability limit whether or not the current Δt is stable.
+                const double hotspotRate = fabs((double)state.theta_H - (double)lastHotspot) / (currentTime - lastTime);
+                const double topDuctOilRate = fabs((double)state.theta_TDO - (double)lastTopDuctOil) / (currentTime - lastTime);
+                const bool nearSwitch = fabs((double)state.theta_TDO + 0.1 - (double)state.theta_TO) < C57_91_LARGE_STEP_SWITCH_MARGIN;
+                currentDeltaT = !nearSwitch && hotspotRate < C57_91_LARGE_STEP_SETTLED && topDuctOilRate < C57_91_LARGE_STEP_SETTLED ? currentDeltaT * 1.5 : startDeltaT;
+                currentDeltaT = fmin(currentDeltaT, fmin(0.5 * maxDeltaT, largestDeltaT));
+            }
+            else if (!stable) {
+                
+                currentDeltaT = maxDeltaT;
+            }
+            
+            lastTime = currentTime;
+            currentTime += currentDeltaT;
+            
+            // with large steps, a step never jumps over a profile point, and the load can change there, so Δt restarts. The step that ends on the point takes the load after it (G.4 uses the load at the end of the step), so it is no longer than the starting Δt, the same as with the exact engine.
+            const double approachTime = profile[segment + 1].time - startDeltaT;
+            if (largeSteps && currentTime > approachTime && approachTime - lastTime > 1.0E-9) {
+                
+                currentTime = approachTime;
+                currentDeltaT = fmin(currentDeltaT, startDeltaT);
+            }
+            else if (largeSteps && currentTime >= profile[segment + 1].time) {
+                
+                currentTime = profile[segment + 1].time;
+                currentDeltaT = fmin(currentDeltaT, startDeltaT);
+            }
+        }
+    }
+    
+    result->agingFactor = currentTime > 0.0 ? agingSum / currentTime : 1.0;
+    result->finalDeltaT = currentDeltaT;
+    
+    C57_91_State finalState = {state.theta_A, state.theta_W, state.theta_H, state.theta_TDO, state.theta_TO, state.theta_BO};
+    result->finalState = finalState;
+    
+    return true;
+}
+
+#undef C57_91_REAL
+#undef C57_91_POW
+#undef C57_91_EXP
+#undef C57_91_SQRT
+#undef C57_91_STATE
+#undef C57_91_STEP
+#undef C57_91_STEP_OPTIONS
+#undef C57_91_RUN
+#undef C57_91_STEP_LOSSES
+#undef C57_91_PREPARE_LOSSES
+#undef C57_91_WINDING_HEAT
+#undef C57_91_HOTSPOT_HEAT
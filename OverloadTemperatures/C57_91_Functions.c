@@ -18,6 +18,9 @@ const double C57_91_X[4] = {0.5, 0.5, 0.5, 1.0};
 const double C57_91_Y[4] = {0.8, 0.9, 0.9, 1.0};
 const double C57_91_Z[4] = {0.5, 0.5, 1.0, 1.0};
 
+// Typical exponent of winding hot-spot rise with load for the Clause 7 method. Use C57_91_CoolingType as the index into the array.
+const double C57_91_M[4] = {0.8, 0.8, 0.8, 1.0};
+
 
 /* Function G.1: Hottest-spot temperature
 
@@ -667,3 +670,146 @@ double MU(C57_91_FluidType fType, double theta) {
     
     return result;
 }
+
+/* Clause 7: Ultimate top-oil rise over ambient for a load K
+ 
+ ΔΘTO,U = ΔΘTO,R * ((K^2 * R + 1) / (R + 1))^n
+ 
+ Where:
+ K is the ratio of load L to rated load, per unit
+ R is the ratio of load loss at rated load to no-load loss
+ n is the exponent of top-oil rise with losses (0.8 for ONAN, 0.9 for ONAF and OFAF, and 1.0 for ODAF)
+ ΔΘTO,R is the top-oil rise over ambient at rated load, °C
+ 
+ Returns:
+ ΔΘTO,U, which is the ultimate top-oil rise over ambient for load K, °C
+ 
+ */
+double Delta_Theta_TO_U(double delta_theta_TO_R, double K, double R, double n) {
+    
+    double result = delta_theta_TO_R * pow((K * K * R + 1.0) / (R + 1.0), n);
+    
+    return result;
+}
+
+/* Clause 7: Ultimate winding hottest-spot rise over top-oil for a load K
+ 
+ ΔΘH,U = ΔΘH,R * K^2m
+ 
+ Where:
+ K is the ratio of load L to rated load, per unit
+ m is the exponent of winding hottest-spot rise with load (0.8 for ONAN, ONAF and OFAF, and 1.0 for ODAF)
+ ΔΘH,R is the winding hottest-spot rise over top-oil at rated load, °C
+ 
+ Returns:
+ ΔΘH,U, which is the ultimate winding hottest-spot rise over top-oil for load K, °C
+ 
+ */
+double Delta_Theta_H_U(double delta_theta_H_R, double K, double m) {
+    
+    double result = delta_theta_H_R * pow(K * K, m);
+    
+    return result;
+}
+
+/* Clause 7: Thermal capacity of the transformer
+ 
+ C = 0.0272 * WCC + 0.01814 * WTANK + 5.034 * gallons (ONAN and ONAF)
+ C = 0.0272 * WCC + 0.0272 * WTANK + 7.305 * gallons (OFAF and ODAF)
+ 
+ Where:
+ WCC is the weight of core and coil assembly, lb
+ WTANK is the weight of tank and fittings, lb
+ gallons is the volume of fluid, gallons
+ 
+ Returns:
+ C, which is the thermal capacity of the transformer, W-h/°C
+ 
+ */
+double C_THERMAL(double WCC, double WTANK, double gallons, bool forcedOil) {
+    
+    if (forcedOil) {
+        
+        return 0.0272 * WCC + 0.0272 * WTANK + 7.305 * gallons;
+    }
+    
+    return 0.0272 * WCC + 0.01814 * WTANK + 5.034 * gallons;
+}
+
+/* Clause 7: Top-oil time constant at rated load
+ 
+ τTO,R = C * ΔΘTO,R / PT,R
+ 
+ Where:
+ C is the thermal capacity of the transformer, W-h/°C
+ PT,R is the total loss at rated load, W
+ ΔΘTO,R is the top-oil rise over ambient at rated load, °C
+ 
+ Returns:
+ τTO,R, which is the top-oil time constant at rated load, min (NOTE: The standard gives the result in hours. We convert it to minutes to be consistent with the rest of the library.)
+ 
+ */
+double Tau_TO_R(double C, double delta_theta_TO_R, double PT_R) {
+    
+    double result = 60.0 * C * delta_theta_TO_R / PT_R;
+    
+    return result;
+}
+
+/* Clause 7: Top-oil time constant for a load step
+ 
+ τTO = τTO,R * (ΔΘTO,U / ΔΘTO,R - ΔΘTO,i / ΔΘTO,R) / ((ΔΘTO,U / ΔΘTO,R)^1/n - (ΔΘTO,i / ΔΘTO,R)^1/n)
+ 
+ Where:
+ n is the exponent of top-oil rise with losses
+ τTO,R is the top-oil time constant at rated load, min
+ ΔΘTO,U is the ultimate top-oil rise over ambient for the new load, °C
+ ΔΘTO,i is the initial top-oil rise over ambient, °C
+ ΔΘTO,R is the top-oil rise over ambient at rated load, °C
+ 
+ Returns:
+ τTO, which is the top-oil time constant for the load step, min (NOTE: The expression is indeterminate if n = 1 or if the initial and ultimate rises are equal. The rated time constant is returned in those cases, which is the correct limit.)
+ 
+ */
+double Tau_TO(double tau_TO_R, double delta_theta_TO_U, double delta_theta_TO_i, double delta_theta_TO_R, double n) {
+    
+    double uPU = delta_theta_TO_U / delta_theta_TO_R;
+    double iPU = delta_theta_TO_i / delta_theta_TO_R;
+    
+    if (n == 1.0 || uPU <= 0.0 || iPU < 0.0 || fabs(uPU - iPU) < 1.0E-9) {
+        
+        return tau_TO_R;
+    }
+    
+    double denominator = pow(uPU, 1.0 / n) - pow(iPU, 1.0 / n);
+    
+    if (fabs(denominator) < 1.0E-12) {
+        
+        return tau_TO_R;
+    }
+    
+    double result = tau_TO_R * (uPU - iPU) / denominator;
+    
+    return result;
+}
+
+/* Clause 7: Exponential response of a temperature rise
+ 
+ ΔΘ = (ΔΘU - ΔΘi) * (1 - exp(-t / τ)) + ΔΘi
+ 
+ Where:
+ t is the elapsed time, min
+ τ is the time constant (τTO for top-oil, τW for the winding hottest-spot), min
+ ΔΘU is the ultimate rise, °C
+ ΔΘi is the initial rise, °C
+ 
+ Returns:
+ ΔΘ, which is the rise after time t, °C
+ 
+ */
+double Delta_Theta_Exponential(double delta_theta_U, double delta_theta_i, double t, double tau) {
+    
+    double result = (delta_theta_U - delta_theta_i) * (1.0 - exp(-t / tau)) + delta_theta_i;
+    
+    return result;
+}
@@ -130,6 +130,9 @@ extern const double C57_91_X[4];
 extern const double C57_91_Y[4];
 extern const double C57_91_Z[4];
 
+// Typical exponents for the Clause 7 method. The exponent of top-oil rise with losses ('n') is identical to the Annex G 'y' exponent, so only the exponent of winding hot-spot rise with load ('m') is defined here. Use C57_91_CoolingType as the index.
+extern const double C57_91_M[4];
+
 // 'Standard' exponents to be used when test data is not available
 // extern const
 
@@ -380,6 +383,55 @@ bool TestStability(bool useSimplified, C57_91_CoolingType cType, double tau_W, d
 /// - Returns: the viscosity of oil, centipoises
 double MU(C57_91_FluidType fType, double theta);
 
+// Clause 7 (exponential) equations. These are the "simple" top-oil and hot-spot equations that are used as an alternative to the Annex G heat-balance equations. They are much cheaper to evaluate and are exact for any step length (for constant load), so they are used for fast screening.
+
+/// Clause 7: Ultimate top-oil rise over ambient for a load K
+/// - Parameter delta_theta_TO_R: the top-oil rise over ambient at rated load, °C
+/// - Parameter K: the ratio of load L to rated load, per unit
+/// - Parameter R: the ratio of load loss at rated load to no-load loss
+/// - Parameter n: the exponent of top-oil rise with losses (same as the Annex G exponent 'y')
+/// - Returns: The ultimate top-oil rise over ambient for load K, °C
+double Delta_Theta_TO_U(double delta_theta_TO_R, double K, double R, double n);
+
+/// Clause 7: Ultimate winding hottest-spot rise over top-oil for a load K
+/// - Parameter delta_theta_H_R: the winding hottest-spot rise over top-oil at rated load, °C
+/// - Parameter K: the ratio of load L to rated load, per unit
+/// - Parameter m: the exponent of winding hottest-spot rise with load
+/// - Returns: The ultimate winding hottest-spot rise over top-oil for load K, °C
+double Delta_Theta_H_U(double delta_theta_H_R, double K, double m);
+
+/// Clause 7: Thermal capacity of the transformer
+/// - Parameter WCC: the weight of core and coil assembly, lb
+/// - Parameter WTANK: the weight of tank and fittings, lb
+/// - Parameter gallons: the volume of fluid, gallons
+/// - Parameter forcedOil: true for OFAF and ODAF cooling (the tank and fittings contribute fully in that case), otherwise false
+/// - Returns: The thermal capacity, W-h/°C
+double C_THERMAL(double WCC, double WTANK, double gallons, bool forcedOil);
+
+/// Clause 7: Top-oil time constant at rated load
+/// - Parameter C: the thermal capacity of the transformer, W-h/°C
+/// - Parameter delta_theta_TO_R: the top-oil rise over ambient at rated load, °C
+/// - Parameter PT_R: the total loss at rated load, W
+/// - Returns: The top-oil time constant at rated load, min
+double Tau_TO_R(double C, double delta_theta_TO_R, double PT_R);
+
+/// Clause 7: Top-oil time constant for a load step (corrects the rated time constant for n ≠ 1)
+/// - Parameter tau_TO_R: the top-oil time constant at rated load, min
+/// - Parameter delta_theta_TO_U: the ultimate top-oil rise over ambient for the new load, °C
+/// - Parameter delta_theta_TO_i: the initial top-oil rise over ambient, °C
+/// - Parameter delta_theta_TO_R: the top-oil rise over ambient at rated load, °C
+/// - Parameter n: the exponent of top-oil rise with losses
+/// - Returns: The top-oil time constant for the load step, min
+double Tau_TO(double tau_TO_R, double delta_theta_TO_U, double delta_theta_TO_i, double delta_theta_TO_R, double n);
+
+/// Clause 7: Exponential response of a temperature rise (used for both top-oil rise and hottest-spot rise)
+/// - Parameter delta_theta_U: the ultimate rise, °C
+/// - Parameter delta_theta_i: the initial rise, °C
+/// - Parameter t: the elapsed time, min
+/// - Parameter tau: the time constant, min
+/// - Returns: The rise after time t, °C
+double Delta_Theta_Exponential(double delta_theta_U, double delta_theta_i, double t, double tau);
+
 // Close the braces for extern "C"
 #ifdef __cplusplus
 }
@@ -0,0 +1,577 @@
+//
+//  C57_91_ResultCache.c
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-26.
+//
+
+#include "C57_91_ResultCache.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// The number of entries in a bucket
+#define CACHE_WAYS 8
+
+// Identification of the on-disk layout (a file with a different layout, size or engine version is not used, see OpenDiskTable())
+#define CACHE_MAGIC 0x314843523139353CULL
+#define CACHE_VERSION 2
+
+// Increment this if the encoding of the key changes
+#define CACHE_KEY_VERSION 1
+
+// The number of 64-bit words needed to hold a C57_91_CachedResult
+#define CACHE_VALUE_WORDS ((sizeof(C57_91_CachedResult) + sizeof(uint64_t) - 1) / sizeof(uint64_t))
+
+// A reader that keeps colliding with writers gives up (and reports a miss) after this many attempts, so it never blocks
+#define CACHE_MAX_READ_ATTEMPTS 64
+
+// A writer that cannot get the bucket lock after this many attempts skips the insert (a crashed process could have left the lock set)
+#define CACHE_MAX_LOCK_ATTEMPTS 100000
+
+// The header of a table is padded to this size
+#define CACHE_HEADER_BYTES 64
+
+typedef struct {
+    
+    // odd while the entry is being written
+    _Atomic uint32_t sequence;
+    uint32_t unused;
+    
+    // the value of the table's clock the last time the entry was read or written (0 means the entry is empty)
+    _Atomic uint64_t lastUse;
+    
+    _Atomic uint64_t key[2];
+    _Atomic uint64_t value[CACHE_VALUE_WORDS];
+    
+} CacheEntry;
+
+typedef struct {
+    
+    // writers' spin lock (0 is unlocked)
+    _Atomic uint32_t lock;
+    uint32_t unused;
+    
+    CacheEntry entries[CACHE_WAYS];
+    
+} CacheBucket;
+
+typedef struct {
+    
+    uint64_t magic;
+    uint64_t version;
+    uint64_t bucketCount;
+    uint64_t bucketBytes;
+    uint64_t engineVersion;
+    
+    _Atomic uint64_t clock;
+    
+} CacheHeader;
+
+// One tier of the cache
+typedef struct {
+    
+    void *base;
+    size_t bytes;
+    bool isMapped;
+    
+    CacheHeader *header;
+    CacheBucket *buckets;
+    uint64_t bucketMask;
+    
+} CacheTable;
+
+struct C57_91_ResultCache {
+    
+    CacheTable memory;
+    CacheTable disk;
+    bool hasDisk;
+    
+    _Atomic uint64_t memoryHits;
+    _Atomic uint64_t diskHits;
+    _Atomic uint64_t misses;
+    _Atomic uint64_t inserts;
+};
+
+// The number of buckets for a number of entries (a power of 2, so that the bucket index is a mask of the key)
+static uint64_t BucketCount(int entries) {
+    
+    uint64_t result = 1;
+    while (result * CACHE_WAYS < (uint64_t)(entries > 0 ? entries : 1)) {
+        
+        result *= 2;
+    }
+    
+    return result;
+}
+
+static size_t TableBytes(uint64_t bucketCount) {
+    
+    return CACHE_HEADER_BYTES + bucketCount * sizeof(CacheBucket);
+}
+
+/// Set up the pointers of a table over its memory. Memory that is all zeroes (a new table) is initialized.
+/// - Returns: false if the memory holds a table with a different layout, size or engine version (it is left alone)
+static bool AttachTable(CacheTable *table, uint64_t bucketCount) {
+    
+    table->header = (CacheHeader *)table->base;
+    table->buckets = (CacheBucket *)((char *)table->base + CACHE_HEADER_BYTES);
+    table->bucketMask = bucketCount - 1;
+    
+    CacheHeader *header = table->header;
+    if (header->magic == 0) {
+        
+        header->version = CACHE_VERSION;
+        header->bucketCount = bucketCount;
+        header->bucketBytes = sizeof(CacheBucket);
+        header->engineVersion = C57_91_ENGINE_VERSION;
+        header->magic = CACHE_MAGIC;
+        
+        return true;
+    }
+    
+    return header->magic == CACHE_MAGIC && header->version == CACHE_VERSION && header->bucketCount == bucketCount && header->bucketBytes == sizeof(CacheBucket) && header->engineVersion == C57_91_ENGINE_VERSION;
+}
+
+static bool OpenMemoryTable(CacheTable *table, int entries) {
+    
+    const uint64_t bucketCount = BucketCount(entries);
+    
+    table->bytes = TableBytes(bucketCount);
+    table->base = calloc(1, table->bytes);
+    table->isMapped = false;
+    
+    if (table->base == NULL) {
+        
+        return false;
+    }
+    
+    return AttachTable(table, bucketCount);
+}
+
+/// Map the file for the on-disk tier. An existing file is never resized or reinitialized, since other processes may have it mapped (shrinking it would make them fault), so a file with a different size, layout or engine version is simply not used.
+/// - Parameter isIncompatible: set to true if the file exists but cannot be used (the cache should run without an on-disk tier)
+/// - Returns: false if the file could not be used
+static bool OpenDiskTable(CacheTable *table, const char *path, int entries, bool *isIncompatible) {
+    
+    const uint64_t bucketCount = BucketCount(entries);
+    table->bytes = TableBytes(bucketCount);
+    table->isMapped = true;
+    *isIncompatible = false;
+    
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        
+        return false;
+    }
+    
+    struct stat fileInfo;
+    if (fstat(fd, &fileInfo) != 0) {
+        
+        close(fd);
+        return false;
+    }
+    
+    if (fileInfo.st_size == 0) {
+        
+        // a new file (the new space reads as zeroes, so AttachTable() will initialize it)
+        if (ftruncate(fd, (off_t)table->bytes) != 0) {
+            
+            close(fd);
+            return false;
+        }
+    }
+    else if ((size_t)fileInfo.st_size != table->bytes) {
+        
+        close(fd);
+        *isIncompatible = true;
+        return false;
+    }
+    
+    table->base = mmap(NULL, table->bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    
+    if (table->base == MAP_FAILED) {
+        
+        table->base = NULL;
+        return false;
+    }
+    
+    if (!AttachTable(table, bucketCount)) {
+        
+        munmap(table->base, table->bytes);
+        table->base = NULL;
+        *isIncompatible = true;
+        return false;
+    }
+    
+    return true;
+}
+
+static void CloseTable(CacheTable *table) {
+    
+    if (table->base == NULL) {
+        
+        return;
+    }
+    
+    if (table->isMapped) {
+        
+        msync(table->base, table->bytes, MS_SYNC);
+        munmap(table->base, table->bytes);
+    }
+    else {
+        
+        free(table->base);
+    }
+    
+    table->base = NULL;
+}
+
+static uint64_t NextTick(CacheTable *table) {
+    
+    return atomic_fetch_add_explicit(&table->header->clock, 1, memory_order_relaxed) + 1;
+}
+
+// Seqlock read of the entries of a bucket
+static bool TableLookup(CacheTable *table, C57_91_CacheKey key, C57_91_CachedResult *result) {
+    
+    CacheBucket *bucket = &table->buckets[key.lo & table->bucketMask];
+    
+    for (int way = 0; way < CACHE_WAYS; way++) {
+        
+        CacheEntry *entry = &bucket->entries[way];
+        
+        for (int attempt = 0; attempt < CACHE_MAX_READ_ATTEMPTS; attempt++) {
+            
+            const uint32_t startSequence = atomic_load_explicit(&entry->sequence, memory_order_acquire);
+            if (startSequence & 1) {
+                
+                continue;
+            }
+            
+            const uint64_t hi = atomic_load_explicit(&entry->key[0], memory_order_relaxed);
+            const uint64_t lo = atomic_load_explicit(&entry->key[1], memory_order_relaxed);
+            
+            uint64_t words[CACHE_VALUE_WORDS];
+            const bool isMatch = hi == key.hi && lo == key.lo;
+            if (isMatch) {
+                
+                for (size_t i = 0; i < CACHE_VALUE_WORDS; i++) {
+                    
+                    words[i] = atomic_load_explicit(&entry->value[i], memory_order_relaxed);
+                }
+            }
+            
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&entry->sequence, memory_order_relaxed) != startSequence) {
+                
+                // a writer got in the way, try again
+                continue;
+            }
+            
+            if (!isMatch) {
+                
+                break;
+            }
+            
+            memcpy(result, words, sizeof(C57_91_CachedResult));
+            atomic_store_explicit(&entry->lastUse, NextTick(table), memory_order_relaxed);
+            
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+// Insert (or replace) an entry. The insert is skipped if the bucket lock cannot be had in 'maxLockAttempts' attempts (1 makes it a try-lock).
+static void TableInsert(CacheTable *table, C57_91_CacheKey key, const C57_91_CachedResult *value, int maxLockAttempts) {
+    
+    CacheBucket *bucket = &table->buckets[key.lo & table->bucketMask];
+    
+    int attempts = 0;
+    while (atomic_exchange_explicit(&bucket->lock, 1, memory_order_acquire) != 0) {
+        
+        attempts += 1;
+        if (attempts >= maxLockAttempts) {
+            
+            return;
+        }
+    }
+    
+    // replace the entry with the same key if there is one, otherwise the least-recently-used (empty entries have a lastUse of 0)
+    CacheEntry *victim = &bucket->entries[0];
+    uint64_t oldestUse = UINT64_MAX;
+    for (int way = 0; way < CACHE_WAYS; way++) {
+        
+        CacheEntry *entry = &bucket->entries[way];
+        
+        if (atomic_load_explicit(&entry->key[0], memory_order_relaxed) == key.hi && atomic_load_explicit(&entry->key[1], memory_order_relaxed) == key.lo) {
+            
+            victim = entry;
+            break;
+        }
+        
+        const uint64_t lastUse = atomic_load_explicit(&entry->lastUse, memory_order_relaxed);
+        if (lastUse < oldestUse) {
+            
+            oldestUse = lastUse;
+            victim = entry;
+        }
+    }
+    
+    uint64_t words[CACHE_VALUE_WORDS] = {0};
+    memcpy(words, value, sizeof(C57_91_CachedResult));
+    
+    // make the sequence odd (even if a crashed writer left it odd)
+    const uint32_t sequence = (atomic_load_explicit(&victim->sequence, memory_order_relaxed) + 1) | 1;
+    atomic_store_explicit(&victim->sequence, sequence, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    
+    atomic_store_explicit(&victim->key[0], key.hi, memory_order_relaxed);
+    atomic_store_explicit(&victim->key[1], key.lo, memory_order_relaxed);
+    for (size_t i = 0; i < CACHE_VALUE_WORDS; i++) {
+        
+        atomic_store_explicit(&victim->value[i], words[i], memory_order_relaxed);
+    }
+    atomic_store_explicit(&victim->lastUse, NextTick(table), memory_order_relaxed);
+    
+    atomic_store_explicit(&victim->sequence, sequence + 1, memory_order_release);
+    
+    atomic_store_explicit(&bucket->lock, 0, memory_order_release);
+}
+
+C57_91_ResultCache *C57_91_CacheOpen(int memoryEntries, const char *path, int diskEntries) {
+    
+    C57_91_ResultCache *cache = calloc(1, sizeof(C57_91_ResultCache));
+    if (cache == NULL) {
+        
+        return NULL;
+    }
+    
+    if (!OpenMemoryTable(&cache->memory, memoryEntries)) {
+        
+        free(cache);
+        return NULL;
+    }
+    
+    if (path != NULL) {
+        
+        bool isIncompatible = false;
+        if (OpenDiskTable(&cache->disk, path, diskEntries, &isIncompatible)) {
+            
+            cache->hasDisk = true;
+        }
+        else if (!isIncompatible) {
+            
+            CloseTable(&cache->memory);
+            free(cache);
+            return NULL;
+        }
+    }
+    
+    return cache;
+}
+
+void C57_91_CacheClose(C57_91_ResultCache *cache) {
+    
+    if (cache == NULL) {
+        
+        return;
+    }
+    
+    CloseTable(&cache->memory);
+    CloseTable(&cache->disk);
+    free(cache);
+}
+
+bool C57_91_CacheLookup(C57_91_ResultCache *cache, C57_91_CacheKey key, C57_91_CachedResult *result) {
+    
+    if (TableLookup(&cache->memory, key, result)) {
+        
+        atomic_fetch_add_explicit(&cache->memoryHits, 1, memory_order_relaxed);
+        return true;
+    }
+    
+    if (cache->hasDisk && TableLookup(&cache->disk, key, result)) {
+        
+        atomic_fetch_add_explicit(&cache->diskHits, 1, memory_order_relaxed);
+        
+        // the promotion only tries the bucket lock once, so a reader never waits for a writer (if the bucket is busy, the entry is simply found on disk again next time)
+        TableInsert(&cache->memory, key, result, 1);
+        return true;
+    }
+    
+    atomic_fetch_add_explicit(&cache->misses, 1, memory_order_relaxed);
+    
+    return false;
+}
+
+void C57_91_CacheInsert(C57_91_ResultCache *cache, C57_91_CacheKey key, const C57_91_CachedResult *result) {
+    
+    TableInsert(&cache->memory, key, result, CACHE_MAX_LOCK_ATTEMPTS);
+    
+    if (cache->hasDisk) {
+        
+        TableInsert(&cache->disk, key, result, CACHE_MAX_LOCK_ATTEMPTS);
+    }
+    
+    atomic_fetch_add_explicit(&cache->inserts, 1, memory_order_relaxed);
+}
+
+C57_91_CacheStatistics C57_91_CacheGetStatistics(C57_91_ResultCache *cache) {
+    
+    C57_91_CacheStatistics result;
+    
+    result.memoryHits = atomic_load_explicit(&cache->memoryHits, memory_order_relaxed);
+    result.diskHits = atomic_load_explicit(&cache->diskHits, memory_order_relaxed);
+    result.misses = atomic_load_explicit(&cache->misses, memory_order_relaxed);
+    result.inserts = atomic_load_explicit(&cache->inserts, memory_order_relaxed);
+    result.hasDiskTier = cache->hasDisk;
+    
+    return result;
+}
+
+// The 64-bit finalizer of SplitMix64
+static uint64_t Mix64(uint64_t x) {
+    
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    
+    return x;
+}
+
+// Two independent 64-bit hash lanes, giving a 128-bit key
+typedef struct {
+    
+    uint64_t h1;
+    uint64_t h2;
+    uint64_t count;
+    
+} KeyHasher;
+
+static void HashWord(KeyHasher *hasher, uint64_t word) {
+    
+    hasher->h1 = Mix64(hasher->h1 ^ word);
+    hasher->h2 = Mix64(hasher->h2 ^ ((word << 32) | (word >> 32)) ^ 0xA0761D6478BD642FULL);
+    hasher->count += 1;
+}
+
+// Doubles are hashed by their bits, after folding the values that compare equal (or are all "not a number") to a single encoding
+static void HashDouble(KeyHasher *hasher, double value) {
+    
+    if (value == 0.0) {
+        
+        value = 0.0;
+    }
+    else if (isnan(value)) {
+        
+        value = NAN;
+    }
+    
+    uint64_t word;
+    memcpy(&word, &value, sizeof(word));
+    
+    HashWord(hasher, word);
+}
+
+C57_91_CacheKey C57_91_CacheKeyForRun(const C57_91_Design *design, const C57_91_State *start, const C57_91_ProfilePoint *profile, int count, double delta_T, bool withOverexcitation, C57_91_Precision precision) {
+    
+    KeyHasher hasher = {0x243F6A8885A308D3ULL, 0x13198A2E03707344ULL, 0};
+    
+    HashWord(&hasher, CACHE_KEY_VERSION);
+    HashWord(&hasher, C57_91_ENGINE_VERSION);
+    
+    // the design row (the derived fields depend only on these), with the types hashed as words
+    double designFields[C57_91_DESIGN_FIELDS];
+    C57_91_DesignToFields(design, designFields);
+    
+    HashWord(&hasher, (uint64_t)design->cType);
+    HashWord(&hasher, (uint64_t)design->fType);
+    HashWord(&hasher, (uint64_t)design->wType);
+    
+    for (int i = 3; i < C57_91_DESIGN_FIELDS; i++) {
+        
+        HashDouble(&hasher, designFields[i]);
+    }
+    
+    HashDouble(&hasher, start->theta_A);
+    HashDouble(&hasher, start->theta_W);
+    HashDouble(&hasher, start->theta_H);
+    HashDouble(&hasher, start->theta_TDO);
+    HashDouble(&hasher, start->theta_TO);
+    HashDouble(&hasher, start->theta_BO);
+    
+    HashWord(&hasher, (uint64_t)count);
+    for (int i = 0; i < count; i++) {
+        
+        HashDouble(&hasher, profile[i].time);
+        HashDouble(&hasher, profile[i].K);
+        HashDouble(&hasher, profile[i].theta_A);
+    }
+    
+    // C57_91_Run() treats any Δt that is not positive as 0.5 minutes
+    HashDouble(&hasher, delta_T > 0.0 ? delta_T : 0.5);
+    HashWord(&hasher, withOverexcitation ? 1 : 0);
+    HashWord(&hasher, (uint64_t)precision);
+    
+    C57_91_CacheKey result;
+    result.hi = Mix64(hasher.h1 ^ hasher.count);
+    result.lo = Mix64(hasher.h2 + hasher.count);
+    
+    // the all-zero key marks an empty entry
+    if (result.hi == 0 && result.lo == 0) {
+        
+        result.lo = 1;
+    }
+    
+    return result;
+}
+
+void C57_91_CacheResultFromRun(const C57_91_RunResult *runResult, const C57_91_State *trace, int traceCount, double traceInterval, C57_91_CachedResult *result) {
+    
+    memset(result, 0, sizeof(C57_91_CachedResult));
+    
+    result->maxHotspot = runResult->maxHotspot;
+    result->maxHotspotTime = runResult->maxHotspotTime;
+    result->maxTopOil = runResult->maxTopOil;
+    result->maxTopOilTime = runResult->maxTopOilTime;
+    result->maxAverageWinding = runResult->maxAverageWinding;
+    result->maxAverageWindingTime = runResult->maxAverageWindingTime;
+    result->agingFactor = runResult->agingFactor;
+    
+    if (trace == NULL || traceCount <= 0) {
+        
+        return;
+    }
+    
+    // each point of the decimated trace is the highest value in its window, so that the peaks are kept
+    const int stride = (traceCount + C57_91_CACHE_TRACE_POINTS - 1) / C57_91_CACHE_TRACE_POINTS;
+    int points = 0;
+    for (int windowStart = 0; windowStart < traceCount; windowStart += stride) {
+        
+        double hotspot = trace[windowStart].theta_H;
+        double topOil = trace[windowStart].theta_TO;
+        for (int i = windowStart + 1; i < windowStart + stride && i < traceCount; i++) {
+            
+            hotspot = trace[i].theta_H > hotspot ? trace[i].theta_H : hotspot;
+            topOil = trace[i].theta_TO > topOil ? trace[i].theta_TO : topOil;
+        }
+        
+        result->hotspotTrace[points] = (float)hotspot;
+        result->topOilTrace[points] = (float)topOil;
+        points += 1;
+    }
+    
+    result->traceCount = points;
+    result->traceInterval = (float)(traceInterval * stride);
+}
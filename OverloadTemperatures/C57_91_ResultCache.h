@@ -0,0 +1,110 @@
+//
+//  C57_91_ResultCache.h
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-26.
+//
+
+// A content-addressed cache of the results of C57_91_Run(). The key is a 128-bit hash of a canonical encoding of everything that affects the result (the engine version, the caller's fields of the design, the starting state, the profile and the run options), so any two runs that would produce the same result share one entry, no matter where the inputs came from.
+
+// The cache has two tiers with the same layout: an in-memory tier and an optional on-disk tier, which is a memory-mapped file that survives from one run of the program to the next (and can be shared by several processes). Each tier is a hash table of buckets with a small number of entries (ways). Within a bucket, the least-recently-used entry is replaced.
+
+// Lookups are lock-free: every entry is protected by a sequence counter (a "seqlock"), so a reader never blocks and only retries if it collides with a writer that is updating the same entry. Writers lock the bucket (with a spin lock that lives in the table, so it also works across processes). The one write on the read path, the promotion of an on-disk hit to the in-memory tier, only tries that lock once and is skipped if the bucket is busy.
+
+// NOTE: This file uses C11 atomics and POSIX mmap(). Windows would need a different implementation of the on-disk tier.
+
+#ifndef C57_91_ResultCache_h
+#define C57_91_ResultCache_h
+
+#include "C57_91_Engine.h"
+#include <stdint.h>
+
+// Tell the C++ compiler that this is C code
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The number of points in the decimated traces of a cached result
+#define C57_91_CACHE_TRACE_POINTS 48
+
+// The cache key (never all zeroes)
+typedef struct {
+    
+    uint64_t hi;
+    uint64_t lo;
+    
+} C57_91_CacheKey;
+
+// What is stored for each run
+typedef struct {
+    
+    double maxHotspot;
+    double maxHotspotTime;
+    double maxTopOil;
+    double maxTopOilTime;
+    double maxAverageWinding;
+    double maxAverageWindingTime;
+    double agingFactor;
+    
+    // the number of points in the traces (0 if no trace was stored), and the time between them, min
+    int32_t traceCount;
+    float traceInterval;
+    
+    float hotspotTrace[C57_91_CACHE_TRACE_POINTS];
+    float topOilTrace[C57_91_CACHE_TRACE_POINTS];
+    
+} C57_91_CachedResult;
+
+// Statistics (since the cache was opened)
+typedef struct {
+    
+    uint64_t memoryHits;
+    uint64_t diskHits;
+    uint64_t misses;
+    uint64_t inserts;
+    
+    // false if there is no on-disk tier (none was requested, or the file could not be used)
+    bool hasDiskTier;
+    
+} C57_91_CacheStatistics;
+
+// The cache itself (opaque)
+typedef struct C57_91_ResultCache C57_91_ResultCache;
+
+/// Open a cache.
+/// - Parameter memoryEntries: the (approximate) number of entries in the in-memory tier
+/// - Parameter path: the file for the on-disk tier (NULL for no on-disk tier). The file is created if it does not exist. A file that was created with a different layout, size or C57_91_ENGINE_VERSION is left alone and the cache runs without an on-disk tier (see C57_91_CacheStatistics.hasDiskTier), so old results are never served by a newer engine; delete the file (or use a new path) to start a new one.
+/// - Parameter diskEntries: the (approximate) number of entries in the on-disk tier
+/// - Returns: The cache, or NULL if it could not be created (or the file could not be created or mapped)
+C57_91_ResultCache *_Nullable C57_91_CacheOpen(int memoryEntries, const char *_Nullable path, int diskEntries);
+
+/// Flush the on-disk tier and release the cache
+void C57_91_CacheClose(C57_91_ResultCache *_Nullable cache);
+
+/// The key for a run (the arguments are the same as C57_91_Run()). Only the fields of the design that are set by the caller are used.
+C57_91_CacheKey C57_91_CacheKeyForRun(const C57_91_Design *_Nonnull design, const C57_91_State *_Nonnull start, const C57_91_ProfilePoint *_Nonnull profile, int count, double delta_T, bool withOverexcitation, C57_91_Precision precision);
+
+/// Look up a result (lock-free). A hit in the on-disk tier is copied to the in-memory tier, unless a writer holds the in-memory bucket at that moment.
+/// - Returns: true if the key was found, in which case the result is copied to 'result'
+bool C57_91_CacheLookup(C57_91_ResultCache *_Nonnull cache, C57_91_CacheKey key, C57_91_CachedResult *_Nonnull result);
+
+/// Insert (or replace) a result in both tiers
+void C57_91_CacheInsert(C57_91_ResultCache *_Nonnull cache, C57_91_CacheKey key, const C57_91_CachedResult *_Nonnull result);
+
+/// Create the cached form of a run.
+/// - Parameter runResult: the result of C57_91_Run()
+/// - Parameter trace: the trace from the run (may be NULL)
+/// - Parameter traceCount: the number of entries in the trace
+/// - Parameter traceInterval: the interval between the entries of the trace, min
+/// - Parameter result: the cached result (the trace is decimated to at most C57_91_CACHE_TRACE_POINTS points)
+void C57_91_CacheResultFromRun(const C57_91_RunResult *_Nonnull runResult, const C57_91_State *_Nullable trace, int traceCount, double traceInterval, C57_91_CachedResult *_Nonnull result);
+
+/// The statistics of the cache
+C57_91_CacheStatistics C57_91_CacheGetStatistics(C57_91_ResultCache *_Nonnull cache);
+
+// Close the braces for extern "C"
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* C57_91_ResultCache_h */
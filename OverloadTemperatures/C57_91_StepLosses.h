@@ -0,0 +1,128 @@
+//
+//  C57_91_StepLosses.h
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-29.
+//
+
+// The fused loss kernel of the Annex G step (G.4, G.5, G.12 to G.15 and G.19). A step needs the heat generated by the windings and by the stray loss at the average winding temperature, and the heat generated at the hot-spot at the (fixed) hot-spot temperature. All three are K²·Δt times a loss times a temperature correction of the form (Θ + ΘK) / (ΘREF + ΘK) (or its inverse), so the load, the step length and the reference-temperature part of the correction are folded into one coefficient per loss, once per step. After that, the winding and stray heats cost one division (shared) and the hot-spot heat costs one multiplication.
+
+// The hot-spot temperature that is used depends on the new average winding temperature, which depends on the winding heat, so the two evaluations cannot be merged into a single call.
+
+// The functions are static inline so that they compile into the step of the native engine (both precisions) and can be called directly from Swift (OverloadModel.CalculateTempsForLoadCycle()).
+
+#ifndef C57_91_StepLosses_h
+#define C57_91_StepLosses_h
+
+#include "C57_91_Functions.h"
+
+// Tell the C++ compiler that this is C code
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The winding and stray losses at the loss reference temperature and the kVA base for the losses
+typedef struct {
+    
+    double theta_K; // the temperature factor of the conductor (234.5 for copper, 225 for aluminum), °C
+    double theta_REF; // °C
+    double Pw; // I2R loss, W
+    double Pe; // eddy loss, W
+    double Ps; // stray loss, W
+    double EHS; // eddy loss at the hot-spot, per unit of I2R loss
+    
+} C57_91_LossDescriptor;
+
+// The loss coefficients for one step (double precision)
+typedef struct {
+    
+    double theta_K;
+    double resistive; // Δt·K²·Pw / (ΘREF + ΘK)
+    double eddy; // Δt·K²·Pe·(ΘREF + ΘK)
+    double stray; // Δt·K²·Ps·(ΘREF + ΘK)
+    double hotspot; // Δt·K²·Pw·(1 + EHS) / (ΘREF + ΘK)
+    
+} C57_91_StepLosses;
+
+// The loss coefficients for one step (single precision)
+typedef struct {
+    
+    float theta_K;
+    float resistive;
+    float eddy;
+    float stray;
+    float hotspot;
+    
+} C57_91_StepLossesF;
+
+/// Fold the load and the step length into the losses
+/// - Parameter losses: the loss descriptor
+/// - Parameter K: the load, per unit of the kVA base for the losses
+/// - Parameter delta_T: the step length, min
+static inline C57_91_StepLosses C57_91_PrepareStepLosses(C57_91_LossDescriptor losses, double K, double delta_T) {
+    
+    const double scale = delta_T * K * K;
+    const double reference = losses.theta_REF + losses.theta_K;
+    const double resistive = scale * losses.Pw / reference;
+    
+    C57_91_StepLosses result = {losses.theta_K, resistive, scale * losses.Pe * reference, scale * losses.Ps * reference, resistive * (1.0 + losses.EHS)};
+    
+    return result;
+}
+
+/// Single-precision version of C57_91_PrepareStepLosses() (the coefficients are calculated in double precision, then rounded)
+static inline C57_91_StepLossesF C57_91_PrepareStepLossesF(C57_91_LossDescriptor losses, float K, float delta_T) {
+    
+    const C57_91_StepLosses step = C57_91_PrepareStepLosses(losses, (double)K, (double)delta_T);
+    
+    C57_91_StepLossesF result = {(float)step.theta_K, (float)step.resistive, (float)step.eddy, (float)step.stray, (float)step.hotspot};
+    
+    return result;
+}
+
+/// The heat generated by the windings (G.4 & G.5) and by the stray loss (G.19) during the step, W-min
+/// - Parameter step: the loss coefficients of the step
+/// - Parameter theta_W: the average winding temperature at the start of the step, °C
+/// - Parameter QS: set to the heat generated by the stray loss
+/// - Returns: The heat generated by the windings
+static inline double C57_91_WindingHeat(C57_91_StepLosses step, double theta_W, double *_Nonnull QS) {
+    
+    const double temperature = theta_W + step.theta_K;
+    const double inverse = 1.0 / temperature;
+    
+    *QS = step.stray * inverse;
+    
+    return step.resistive * temperature + step.eddy * inverse;
+}
+
+/// Single-precision version of C57_91_WindingHeat()
+static inline float C57_91_WindingHeatF(C57_91_StepLossesF step, float theta_W, float *_Nonnull QS) {
+    
+    const float temperature = theta_W + step.theta_K;
+    const float inverse = 1.0f / temperature;
+    
+    *QS = step.stray * inverse;
+    
+    return step.resistive * temperature + step.eddy * inverse;
+}
+
+/// The heat generated at the hot-spot during the step (G.12 to G.15), W-min. The hot-spot eddy loss is corrected like the I2R loss, as in Losses.windingHotspotLoss.
+/// - Parameter step: the loss coefficients of the step
+/// - Parameter theta_H: the (fixed) hot-spot temperature, °C
+static inline double C57_91_HotspotHeat(C57_91_StepLosses step, double theta_H) {
+    
+    return step.hotspot * (theta_H + step.theta_K);
+}
+
+/// Single-precision version of C57_91_HotspotHeat()
+static inline float C57_91_HotspotHeatF(C57_91_StepLossesF step, float theta_H) {
+    
+    return step.hotspot * (theta_H + step.theta_K);
+}
+
+// Close the braces for extern "C"
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* C57_91_StepLosses_h */
@@ -0,0 +1,270 @@
+//
+//  Clause7Model.swift
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-13.
+//
+
+// The Clause 7 (exponential) top-oil/hotspot method. This is much less accurate than the Annex G heat-balance method in OverloadModel, but it is also much cheaper: every step is a closed-form exponential update that is exact for a constant load, so the steps can be far longer than the Annex G Δt (which is limited by the G.27 stability criteria). It is intended for screening large numbers of units (see OverloadScreening).
+
+import Foundation
+
+class Clause7Model: OverloadEngine {
+    
+    // the model that holds the design data (losses, temperatures, masses, cooling mode, etc). It is never modified.
+    let model:OverloadModel
+    
+    // exponent of top-oil rise with losses. If nil, the model's yExponent (or the typical value for the cooling mode) is used.
+    var nExponent:Double? = nil
+    
+    // exponent of winding hottest-spot rise with load. If nil, the typical value for the cooling mode is used.
+    var mExponent:Double? = nil
+    
+    // the longest step (minutes) to use. Load segments that are longer than this are split up so that the slopes in load and ambient are followed reasonably closely.
+    var maxStep:Double = 5.0
+    
+    var lastCycle:OverloadModel.CycleData? = nil
+    
+    init(model:OverloadModel) {
+        
+        self.model = model
+    }
+    
+    /// Do the overload calculations using the Clause 7 method. Only the top-oil and hotspot temperatures are actually calculated by this method. The average winding, average oil and bottom oil temperatures in the results are estimates (the rated gradients are scaled with the calculated rises).
+    /// - Parameter loadCycles: A non-empty array of LoadCycles (see OverloadModel.DoOverloadCalculations() for the restrictions)
+    /// - Parameter saveInterval: The interval (in hours) for saving temperature data (0 means don't save anything)
+    /// - Parameter withCoreOverExcitation: If true, use the core losses with core overexcitation, otherwise normal core losses
+    func DoOverloadCalculations(loadCycles:[LoadCycle], saveInterval:Double, withCoreOverExcitation:Bool = false) -> OverloadModel.CycleData {
+        
+        guard let profile = PreparedLoadProfile(loadCycles: loadCycles) else {
+            
+            return OverloadModel.CycleData.NullData()
+        }
+        
+        let firstLoadCycle = loadCycles.first!
+        let lastLoadCycle = loadCycles.last!
+        if firstLoadCycle.ambient != lastLoadCycle.ambient || firstLoadCycle.puLoad != lastLoadCycle.puLoad {
+            
+            DLog("First and last load cycles are not the same!")
+            return OverloadModel.CycleData.NullData()
+        }
+        
+        let ratedTemps = model.testedTemperatures
+        let constants = self.ComputeStepConstants(withCoreOverExcitation: withCoreOverExcitation)
+        
+        let startTemps = model.initialState?.temps ?? ratedTemps
+        var topOilRise = startTemps.topFluidTemperatureInTankAndRads - startTemps.ambientTemperature
+        var hotspotRise = startTemps.hotSpotWindingTemperature - startTemps.topFluidTemperatureInTankAndRads
+        
+        var maxHotspot = OverloadModel.MaxTemp(temp: startTemps.hotSpotWindingTemperature, time: 0.0)
+        var maxTopOil = OverloadModel.MaxTemp(temp: startTemps.topFluidTemperatureInTankAndRads, time: 0.0)
+        var maxAveWdg = OverloadModel.MaxTemp(temp: startTemps.averageWindingTemperature, time: 0.0)
+        var maxAveOil = OverloadModel.MaxTemp(temp: startTemps.averageFluidTemperatureInTankAndRads, time: 0.0)
+        
+        var intermediateData:[OverloadModel.IntermediateData] = saveInterval > 0.0 ? [OverloadModel.IntermediateData(time: 0.0, loadPU: firstLoadCycle.puLoad, temps: startTemps)] : []
+        var nextSaveTime = saveInterval * 60.0
+        
+        var agingSum = 0.0
+        
+        for segment in 0..<profile.startTimes.count - 1 {
+            
+            let segmentStart = profile.startTimes[segment]
+            let segmentLength = profile.startTimes[segment + 1] - segmentStart
+            
+            // step changes in load are handled by simply skipping the zero-length segment
+            if segmentLength <= 0.0 {
+                
+                continue
+            }
+            
+            let stepCount = Int((segmentLength / self.maxStep).rounded(.up))
+            let deltaT = segmentLength / Double(stepCount)
+            
+            for step in 0..<stepCount {
+                
+                let t1 = segmentStart + Double(step) * deltaT
+                let t2 = t1 + deltaT
+                
+                // use the load at the middle of the step
+                let K = (profile.loadCycles[segment].puLoad + profile.loadSlopes[segment] * (t1 + deltaT / 2.0 - segmentStart)) * constants.kFactor
+                
+                let topOilRiseU = Delta_Theta_TO_U(constants.topOilRiseR, K, constants.R, constants.n)
+                let tauTO = Tau_TO(constants.tauTO_R, topOilRiseU, topOilRise, constants.topOilRiseR, constants.n)
+                topOilRise = Delta_Theta_Exponential(topOilRiseU, topOilRise, deltaT, tauTO)
+                
+                let hotspotRiseU = Delta_Theta_H_U(constants.hotspotRiseR, K, constants.m)
+                hotspotRise = Delta_Theta_Exponential(hotspotRiseU, hotspotRise, deltaT, constants.tauW)
+                
+                let ambient = profile.loadCycles[segment].ambient + profile.ambientSlopes[segment] * (t2 - segmentStart)
+                let topOil = ambient + topOilRise
+                let hotspot = topOil + hotspotRise
+                
+                let agingExponent = (15000.0 / 383.0) - (15000.0 / (hotspot + 273.0))
+                agingSum += exp(agingExponent) * deltaT
+                
+                let bottomOil = max(ambient, ambient + topOilRise * constants.bottomOverTopR)
+                let averageOil = (topOil + bottomOil) / 2.0
+                let aveWdg = averageOil + hotspotRise * constants.aveWdgOverHotspotR
+                
+                if hotspot > maxHotspot.temp {
+                    
+                    maxHotspot = OverloadModel.MaxTemp(temp: hotspot, time: t2)
+                }
+                
+                if topOil > maxTopOil.temp {
+                    
+                    maxTopOil = OverloadModel.MaxTemp(temp: topOil, time: t2)
+                }
+                
+                if aveWdg > maxAveWdg.temp {
+                    
+                    maxAveWdg = OverloadModel.MaxTemp(temp: aveWdg, time: t2)
+                }
+                
+                if averageOil > maxAveOil.temp {
+                    
+                    maxAveOil = OverloadModel.MaxTemp(temp: averageOil, time: t2)
+                }
+                
+                if saveInterval > 0.0 && t2 >= nextSaveTime {
+                    
+                    let temps = Temperatures(ambientTemperature: ambient, ratedAverageWdgTempRise: ratedTemps.ratedAverageWindingRise, averageWdgTemp: aveWdg, hotspotWdgTemp: hotspot, hotSpotLocationPU: ratedTemps.hotSpotLocationPU, topOilTempInDucts: topOil, topOilTempInTankAndRads: topOil, bottomOilTemp: bottomOil)
+                    intermediateData.append(OverloadModel.IntermediateData(time: t2, loadPU: K / constants.kFactor, temps: temps))
+                    nextSaveTime += saveInterval * 60.0
+                }
+            }
+        }
+        
+        let cycleData = OverloadModel.CycleData(intermediateData: intermediateData, useOverExcitation: withCoreOverExcitation, maxWdgHotspot: maxHotspot, maxTopOil: maxTopOil, maxWdgAveTemp: maxAveWdg, maxAverageOil: maxAveOil, agingFactor: agingSum / profile.endTime)
+        
+        self.lastCycle = cycleData
+        
+        return cycleData
+    }
+    
+    /// Propagate a state forward in time through a load profile using the Clause 7 method. This is the cheap "coarse" propagator of the parareal calculation (see PararealIntegrator.swift): every step is exact for a constant load, so the steps can be as long as maxStep without any stability limit. Only the top-oil and hotspot rises are actually propagated; the differences between the other temperatures of 'state' and their Clause 7 estimates (see DoOverloadCalculations()) decay with the top-oil time constant (the oil temperatures) or the winding time constant (the average winding temperature).
+    /// - Parameter state: The starting state. Its 'time' field is interpreted as minutes since the start of the load profile and its agingSum is carried forward.
+    /// - Parameter toTime: The time (minutes since the start of the load profile) at which to stop
+    /// - Parameter profile: The load profile
+    /// - Parameter withCoreOverExcitation: If true, use the core losses with core overexcitation, otherwise normal core losses
+    /// - Returns: The state at toTime
+    func PropagateState(_ state:ThermalState, toTime:Double, profile:PreparedLoadProfile, withCoreOverExcitation:Bool = false) -> ThermalState {
+        
+        let constants = self.ComputeStepConstants(withCoreOverExcitation: withCoreOverExcitation)
+        let startTemps = state.temps
+        
+        var topOilRise = startTemps.topFluidTemperatureInTankAndRads - startTemps.ambientTemperature
+        var hotspotRise = startTemps.hotSpotWindingTemperature - startTemps.topFluidTemperatureInTankAndRads
+        
+        let startBottomOil = max(startTemps.ambientTemperature, startTemps.ambientTemperature + topOilRise * constants.bottomOverTopR)
+        let startAveWdg = (startTemps.topFluidTemperatureInTankAndRads + startBottomOil) / 2.0 + hotspotRise * constants.aveWdgOverHotspotR
+        var bottomOilOffset = startTemps.bottomFluidTemperature - startBottomOil
+        var ductOilOffset = startTemps.topFluidTemperatureInCoolingDucts - startTemps.topFluidTemperatureInTankAndRads
+        var aveWdgOffset = startTemps.averageWindingTemperature - startAveWdg
+        
+        var currentTime = state.time
+        var agingSum = state.agingSum
+        var ambient = profile.Ambient(atTime: currentTime)
+        
+        while currentTime < toTime {
+            
+            // steps are split at the LoadCycle breakpoints, and each segment is split into equal steps of no more than maxStep
+            let segment = profile.SegmentIndex(atTime: currentTime)
+            let segmentStart = profile.startTimes[segment]
+            var segmentEnd = toTime
+            if segment + 1 < profile.startTimes.count && profile.startTimes[segment + 1] > currentTime {
+                
+                segmentEnd = min(segmentEnd, profile.startTimes[segment + 1])
+            }
+            
+            let stepCount = Int(((segmentEnd - currentTime) / self.maxStep).rounded(.up))
+            let deltaT = (segmentEnd - currentTime) / Double(stepCount)
+            
+            for _ in 0..<stepCount {
+                
+                // use the load at the middle of the step
+                let K = (profile.loadCycles[segment].puLoad + profile.loadSlopes[segment] * (currentTime + deltaT / 2.0 - segmentStart)) * constants.kFactor
+                
+                let topOilRiseU = Delta_Theta_TO_U(constants.topOilRiseR, K, constants.R, constants.n)
+                let tauTO = Tau_TO(constants.tauTO_R, topOilRiseU, topOilRise, constants.topOilRiseR, constants.n)
+                topOilRise = Delta_Theta_Exponential(topOilRiseU, topOilRise, deltaT, tauTO)
+                
+                let hotspotRiseU = Delta_Theta_H_U(constants.hotspotRiseR, K, constants.m)
+                hotspotRise = Delta_Theta_Exponential(hotspotRiseU, hotspotRise, deltaT, constants.tauW)
+                
+                currentTime += deltaT
+                ambient = profile.loadCycles[segment].ambient + profile.ambientSlopes[segment] * (currentTime - segmentStart)
+                
+                let agingExponent = (15000.0 / 383.0) - (15000.0 / (ambient + topOilRise + hotspotRise + 273.0))
+                agingSum += exp(agingExponent) * deltaT
+                
+                let oilDecay = exp(-deltaT / constants.tauTO_R)
+                bottomOilOffset *= oilDecay
+                ductOilOffset *= oilDecay
+                aveWdgOffset *= exp(-deltaT / constants.tauW)
+            }
+            
+            // avoid round-off leaving a sliver of a step at the end of the segment
+            currentTime = segmentEnd
+        }
+        
+        let topOil = ambient + topOilRise
+        let bottomOil = max(ambient, ambient + topOilRise * constants.bottomOverTopR)
+        let aveWdg = (topOil + bottomOil) / 2.0 + hotspotRise * constants.aveWdgOverHotspotR
+        
+        let temps = Temperatures(ambientTemperature: ambient, ratedAverageWdgTempRise: startTemps.ratedAverageWindingRise, averageWdgTemp: aveWdg + aveWdgOffset, hotspotWdgTemp: topOil + hotspotRise, hotSpotLocationPU: startTemps.hotSpotLocationPU, topOilTempInDucts: topOil + ductOilOffset, topOilTempInTankAndRads: topOil, bottomOilTemp: bottomOil + bottomOilOffset)
+        
+        return ThermalState(time: toTime, temps: temps, deltaT: state.deltaT, agingSum: agingSum)
+    }
+    
+    // The rated values that every Clause 7 step needs
+    private struct StepConstants {
+        
+        // the exponents of top-oil rise with losses and hotspot rise with load
+        let n:Double
+        let m:Double
+        
+        // ratio of load loss to no-load loss at rated load
+        let R:Double
+        
+        let topOilRiseR:Double
+        let hotspotRiseR:Double
+        
+        // used for the estimated temperatures
+        let bottomOverTopR:Double
+        let aveWdgOverHotspotR:Double
+        
+        // the rated top-oil time constant and the winding time constant, minutes
+        let tauTO_R:Double
+        let tauW:Double
+        
+        // the load is defined on the overload base, the rises on the temperature base
+        let kFactor:Double
+    }
+    
+    private func ComputeStepConstants(withCoreOverExcitation:Bool) -> StepConstants {
+        
+        let ratedTemps = model.testedTemperatures
+        let coolingIndex = Int(model.coolingMode.rawValue)
+        let n = self.nExponent ?? (model.yExponent ?? AppController.Y[coolingIndex])
+        let m = self.mExponent ?? AppController.M[coolingIndex]
+        
+        // Losses at the temperature base (the rises are defined at that base)
+        let ratedLoss = model.testedLosses.LossesAtLoadAndTemperature(K: model.kvaBaseForTemperatures / model.kvaBaseForLoss, newTemp: ratedTemps.ratedAverageWindingTemperature)
+        let totalRatedLoss = ratedLoss.totalLoss(withOverExcitation: withCoreOverExcitation)
+        let noLoadLoss = withCoreOverExcitation ? max(ratedLoss.coreLoss, ratedLoss.coreLossWithOverexcitation) : ratedLoss.coreLoss
+        let R = (totalRatedLoss - noLoadLoss) / noLoadLoss
+        
+        let topOilRiseR = ratedTemps.topFluidTemperatureInTankAndRads - ratedTemps.ambientTemperature
+        let hotspotRiseR = ratedTemps.hotSpotWindingTemperature - ratedTemps.topFluidTemperatureInTankAndRads
+        let bottomOverTopR = (ratedTemps.bottomFluidTemperature - ratedTemps.ambientTemperature) / topOilRiseR
+        let aveWdgOverHotspotR = (ratedTemps.averageWindingTemperature - ratedTemps.averageFluidTemperatureInTankAndRads) / hotspotRiseR
+        
+        let gallons = model.massOfFluid / (231 * 0.031621)
+        let forcedOil = model.coolingMode == .OFAF || model.coolingMode == .ODAF
+        let thermalCapacity = C_THERMAL(model.massOfCore + model.massOfWindings, model.massOfTank, gallons, forcedOil)
+        let tauTO_R = Tau_TO_R(thermalCapacity, topOilRiseR, totalRatedLoss)
+        
+        return StepConstants(n: n, m: m, R: R, topOilRiseR: topOilRiseR, hotspotRiseR: hotspotRiseR, bottomOverTopR: bottomOverTopR, aveWdgOverHotspotR: aveWdgOverHotspotR, tauTO_R: tauTO_R, tauW: model.windingTau, kFactor: model.kVABaseForOverLoad / model.kvaBaseForTemperatures)
+    }
+}
@@ -0,0 +1,211 @@
+//
+//  DesignSweep.swift
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-19.
+//
+
+// Evaluate a design against many alternatives at once. Each axis holds the values of one design parameter to try, and the sweep runs every combination of the axes (the Cartesian product) against every load profile, in parallel.
+//
+// The work that does not depend on the scenario is only done once: each load profile is prepared (slopes and breakpoints) once for all scenarios, and the StepInvariants (rated losses and viscosities) are calculated once from the base model and shared by every run, since none of the axes change the losses or the tested temperatures.
+
+import Foundation
+
+struct DesignSweep {
+    
+    struct Scenario {
+        
+        var coolingMode:C57_91_CoolingType
+        
+        // nil means "use the typical value for the cooling mode"
+        var xExponent:Double?
+        var yExponent:Double?
+        var zExponent:Double?
+        
+        var windingTau:Double
+        
+        // all masses are in pounds
+        var massOfCore:Double
+        var massOfTank:Double
+        var massOfFluid:Double
+        
+        var withCoreOverExcitation:Bool
+    }
+    
+    struct Result {
+        
+        let scenario:Scenario
+        
+        // index into the profiles that were passed to Run()
+        let profileIndex:Int
+        
+        let maxWdgHotspot:OverloadModel.MaxTemp
+        let maxTopOil:OverloadModel.MaxTemp
+        let maxWdgAveTemp:OverloadModel.MaxTemp
+        let maxAverageOil:OverloadModel.MaxTemp
+        
+        let agingFactor:Double
+    }
+    
+    // the model that holds the design data that is common to all the scenarios (losses, tested temperatures, kVA bases, fluid, conductor and winding mass). It is never modified.
+    let baseModel:OverloadModel
+    
+    // The sweep axes. Each one is initialized to the single value in the base model, so only the axes of interest need to be set.
+    var coolingModes:[C57_91_CoolingType]
+    var xExponents:[Double?]
+    var yExponents:[Double?]
+    var zExponents:[Double?]
+    var windingTaus:[Double]
+    var massesOfCore:[Double]
+    var massesOfTank:[Double]
+    var massesOfFluid:[Double]
+    var coreOverExcitation:[Bool]
+    
+    init(baseModel:OverloadModel) {
+        
+        self.baseModel = baseModel
+        self.coolingModes = [baseModel.coolingMode]
+        self.xExponents = [baseModel.xExponent]
+        self.yExponents = [baseModel.yExponent]
+        self.zExponents = [baseModel.zExponent]
+        self.windingTaus = [baseModel.windingTau]
+        self.massesOfCore = [baseModel.massOfCore]
+        self.massesOfTank = [baseModel.massOfTank]
+        self.massesOfFluid = [baseModel.massOfFluid]
+        self.coreOverExcitation = [false]
+    }
+    
+    // Every combination of the axes
+    var scenarios:[Scenario] {
+        
+        get {
+            
+            var result = [Scenario(coolingMode: baseModel.coolingMode, xExponent: nil, yExponent: nil, zExponent: nil, windingTau: baseModel.windingTau, massOfCore: baseModel.massOfCore, massOfTank: baseModel.massOfTank, massOfFluid: baseModel.massOfFluid, withCoreOverExcitation: false)]
+            
+            result = result.flatMap { scenario in self.coolingModes.map { var next = scenario; next.coolingMode = $0; return next } }
+            result = result.flatMap { scenario in self.xExponents.map { var next = scenario; next.xExponent = $0; return next } }
+            result = result.flatMap { scenario in self.yExponents.map { var next = scenario; next.yExponent = $0; return next } }
+            result = result.flatMap { scenario in self.zExponents.map { var next = scenario; next.zExponent = $0; return next } }
+            result = result.flatMap { scenario in self.windingTaus.map { var next = scenario; next.windingTau = $0; return next } }
+            result = result.flatMap { scenario in self.massesOfCore.map { var next = scenario; next.massOfCore = $0; return next } }
+            result = result.flatMap { scenario in self.massesOfTank.map { var next = scenario; next.massOfTank = $0; return next } }
+            result = result.flatMap { scenario in self.massesOfFluid.map { var next = scenario; next.massOfFluid = $0; return next } }
+            result = result.flatMap { scenario in self.coreOverExcitation.map { var next = scenario; next.withCoreOverExcitation = $0; return next } }
+            
+            return result
+        }
+    }
+    
+    /// Run every scenario against every load profile (in parallel).
+    /// - Parameter loadCycleProfiles: The load profiles. Each one must satisfy the same restrictions as the loadCycles array in OverloadModel.DoOverloadCalculations().
+    /// - Returns: The results, ordered by scenario and then by profile, or nil if any of the profiles is not valid
+    func Run(loadCycleProfiles:[[LoadCycle]]) -> [Result]? {
+        
+        var profiles:[PreparedLoadProfile] = []
+        
+        for nextLoadCycles in loadCycleProfiles {
+            
+            guard let profile = PreparedLoadProfile(loadCycles: nextLoadCycles) else {
+                
+                return nil
+            }
+            
+            if nextLoadCycles.first!.ambient != nextLoadCycles.last!.ambient || nextLoadCycles.first!.puLoad != nextLoadCycles.last!.puLoad {
+                
+                DLog("First and last load cycles are not the same!")
+                return nil
+            }
+            
+            profiles.append(profile)
+        }
+        
+        let scenarios = self.scenarios
+        let models = scenarios.map { self.Model(for: $0) }
+        let invariants = self.baseModel.ComputeStepInvariants()
+        let startState = self.baseModel.initialState ?? ThermalState(temps: self.baseModel.testedTemperatures)
+        
+        let jobCount = scenarios.count * profiles.count
+        var results = [Result?](repeating: nil, count: jobCount)
+        
+        results.withUnsafeMutableBufferPointer { buffer in
+            
+            DispatchQueue.concurrentPerform(iterations: jobCount) { job in
+                
+                let scenarioIndex = job / profiles.count
+                let profileIndex = job % profiles.count
+                let model = models[scenarioIndex]
+                let profile = profiles[profileIndex]
+                
+                // the same starting Δt as DoOverloadCalculations()
+                var deltaT = startState.deltaT > 0.0 ? startState.deltaT : 0.5
+                var maxDeltaT = 0.0
+                if !TestStability(true, model.coolingMode, model.windingTau, deltaT, &maxDeltaT, nil, nil, nil, nil, nil, nil) {
+                    
+                    deltaT = maxDeltaT
+                }
+                
+                var start = startState
+                start.time = 0.0
+                start.agingSum = 0.0
+                
+                let propagation = model.PropagateState(start, toTime: profile.endTime, profile: profile, deltaT: deltaT, withCoreOverExcitation: scenarios[scenarioIndex].withCoreOverExcitation, invariants: invariants)
+                
+                buffer[job] = Result(scenario: scenarios[scenarioIndex], profileIndex: profileIndex, maxWdgHotspot: propagation.maxWdgHotspot, maxTopOil: propagation.maxTopOil, maxWdgAveTemp: propagation.maxWdgAveTemp, maxAverageOil: propagation.maxAverageOil, agingFactor: propagation.state.agingSum / profile.endTime)
+            }
+        }
+        
+        return results.compactMap { $0 }
+    }
+    
+    /// The results as a compact table (suitable for printing or saving to a text file)
+    static func ResultsTable(_ results:[Result]) -> String {
+        
+        let columnWidth = 9
+        var result = ""
+        
+        for title in ["Profile", "Cooling", "x", "y", "z", "Tau", "Core", "Tank", "Fluid", "OvrExc", "MaxHS", "MaxTO", "Aging"] {
+            
+            result += title.CenterInSpace(width: columnWidth)
+        }
+        result += "\n"
+        
+        for nextResult in results {
+            
+            let scenario = nextResult.scenario
+            let coolingIndex = Int(scenario.coolingMode.rawValue)
+            let coolingString = scenario.coolingMode == .ONAN ? "ONAN" : (scenario.coolingMode == .ONAF ? "ONAF" : (scenario.coolingMode == .OFAF ? "OFAF" : "ODAF"))
+            
+            result += "\(nextResult.profileIndex)".CenterInSpace(width: columnWidth)
+            result += coolingString.CenterInSpace(width: columnWidth)
+            result += String(format: "%0.2f", scenario.xExponent ?? AppController.X[coolingIndex]).CenterInSpace(width: columnWidth)
+            result += String(format: "%0.2f", scenario.yExponent ?? AppController.Y[coolingIndex]).CenterInSpace(width: columnWidth)
+            result += String(format: "%0.2f", scenario.zExponent ?? AppController.Z[coolingIndex]).CenterInSpace(width: columnWidth)
+            result += String(format: "%0.1f", scenario.windingTau).CenterInSpace(width: columnWidth)
+            result += String(format: "%0.f", scenario.massOfCore).CenterInSpace(width: columnWidth)
+            result += String(format: "%0.f", scenario.massOfTank).CenterInSpace(width: columnWidth)
+            result += String(format: "%0.f", scenario.massOfFluid).CenterInSpace(width: columnWidth)
+            result += (scenario.withCoreOverExcitation ? "Yes" : "No").CenterInSpace(width: columnWidth)
+            result += String(format: "%0.1f", nextResult.maxWdgHotspot.temp).CenterInSpace(width: columnWidth)
+            result += String(format: "%0.1f", nextResult.maxTopOil.temp).CenterInSpace(width: columnWidth)
+            result += String(format: "%0.4f", nextResult.agingFactor).CenterInSpace(width: columnWidth)
+            result += "\n"
+        }
+        
+        return result
+    }
+    
+    // Create the model for a scenario (the design data that is not swept comes from the base model)
+    private func Model(for scenario:Scenario) -> OverloadModel {
+        
+        let base = self.baseModel
+        
+        let model = OverloadModel(kvaBaseForTemperatures: base.kvaBaseForTemperatures, kvaBaseForLoss: base.kvaBaseForLoss, kVABaseForOverLoad: base.kVABaseForOverLoad, coolingMode: scenario.coolingMode, fluidType: base.fluidType, conductorType: base.conductorType, testedTemperatures: base.testedTemperatures, initialTemperatures: nil, testedLosses: base.testedLosses, massOfCore: scenario.massOfCore, massOfFluid: scenario.massOfFluid, massOfTank: scenario.massOfTank, massOfWinding: base.massOfWindings, windingTau: scenario.windingTau, dataInterval: base.dataInterval)
+        
+        model.xExponent = scenario.xExponent
+        model.yExponent = scenario.yExponent
+        model.zExponent = scenario.zExponent
+        model.initialState = base.initialState
+        
+        return model
+    }
+}
@@ -0,0 +1,109 @@
+//
+//  DualNumber.swift
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-18.
+//
+
+// A dual number for forward-mode automatic differentiation. Every arithmetic operation carries the partial derivatives with respect to up to 'maxPartials' independent parameters along with the value, so a single pass through the equations gives the value and the full gradient. The partials are stored in a SIMD vector (no heap allocations), so the cost of each operation is a small constant multiple of the plain Double operation, independent of the number of parameters actually in use.
+
+import Foundation
+
+struct DualNumber: ThermalScalar {
+    
+    static let maxPartials = 16
+    
+    var value:Double
+    var partials:SIMD16<Double>
+    
+    init(_ value:Double) {
+        
+        self.value = value
+        self.partials = SIMD16<Double>(repeating: 0.0)
+    }
+    
+    init(value:Double, partials:SIMD16<Double>) {
+        
+        self.value = value
+        self.partials = partials
+    }
+    
+    /// Create an independent variable (its derivative with respect to itself is 1)
+    /// - Parameter value: The value of the variable
+    /// - Parameter seed: The index of the variable in the partials vector (must be less than maxPartials)
+    init(_ value:Double, seed:Int) {
+        
+        self.value = value
+        self.partials = SIMD16<Double>(repeating: 0.0)
+        self.partials[seed] = 1.0
+    }
+    
+    init(floatLiteral value:Double) {
+        
+        self.init(value)
+    }
+    
+    // Equality and ordering are decided on the value only (this is what the branches in the equations need)
+    static func == (lhs:DualNumber, rhs:DualNumber) -> Bool {
+        
+        return lhs.value == rhs.value
+    }
+    
+    static func < (lhs:DualNumber, rhs:DualNumber) -> Bool {
+        
+        return lhs.value < rhs.value
+    }
+    
+    static func + (lhs:DualNumber, rhs:DualNumber) -> DualNumber {
+        
+        return DualNumber(value: lhs.value + rhs.value, partials: lhs.partials + rhs.partials)
+    }
+    
+    static func - (lhs:DualNumber, rhs:DualNumber) -> DualNumber {
+        
+        return DualNumber(value: lhs.value - rhs.value, partials: lhs.partials - rhs.partials)
+    }
+    
+    static prefix func - (operand:DualNumber) -> DualNumber {
+        
+        return DualNumber(value: -operand.value, partials: -operand.partials)
+    }
+    
+    static func * (lhs:DualNumber, rhs:DualNumber) -> DualNumber {
+        
+        return DualNumber(value: lhs.value * rhs.value, partials: rhs.value * lhs.partials + lhs.value * rhs.partials)
+    }
+    
+    static func / (lhs:DualNumber, rhs:DualNumber) -> DualNumber {
+        
+        let quotient = lhs.value / rhs.value
+        
+        return DualNumber(value: quotient, partials: (lhs.partials - quotient * rhs.partials) / rhs.value)
+    }
+    
+    // d(a^b) = b a^(b-1) da + a^b ln(a) db. The second term is only included if the exponent actually varies (the base may legitimately be zero in the QLOST equations).
+    static func Pow(_ base:DualNumber, _ exponent:DualNumber) -> DualNumber {
+        
+        let result = pow(base.value, exponent.value)
+        var partials = SIMD16<Double>(repeating: 0.0)
+        
+        if base.value != 0.0 {
+            
+            partials = (exponent.value * result / base.value) * base.partials
+        }
+        
+        if base.value > 0.0 && exponent.partials != SIMD16<Double>(repeating: 0.0) {
+            
+            partials += (result * log(base.value)) * exponent.partials
+        }
+        
+        return DualNumber(value: result, partials: partials)
+    }
+    
+    static func Exp(_ x:DualNumber) -> DualNumber {
+        
+        let result = exp(x.value)
+        
+        return DualNumber(value: result, partials: result * x.partials)
+    }
+}
@@ -0,0 +1,278 @@
+//
+//  LinearizedModel.swift
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-16.
+//
+
+// A linearized (reduced-order) version of the Annex G model for very fast "what-if" predictions (load scheduling and the like, where the model may be evaluated millions of times).
+//
+// The Annex G step (G.4 to G.26, as implemented in OverloadModel) is a nonlinear discrete-time system x(k+1) = f(x(k), u(k)), where the state x is the five Annex G temperatures (see Temperatures.annexGState) and the input u is the per-unit load and the ambient temperature. Around an equilibrium x* at a chosen operating point u*, this is approximated by:
+//
+// x(k+1) - x* = A (x(k) - x*) + B (u(k) - u*)
+//
+// where A and B are the Jacobians of the step with respect to the state and input. They come from a single DualNumber pass through the generic Annex G step (OverloadModel.StepJacobian()), so they are the exact derivatives of every equation in the chain (QLOST_W, QLOST_HS, QLOST_O, the ΔΘ relations, the viscosity corrections and so on). The step has a few max() floors and a branch for the oil next to the hotspot; the Jacobians belong to the branches that are active at the equilibrium, so the model is only valid while the state stays on the same side of them (see StepJacobian() and ErrorBars()).
+//
+// For jumping many steps at once with a constant input, the powers A^(2^j) and the corresponding input sums (I + A + ... + A^(2^j - 1)) B are cached, so that n steps cost O(log n) small matrix products instead of n full Annex G steps.
+
+import Foundation
+
+class LinearizedModel {
+    
+    // the model that was linearized (it is not modified)
+    let model:OverloadModel
+    
+    // the operating point
+    let operatingLoad:Double
+    let operatingAmbient:Double
+    
+    // the fixed step length, minutes
+    let deltaT:Double
+    
+    let withCoreOverExcitation:Bool
+    
+    // the equilibrium temperatures at the operating point
+    let equilibrium:Temperatures
+    
+    // x(k+1) - x* = A (x(k) - x*) + B (u(k) - u*), where u = [load, ambient]
+    let A:SmallMatrix
+    let B:SmallMatrix
+    
+    // powerCache[j] holds (A^(2^j), (I + A + ... + A^(2^j - 1)) B)
+    private var powerCache:[(P:SmallMatrix, G:SmallMatrix)] = []
+    
+    struct ErrorBar {
+        
+        // offsets of the input from the operating point
+        let loadOffset:Double
+        let ambientOffset:Double
+        
+        // the largest error (linear minus full model) of each Annex G temperature over the test horizon, °C
+        let maxStateError:[Double]
+        
+        var maxError:Double {
+            
+            get {
+                
+                return self.maxStateError.reduce(0.0, { max($0, abs($1)) })
+            }
+        }
+    }
+    
+    /// Linearize a model around an operating point.
+    /// - Parameter model: The model to linearize
+    /// - Parameter puLoad: The operating load (on the kVABaseForOverLoad base), per unit
+    /// - Parameter ambient: The operating ambient temperature, °C
+    /// - Parameter deltaT: The step length, minutes (it should satisfy the G.27 stability criteria at the operating point)
+    /// - Parameter withCoreOverExcitation: If true, use the core losses with core overexcitation, otherwise normal core losses
+    /// - Parameter cachedPowers: The number of powers of A to cache (2^cachedPowers steps can be done with a single pass through the cache)
+    /// - Returns: The linearized model, or nil if the model does not settle to an equilibrium at the operating point
+    init?(model:OverloadModel, puLoad:Double, ambient:Double, deltaT:Double = 0.5, withCoreOverExcitation:Bool = false, cachedPowers:Int = 32) {
+        
+        self.model = model
+        self.operatingLoad = puLoad
+        self.operatingAmbient = ambient
+        self.deltaT = deltaT
+        self.withCoreOverExcitation = withCoreOverExcitation
+        
+        func Step(_ temps:Temperatures, _ load:Double, _ amb:Double) -> Temperatures {
+            
+            return model.StepTemps(from: temps, puLoad: load, ambient: amb, deltaT: deltaT, withCoreOverExcitation: withCoreOverExcitation)
+        }
+        
+        // Find the equilibrium by simply running the model at the operating point until it stops changing (the oil time constants are a few hours, so this takes a few thousand steps)
+        var temps = model.testedTemperatures
+        temps.ambientTemperature = ambient
+        var settled = false
+        
+        for _ in 0..<200000 {
+            
+            let newTemps = Step(temps, puLoad, ambient)
+            let change = zip(newTemps.annexGState, temps.annexGState).reduce(0.0, { max($0, abs($1.0 - $1.1)) })
+            
+            if !change.isFinite {
+                
+                break
+            }
+            
+            temps = newTemps
+            
+            if change < 1.0E-9 {
+                
+                settled = true
+                break
+            }
+        }
+        
+        if !settled {
+            
+            DLog("Model did not settle at the operating point!")
+            return nil
+        }
+        
+        self.equilibrium = temps
+        
+        let jacobian = model.StepJacobian(at: temps, puLoad: puLoad, ambient: ambient, deltaT: deltaT, withCoreOverExcitation: withCoreOverExcitation)
+        self.A = jacobian.A
+        self.B = jacobian.B
+        
+        // Build the power cache by repeated squaring: P(2m) = P(m) P(m), G(2m) = G(m) + P(m) G(m)
+        var P = jacobian.A
+        var G = jacobian.B
+        for _ in 0..<max(1, cachedPowers) {
+            
+            self.powerCache.append((P: P, G: G))
+            G = G + P * G
+            P = P * P
+        }
+    }
+    
+    /// Predict the temperatures after a number of steps at a constant load and ambient using the cached matrix powers (the cost is proportional to log2(steps), not steps).
+    /// - Parameter from: The starting temperatures
+    /// - Parameter steps: The number of steps of length deltaT
+    /// - Parameter puLoad: The load during the steps, per unit
+    /// - Parameter ambient: The ambient temperature during the steps, °C
+    /// - Returns: The predicted temperatures
+    func Jump(from:Temperatures, steps:Int, puLoad:Double, ambient:Double) -> Temperatures {
+        
+        let n = Temperatures.annexGStateCount
+        let xStar = self.equilibrium.annexGState
+        let dx = SmallMatrix(column: zip(from.annexGState, xStar).map { $0 - $1 })
+        let du = SmallMatrix(column: [puLoad - self.operatingLoad, ambient - self.operatingAmbient])
+        
+        var P = SmallMatrix.Identity(n)
+        var S = SmallMatrix(rows: n, cols: 2)
+        var remaining = steps
+        var level = 0
+        let topLevel = self.powerCache.count - 1
+        
+        func Apply(_ cached:(P:SmallMatrix, G:SmallMatrix)) {
+            
+            S = cached.P * S + cached.G
+            P = cached.P * P
+        }
+        
+        // use the binary representation of the number of steps
+        while remaining > 0 && level < topLevel {
+            
+            if (remaining & 1) == 1 {
+                
+                Apply(self.powerCache[level])
+            }
+            
+            remaining >>= 1
+            level += 1
+        }
+        
+        // anything left over is in units of the largest cached power
+        while remaining > 0 {
+            
+            Apply(self.powerCache[topLevel])
+            remaining -= 1
+        }
+        
+        let x = P * dx + S * du
+        
+        var result = from
+        result.ambientTemperature = ambient
+        result.annexGState = (0..<n).map { xStar[$0] + x.values[$0] }
+        
+        return result
+    }
+    
+    /// Predict the trajectory for a schedule of loads and ambients (one entry per step)
+    /// - Parameter from: The starting temperatures
+    /// - Parameter puLoads: The load for each step, per unit
+    /// - Parameter ambients: The ambient for each step, °C (must be the same length as puLoads)
+    /// - Returns: The temperatures at the end of each step
+    func Simulate(from:Temperatures, puLoads:[Double], ambients:[Double]) -> [Temperatures] {
+        
+        let n = Temperatures.annexGStateCount
+        let xStar = self.equilibrium.annexGState
+        var dx = SmallMatrix(column: zip(from.annexGState, xStar).map { $0 - $1 })
+        
+        var result:[Temperatures] = []
+        result.reserveCapacity(puLoads.count)
+        
+        for (load, ambient) in zip(puLoads, ambients) {
+            
+            dx = self.A * dx + self.B * SmallMatrix(column: [load - self.operatingLoad, ambient - self.operatingAmbient])
+            
+            var temps = from
+            temps.ambientTemperature = ambient
+            temps.annexGState = (0..<n).map { xStar[$0] + dx.values[$0] }
+            result.append(temps)
+        }
+        
+        return result
+    }
+    
+    /// Compare the linear model against the full Annex G model for a set of constant input offsets from the operating point, starting at the equilibrium.
+    /// - Parameter loadOffsets: The offsets of the load from the operating load, per unit
+    /// - Parameter ambientOffsets: The offsets of the ambient from the operating ambient, °C
+    /// - Parameter horizon: The number of steps to simulate for each combination
+    /// - Returns: One ErrorBar for each combination of load and ambient offset
+    func ErrorBars(loadOffsets:[Double] = [-0.2, -0.1, 0.1, 0.2], ambientOffsets:[Double] = [-10.0, 0.0, 10.0], horizon:Int = 1440) -> [ErrorBar] {
+        
+        var result:[ErrorBar] = []
+        
+        for loadOffset in loadOffsets {
+            
+            for ambientOffset in ambientOffsets {
+                
+                let load = self.operatingLoad + loadOffset
+                let ambient = self.operatingAmbient + ambientOffset
+                
+                let linear = self.Simulate(from: self.equilibrium, puLoads: [Double](repeating: load, count: horizon), ambients: [Double](repeating: ambient, count: horizon))
+                
+                var full = self.equilibrium
+                var maxError = [Double](repeating: 0.0, count: Temperatures.annexGStateCount)
+                
+                for nextLinear in linear {
+                    
+                    full = self.model.StepTemps(from: full, puLoad: load, ambient: ambient, deltaT: self.deltaT, withCoreOverExcitation: self.withCoreOverExcitation)
+                    
+                    for (i, error) in zip(nextLinear.annexGState, full.annexGState).map({ $0 - $1 }).enumerated() {
+                        
+                        if abs(error) > abs(maxError[i]) {
+                            
+                            maxError[i] = error
+                        }
+                    }
+                }
+                
+                result.append(ErrorBar(loadOffset: loadOffset, ambientOffset: ambientOffset, maxStateError: maxError))
+            }
+        }
+        
+        return result
+    }
+    
+    /// The ErrorBars as a String (suitable for printing)
+    func ErrorReport(_ errorBars:[ErrorBar]) -> String {
+        
+        var result = String(format: "Linearized model at %0.3f pu load, %0.1f °C ambient (Δt = %0.2f min)\n\n", self.operatingLoad, self.operatingAmbient, self.deltaT)
+        
+        let columnWidth = 10
+        for title in ["ΔLoad", "ΔAmb", "AveWdg", "HotSpot", "TopDuct", "TopOil", "BotOil"] {
+            
+            result += title.CenterInSpace(width: columnWidth)
+        }
+        result += "\n"
+        
+        for nextBar in errorBars {
+            
+            result += String(format: "%0.3f", nextBar.loadOffset).CenterInSpace(width: columnWidth)
+            result += String(format: "%0.1f", nextBar.ambientOffset).CenterInSpace(width: columnWidth)
+            
+            for nextError in nextBar.maxStateError {
+                
+                result += String(format: "%0.2f", nextError).CenterInSpace(width: columnWidth)
+            }
+            
+            result += "\n"
+        }
+        
+        return result
+    }
+}
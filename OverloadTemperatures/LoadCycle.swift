@@ -16,3 +16,110 @@ struct LoadCycle {
     // as a multiple of rated load
     let puLoad:Double
 }
+
+// An array of LoadCycles converted into the form that the time-stepping routines actually use: breakpoints in minutes and the load & ambient slopes of each segment. Creating one of these is cheap, but when the same profile is used many times (parallel runs, sweeps, etc), it only needs to be done once.
+struct PreparedLoadProfile {
+    
+    let loadCycles:[LoadCycle]
+    
+    // start time of each LoadCycle, in minutes
+    let startTimes:[Double]
+    
+    // pu per minute (the last entry is always 0)
+    let loadSlopes:[Double]
+    
+    // °C per minute (the last entry is always 0)
+    let ambientSlopes:[Double]
+    
+    // the end of the profile, in minutes
+    var endTime:Double {
+        
+        get {
+            
+            return self.startTimes.last ?? 0.0
+        }
+    }
+    
+    /// Create a PreparedLoadProfile.
+    /// - Parameter loadCycles: A non-empty array of LoadCycles. The same restrictions as DoOverloadCalculations() apply (first LoadCycle at time 0, last LoadCycle with the same load and ambient as the first).
+    init?(loadCycles:[LoadCycle]) {
+        
+        if loadCycles.isEmpty {
+            
+            DLog("loadCycles array is empty!")
+            return nil
+        }
+        else if loadCycles[0].cycleStartTime != 0.0 {
+            
+            DLog("First load cycle must start at time 0!")
+            return nil
+        }
+        
+        self.loadCycles = loadCycles
+        self.startTimes = loadCycles.map { $0.cycleStartTime * 60.0 }
+        
+        var loadSlopes:[Double] = []
+        var ambientSlopes:[Double] = []
+        for i in 0..<loadCycles.count - 1 {
+            
+            // see the comment in DoOverloadCalculations() about step changes in load
+            let loadCycleTimeStep = max(1.0E-12, self.startTimes[i + 1] - self.startTimes[i])
+            loadSlopes.append((loadCycles[i + 1].puLoad - loadCycles[i].puLoad) / loadCycleTimeStep)
+            ambientSlopes.append((loadCycles[i + 1].ambient - loadCycles[i].ambient) / loadCycleTimeStep)
+        }
+        
+        loadSlopes.append(0.0)
+        ambientSlopes.append(0.0)
+        
+        self.loadSlopes = loadSlopes
+        self.ambientSlopes = ambientSlopes
+    }
+    
+    /// Get the index of the segment that applies at the given time (ie: the last LoadCycle that starts at or before 'atTime', but never the last LoadCycle unless 'atTime' is at or past the end of the profile). Since the slopes of the last LoadCycle are 0, its load and ambient are held past the end.
+    /// - Parameter atTime: The time in minutes
+    func SegmentIndex(atTime:Double) -> Int {
+        
+        var lo = 0
+        var hi = self.startTimes.count - 2
+        
+        if hi < 0 || atTime < self.startTimes[0] {
+            
+            return 0
+        }
+        else if atTime >= self.endTime {
+            
+            return self.startTimes.count - 1
+        }
+        
+        while lo < hi {
+            
+            let mid = (lo + hi + 1) / 2
+            if self.startTimes[mid] <= atTime {
+                
+                lo = mid
+            }
+            else {
+                
+                hi = mid - 1
+            }
+        }
+        
+        return lo
+    }
+    
+    /// The interpolated load (pu) at the given time (in minutes)
+    func Load(atTime:Double) -> Double {
+        
+        let index = self.SegmentIndex(atTime: atTime)
+        
+        return self.loadCycles[index].puLoad + self.loadSlopes[index] * (atTime - self.startTimes[index])
+    }
+    
+    /// The interpolated ambient (°C) at the given time (in minutes)
+    func Ambient(atTime:Double) -> Double {
+        
+        let index = self.SegmentIndex(atTime: atTime)
+        
+        return self.loadCycles[index].ambient + self.ambientSlopes[index] * (atTime - self.startTimes[index])
+    }
+}
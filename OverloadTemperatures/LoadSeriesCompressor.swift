@@ -0,0 +1,245 @@
+//
+//  LoadSeriesCompressor.swift
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-31.
+//
+
+// Simplify a dense load & ambient series (1-minute SCADA data, for example) into a short array of LoadCycles. The LoadCycles are piecewise-linear, so a long run of samples that lie on a straight line (within the tolerances) only needs the two LoadCycles at its ends, which saves the slope calculations and the broken-up time steps of hundreds of thousands of tiny segments.
+//
+// The compressor makes a single pass over the samples, at O(1) cost and in constant memory per sample, so the series can be fed to it as it is read. Every breakpoint is one of the samples, and every sample that is dropped is within loadTolerance (pu) and ambientTolerance (°C) of the straight line between the breakpoints on either side of it. For each of the two channels, the slopes from the last breakpoint that keep every sample since then within its tolerance form an interval (the intersection of one interval per sample). A new sample can end the current segment only if the slope to it is inside the intervals of both channels; when it is not, the previous sample (which could end the segment) becomes a breakpoint and the next segment starts there. This greedy version never needs to look back, but it may use a few more segments than the best possible segmentation.
+//
+// Compare() runs the original series and the compressed LoadCycles through the native engine and reports how much the peak hot-spot (and the peak top oil and the aging factor) changed.
+//
+// NOTE: The compressor does not change the data, so DoOverloadCalculations() will only accept the result if the last sample of the series has the same load and ambient as the first one (RunNative() does not have this restriction).
+
+import Foundation
+
+class LoadSeriesCompressor {
+    
+    // One sample of the dense series
+    struct Sample {
+        
+        // in minutes, from any origin (the time of the first sample becomes time 0 of the LoadCycles)
+        let time:Double
+        // as a multiple of rated load
+        let puLoad:Double
+        // in °C
+        let ambient:Double
+    }
+    
+    // The effect of a compression on a model (see Compare())
+    struct Comparison {
+        
+        let sampleCount:Int
+        let loadCycleCount:Int
+        
+        // the largest difference between the samples and the compressed profile at the same time (pu & °C)
+        let maxLoadError:Double
+        let maxAmbientError:Double
+        
+        let original:C57_91_RunResult
+        let compressed:C57_91_RunResult
+        
+        // compressed minus original, °C
+        var hotspotChange:Double {
+            
+            get {
+                
+                return self.compressed.maxHotspot - self.original.maxHotspot
+            }
+        }
+    }
+    
+    // the largest allowable difference between a dropped sample and the compressed profile
+    let loadTolerance:Double
+    let ambientTolerance:Double
+    
+    // the breakpoints found so far (Finish() adds the last one)
+    private(set) var loadCycles:[LoadCycle] = []
+    
+    // the number of samples that were accepted
+    private(set) var sampleCount = 0
+    
+    private var originTime = 0.0
+    
+    // the last breakpoint and the last sample
+    private var anchor:Sample? = nil
+    private var previous:Sample? = nil
+    
+    // the slopes from the anchor that keep every sample since the anchor within the tolerances (pu/min & °C/min)
+    private var loadSlopes = (low: -Double.infinity, high: Double.infinity)
+    private var ambientSlopes = (low: -Double.infinity, high: Double.infinity)
+    
+    /// Create a LoadSeriesCompressor
+    /// - Parameter loadTolerance: The largest allowable difference in load, pu (not negative)
+    /// - Parameter ambientTolerance: The largest allowable difference in ambient, °C (not negative)
+    init?(loadTolerance:Double, ambientTolerance:Double) {
+        
+        if !(loadTolerance >= 0.0) || !(ambientTolerance >= 0.0) {
+            
+            DLog("Tolerances cannot be negative!")
+            return nil
+        }
+        
+        self.loadTolerance = loadTolerance
+        self.ambientTolerance = ambientTolerance
+    }
+    
+    /// Add the next sample of the series
+    /// - Parameter sample: The sample, which must be later than the previous one
+    /// - Returns: false if the sample was not later than the previous one (the sample is ignored)
+    @discardableResult
+    func Add(_ sample:Sample) -> Bool {
+        
+        guard let lastSample = self.previous, var segmentStart = self.anchor else {
+            
+            self.originTime = sample.time
+            self.anchor = sample
+            self.previous = sample
+            self.sampleCount = 1
+            self.loadCycles = [self.Cycle(sample)]
+            
+            return true
+        }
+        
+        if !(sample.time > lastSample.time) {
+            
+            DLog("Samples must be in increasing order of time!")
+            return false
+        }
+        
+        self.sampleCount += 1
+        
+        var length = sample.time - segmentStart.time
+        let loadSlope = (sample.puLoad - segmentStart.puLoad) / length
+        let ambientSlope = (sample.ambient - segmentStart.ambient) / length
+        
+        if loadSlope < self.loadSlopes.low || loadSlope > self.loadSlopes.high || ambientSlope < self.ambientSlopes.low || ambientSlope > self.ambientSlopes.high {
+            
+            // the segment cannot reach this sample, so it ends at the last one
+            self.loadCycles.append(self.Cycle(lastSample))
+            segmentStart = lastSample
+            self.anchor = lastSample
+            self.loadSlopes = (low: -Double.infinity, high: Double.infinity)
+            self.ambientSlopes = (low: -Double.infinity, high: Double.infinity)
+            length = sample.time - segmentStart.time
+        }
+        
+        // narrow the slopes so that any later end of the segment keeps this sample within the tolerances
+        self.loadSlopes.low = max(self.loadSlopes.low, (sample.puLoad - self.loadTolerance - segmentStart.puLoad) / length)
+        self.loadSlopes.high = min(self.loadSlopes.high, (sample.puLoad + self.loadTolerance - segmentStart.puLoad) / length)
+        self.ambientSlopes.low = max(self.ambientSlopes.low, (sample.ambient - self.ambientTolerance - segmentStart.ambient) / length)
+        self.ambientSlopes.high = min(self.ambientSlopes.high, (sample.ambient + self.ambientTolerance - segmentStart.ambient) / length)
+        
+        self.previous = sample
+        
+        return true
+    }
+    
+    /// End the series (more samples can still be added after this, in which case Finish() must be called again)
+    /// - Returns: The compressed LoadCycles (empty if no samples were added)
+    func Finish() -> [LoadCycle] {
+        
+        if let lastSample = self.previous, let segmentStart = self.anchor, lastSample.time > segmentStart.time {
+            
+            self.loadCycles.append(self.Cycle(lastSample))
+            self.anchor = lastSample
+            self.loadSlopes = (low: -Double.infinity, high: Double.infinity)
+            self.ambientSlopes = (low: -Double.infinity, high: Double.infinity)
+        }
+        
+        return self.loadCycles
+    }
+    
+    /// Compress a whole series at once
+    /// - Parameter samples: The samples, in increasing order of time (any that are not are ignored)
+    /// - Parameter loadTolerance: The largest allowable difference in load, pu
+    /// - Parameter ambientTolerance: The largest allowable difference in ambient, °C
+    /// - Returns: The compressed LoadCycles, or nil if a tolerance is negative
+    static func Compress(_ samples:[Sample], loadTolerance:Double, ambientTolerance:Double) -> [LoadCycle]? {
+        
+        guard let compressor = LoadSeriesCompressor(loadTolerance: loadTolerance, ambientTolerance: ambientTolerance) else {
+            
+            return nil
+        }
+        
+        for nextSample in samples {
+            
+            compressor.Add(nextSample)
+        }
+        
+        return compressor.Finish()
+    }
+    
+    /// Run the original samples and the compressed LoadCycles through the native engine and compare the results. The model is not modified.
+    /// - Parameter model: The model to run
+    /// - Parameter samples: The original samples (the same ones that were compressed)
+    /// - Parameter loadCycles: The compressed LoadCycles
+    /// - Parameter precision: The precision of the native engine
+    /// - Parameter withCoreOverExcitation: If true, use the core losses with core overexcitation, otherwise normal core losses
+    /// - Returns: The comparison, or nil if either profile could not be run
+    static func Compare(model:OverloadModel, samples:[Sample], loadCycles:[LoadCycle], precision:C57_91_Precision = C57_91_DOUBLE, withCoreOverExcitation:Bool = false) -> Comparison? {
+        
+        guard let firstSample = samples.first, let compressedProfile = PreparedLoadProfile(loadCycles: loadCycles) else {
+            
+            DLog("Nothing to compare!")
+            return nil
+        }
+        
+        var originalCycles:[LoadCycle] = []
+        originalCycles.reserveCapacity(samples.count)
+        var maxLoadError = 0.0
+        var maxAmbientError = 0.0
+        var lastTime = -Double.infinity
+        
+        for nextSample in samples where nextSample.time > lastTime {
+            
+            let time = nextSample.time - firstSample.time
+            originalCycles.append(LoadCycle(cycleStartTime: time / 60.0, ambient: nextSample.ambient, puLoad: nextSample.puLoad))
+            
+            maxLoadError = max(maxLoadError, abs(compressedProfile.Load(atTime: time) - nextSample.puLoad))
+            maxAmbientError = max(maxAmbientError, abs(compressedProfile.Ambient(atTime: time) - nextSample.ambient))
+            lastTime = nextSample.time
+        }
+        
+        guard let original = model.RunNative(loadCycles: originalCycles, precision: precision, withCoreOverExcitation: withCoreOverExcitation), let compressed = model.RunNative(loadCycles: loadCycles, precision: precision, withCoreOverExcitation: withCoreOverExcitation) else {
+            
+            return nil
+        }
+        
+        return Comparison(sampleCount: originalCycles.count, loadCycleCount: loadCycles.count, maxLoadError: maxLoadError, maxAmbientError: maxAmbientError, original: original, compressed: compressed)
+    }
+    
+    /// A Comparison as a String (suitable for printing)
+    static func ComparisonReport(_ comparison:Comparison) -> String {
+        
+        var result = String(format: "%d samples compressed to %d LoadCycles (%0.1f:1)\n", comparison.sampleCount, comparison.loadCycleCount, Double(comparison.sampleCount) / Double(max(1, comparison.loadCycleCount)))
+        result += String(format: "Largest difference from the samples: %0.4f pu load, %0.2f °C ambient\n\n", comparison.maxLoadError, comparison.maxAmbientError)
+        
+        let columnWidth = 12
+        for title in ["", "Original", "Compressed", "Change"] {
+            
+            result += title.CenterInSpace(width: columnWidth)
+        }
+        result += "\n"
+        
+        let rows:[(String, Double, Double, String)] = [("MaxHS (°C)", comparison.original.maxHotspot, comparison.compressed.maxHotspot, "%0.2f"), ("MaxTO (°C)", comparison.original.maxTopOil, comparison.compressed.maxTopOil, "%0.2f"), ("Aging", comparison.original.agingFactor, comparison.compressed.agingFactor, "%0.4f"), ("Steps", Double(comparison.original.steps), Double(comparison.compressed.steps), "%0.f")]
+        for (title, original, compressed, format) in rows {
+            
+            result += title.CenterInSpace(width: columnWidth)
+            result += String(format: format, original).CenterInSpace(width: columnWidth)
+            result += String(format: format, compressed).CenterInSpace(width: columnWidth)
+            result += String(format: format, compressed - original).CenterInSpace(width: columnWidth)
+            result += "\n"
+        }
+        
+        return result
+    }
+    
+    // The LoadCycle for a sample
+    private func Cycle(_ sample:Sample) -> LoadCycle {
+        
+        return LoadCycle(cycleStartTime: (sample.time - self.originTime) / 60.0, ambient: sample.ambient, puLoad: sample.puLoad)
+    }
+}
@@ -118,6 +118,15 @@ struct Losses {
         return result
     }
     
+    // The descriptor for the fused loss kernel (C57_91_StepLosses.h). The losses must be at the kVA base for the losses (ie: these are the tested losses).
+    var descriptor:C57_91_LossDescriptor {
+        
+        get {
+            
+            return C57_91_LossDescriptor(theta_K: self.conductorType == .CU ? 234.5 : 225.0, theta_REF: self.referenceTemperature, Pw: self.windingResistiveLoss, Pe: self.windingEddyLoss, Ps: self.strayLoss, EHS: self.windingHotspotEddyLossPU)
+        }
+    }
+    
     // wrapper for C57.91 equation G.5)
     func TemperatureCorrectionFactor(newTemp:Double) -> Double {
         
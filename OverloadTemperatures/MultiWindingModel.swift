@@ -0,0 +1,466 @@
+//
+//  MultiWindingModel.swift
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-24.
+//
+
+// Overload calculations for units with more than one winding (two- and three-winding transformers, autotransformers with a tertiary, etc). OverloadModel lumps all the windings into one average and one hotspot temperature. Here, every winding has its own losses, hotspot eddy loss, time constant and duct oil, and its own average and hotspot temperatures, but all the windings share the one oil circuit (tank & radiators).
+//
+// The winding equations (G.4 to G.17) are evaluated for all the windings at once, with one SIMD lane per winding (up to 'maxWindings'). Unused lanes hold a copy of the first winding and are masked out of the oil heat balance, so the cost of a step is nearly independent of the number of windings.
+
+import Foundation
+
+// The data for one winding of a MultiWindingModel
+struct WindingData {
+    
+    let name:String
+    
+    // losses at the base model's kvaBaseForLoss and loss reference temperature, W
+    let resistiveLoss:Double
+    let eddyLoss:Double
+    
+    // eddy loss at the hotspot location, per unit of I2R loss (never less than the average eddy loss)
+    let hotspotEddyLossPU:Double
+    
+    // winding time constant, minutes
+    let tau:Double
+    
+    // mass of the winding conductor, lb (if nil, it is calculated from tau using G.7 and G.22)
+    let mass:Double?
+    
+    // the per-unit load of the winding when the unit is at 1 pu load (1.0 for a normal two-winding transformer). The tested temperatures must be at this loading, since the rated losses of the winding (and so its G.6, G.7 and G.16 references) are scaled by the square of it.
+    let loadShare:Double
+    
+    // tested or calculated temperatures of the winding at the base model's kvaBaseForTemperatures, °C
+    let testedAverageTemperature:Double
+    let testedHotspotTemperature:Double
+    
+    // the temperature of the oil at the top of the winding's ducts (if nil, the base model's value is used), °C
+    let testedTopDuctTemperature:Double?
+    
+    init(name:String, resistiveLoss:Double, eddyLoss:Double, hotspotEddyLossPU:Double, tau:Double, mass:Double? = nil, loadShare:Double = 1.0, testedAverageTemperature:Double, testedHotspotTemperature:Double, testedTopDuctTemperature:Double? = nil) {
+        
+        self.name = name
+        self.resistiveLoss = resistiveLoss
+        self.eddyLoss = eddyLoss
+        self.hotspotEddyLossPU = max(hotspotEddyLossPU, eddyLoss / resistiveLoss)
+        self.tau = tau
+        self.mass = mass
+        self.loadShare = loadShare
+        self.testedAverageTemperature = testedAverageTemperature
+        self.testedHotspotTemperature = testedHotspotTemperature
+        self.testedTopDuctTemperature = testedTopDuctTemperature
+    }
+}
+
+class MultiWindingModel: OverloadEngine {
+    
+    typealias Lanes = SIMD4<Double>
+    
+    static let maxWindings = Lanes.scalarCount
+    
+    struct WindingResult {
+        
+        let maxHotspot:OverloadModel.MaxTemp
+        let maxAverage:OverloadModel.MaxTemp
+    }
+    
+    // The state of the unit: one lane per winding, plus the shared oil temperatures
+    struct State {
+        
+        var ambientTemperature:Double
+        var averageWindingTemperatures:Lanes
+        var hotspotTemperatures:Lanes
+        var topDuctTemperatures:Lanes
+        var topFluidTemperatureInTankAndRads:Double
+        var bottomFluidTemperature:Double
+        
+        var averageFluidTemperatureInTankAndRads:Double {
+            
+            get {
+                
+                return (self.topFluidTemperatureInTankAndRads + self.bottomFluidTemperature) / 2.0
+            }
+        }
+    }
+    
+    // The model that holds the data for the core, tank, oil circuit and the unit as a whole (its winding losses and masses are ignored). It is never modified.
+    let baseModel:OverloadModel
+    let windings:[WindingData]
+    
+    var lastCycle:OverloadModel.CycleData? = nil
+    
+    // the maximum temperatures of each winding during the last run
+    var windingResults:[WindingResult] = []
+    
+    // per-winding constants (one lane per winding)
+    private let activeMask:Lanes
+    private let resistiveLoss:Lanes
+    private let eddyLoss:Lanes
+    private let hotspotEddyLossPU:Lanes
+    private let loadShare:Lanes
+    private let tau:Lanes
+    private let mcp:Lanes
+    private let testedAverage:Lanes
+    private let testedHotspot:Lanes
+    private let testedTopDuct:Lanes
+    private let testedAverageDuct:Lanes
+    private let testedHotspotFluid:Lanes
+    private let ratedResistiveLoss:Lanes
+    private let ratedEddyLoss:Lanes
+    private let ratedHsResistiveLoss:Lanes
+    private let ratedHsEddyLoss:Lanes
+    private let testedAveVisc:Lanes
+    private let testedHotspotVisc:Lanes
+    
+    /// Create a multi-winding model
+    /// - Parameter baseModel: The model that holds the data for the core, tank, oil circuit, kVA bases, starting state and exponents, plus the stray and core losses
+    /// - Parameter windings: The windings (at least one and at most maxWindings)
+    /// - Returns: nil if the number of windings is not valid
+    init?(baseModel:OverloadModel, windings:[WindingData]) {
+        
+        if windings.isEmpty || windings.count > MultiWindingModel.maxWindings {
+            
+            DLog("Invalid number of windings!")
+            return nil
+        }
+        
+        self.baseModel = baseModel
+        self.windings = windings
+        
+        // unused lanes get a copy of the first winding
+        func Lane(_ value:(WindingData) -> Double) -> Lanes {
+            
+            var result = Lanes(repeating: value(windings[0]))
+            for i in 0..<windings.count {
+                
+                result[i] = value(windings[i])
+            }
+            
+            return result
+        }
+        
+        var mask = Lanes(repeating: 0.0)
+        for i in 0..<windings.count {
+            
+            mask[i] = 1.0
+        }
+        
+        let tested = baseModel.testedTemperatures
+        let losses = baseModel.testedLosses
+        let thetaK = baseModel.conductorType == .CU ? 234.5 : 225.0
+        let ratedK = baseModel.kVABaseForOverLoad / baseModel.kvaBaseForLoss
+        let ratedFactor = Kw(losses.referenceTemperature, tested.ratedAverageWindingRise + tested.ambientTemperature, thetaK)
+        
+        self.activeMask = mask
+        self.resistiveLoss = Lane { $0.resistiveLoss }
+        self.eddyLoss = Lane { $0.eddyLoss }
+        self.hotspotEddyLossPU = Lane { $0.hotspotEddyLossPU }
+        self.loadShare = Lane { $0.loadShare }
+        self.tau = Lane { $0.tau }
+        self.testedAverage = Lane { $0.testedAverageTemperature }
+        self.testedHotspot = Lane { $0.testedHotspotTemperature }
+        self.testedTopDuct = Lane { $0.testedTopDuctTemperature ?? tested.topFluidTemperatureInCoolingDucts }
+        self.testedAverageDuct = (self.testedTopDuct + tested.bottomFluidTemperature) / 2.0
+        self.testedHotspotFluid = tested.bottomFluidTemperature + tested.hotSpotLocationPU * (self.testedTopDuct - tested.bottomFluidTemperature)
+        
+        // the rated losses of each winding are at its own loading (the same K that Step() uses for the heat generated, at 1 pu load)
+        let ratedWindingK = ratedK * self.loadShare
+        let ratedWindingKSquared = ratedWindingK * ratedWindingK
+        self.ratedResistiveLoss = ratedWindingKSquared * ratedFactor * self.resistiveLoss
+        self.ratedEddyLoss = (ratedWindingKSquared / ratedFactor) * self.eddyLoss
+        
+        let ratedHsFactor = (self.testedHotspot + thetaK) / (losses.referenceTemperature + thetaK)
+        self.ratedHsResistiveLoss = ratedWindingKSquared * ratedHsFactor * self.resistiveLoss
+        self.ratedHsEddyLoss = self.ratedHsResistiveLoss * self.hotspotEddyLossPU
+        
+        let fluidType = baseModel.fluidType
+        self.testedAveVisc = MultiWindingModel.Map((self.testedAverage + self.testedAverageDuct) / 2.0) { MU(fluidType, $0) }
+        self.testedHotspotVisc = MultiWindingModel.Map((self.testedHotspot + self.testedHotspotFluid) / 2.0) { MU(fluidType, $0) }
+        
+        // the thermal capacity of each winding (G.7 and G.22 if the mass was not given)
+        let cp = AppController.StdConductors[Int(baseModel.conductorType.rawValue)].Cp
+        var mcp = Lanes(repeating: 0.0)
+        for i in 0..<MultiWindingModel.maxWindings {
+            
+            let winding = windings[i < windings.count ? i : 0]
+            
+            if let mass = winding.mass {
+                
+                mcp[i] = mass * cp
+            }
+            else {
+                
+                mcp[i] = MCp_W(self.ratedResistiveLoss[i], self.ratedEddyLoss[i], winding.tau, self.testedAverageDuct[i], winding.testedAverageTemperature)
+            }
+        }
+        
+        self.mcp = mcp
+    }
+    
+    /// Do the overload calculations for all the windings at once.
+    /// - Note: The CycleData that is returned treats the unit as a whole: the hotspot and top duct temperatures are the highest of any winding and the average winding temperature is the I2R-weighted average of the windings. The maximum temperatures of the individual windings are in windingResults.
+    /// - Parameter loadCycles: A non-empty array of LoadCycles (see OverloadModel.DoOverloadCalculations() for the restrictions)
+    /// - Parameter saveInterval: The interval (in hours) for saving temperature data (0 means don't save anything)
+    /// - Parameter withCoreOverExcitation: If true, use the core losses with core overexcitation, otherwise normal core losses
+    func DoOverloadCalculations(loadCycles:[LoadCycle], saveInterval:Double, withCoreOverExcitation:Bool = false) -> OverloadModel.CycleData {
+        
+        guard let profile = PreparedLoadProfile(loadCycles: loadCycles) else {
+            
+            return OverloadModel.CycleData.NullData()
+        }
+        
+        if loadCycles.first!.ambient != loadCycles.last!.ambient || loadCycles.first!.puLoad != loadCycles.last!.puLoad {
+            
+            DLog("First and last load cycles are not the same!")
+            return OverloadModel.CycleData.NullData()
+        }
+        
+        let startState = self.baseModel.initialState ?? ThermalState(temps: self.baseModel.testedTemperatures)
+        var state = self.InitialState(startState.temps)
+        
+        var lumped = self.LumpedTemps(state)
+        var maxHotspot = OverloadModel.MaxTemp(temp: lumped.hotSpotWindingTemperature, time: 0.0)
+        var maxTopOil = OverloadModel.MaxTemp(temp: lumped.topFluidTemperatureInTankAndRads, time: 0.0)
+        var maxAveWdg = OverloadModel.MaxTemp(temp: lumped.averageWindingTemperature, time: 0.0)
+        var maxAveOil = OverloadModel.MaxTemp(temp: lumped.averageFluidTemperatureInCoolingDucts, time: 0.0)
+        var windingMaxHotspot = (0..<self.windings.count).map { OverloadModel.MaxTemp(temp: state.hotspotTemperatures[$0], time: 0.0) }
+        var windingMaxAverage = (0..<self.windings.count).map { OverloadModel.MaxTemp(temp: state.averageWindingTemperatures[$0], time: 0.0) }
+        
+        var intermediateData:[OverloadModel.IntermediateData] = [OverloadModel.IntermediateData(time: 0.0, loadPU: loadCycles[0].puLoad, temps: lumped)]
+        var nextSaveTime = saveInterval * 60.0
+        
+        var currentDeltaT = startState.deltaT > 0.0 ? startState.deltaT : 0.5
+        var maxDeltaT = 0.0
+        
+        // the simplified criterion with the shortest time constant
+        let shortestTau = (0..<self.windings.count).map { self.tau[$0] }.min()!
+        if !TestStability(true, self.baseModel.coolingMode, shortestTau, currentDeltaT, &maxDeltaT, nil, nil, nil, nil, nil, nil) {
+            
+            currentDeltaT = maxDeltaT
+        }
+        
+        var lastTime = -currentDeltaT
+        var currentTime = 0.0
+        let endTime = profile.endTime
+        var agingSum = 0.0
+        
+        for segment in 0..<profile.startTimes.count - 1 {
+            
+            let segmentStart = profile.startTimes[segment]
+            let nextLoadCycleStartTime = profile.startTimes[segment + 1]
+            
+            while currentTime < nextLoadCycleStartTime && currentTime < endTime {
+                
+                let K = profile.loadCycles[segment].puLoad + profile.loadSlopes[segment] * (currentTime - segmentStart)
+                let endingAmbient = state.ambientTemperature + profile.ambientSlopes[segment] * (currentTime - lastTime)
+                
+                state = self.Step(state, K: K, deltaT: currentTime - lastTime, endingAmbient: endingAmbient, withCoreOverExcitation: withCoreOverExcitation)
+                lumped = self.LumpedTemps(state)
+                
+                let agingExponent = (15000.0 / 383.0) - (15000.0 / (lumped.hotSpotWindingTemperature + 273.0))
+                agingSum += exp(agingExponent) * currentDeltaT
+                
+                if lumped.hotSpotWindingTemperature > maxHotspot.temp {
+                    
+                    maxHotspot = OverloadModel.MaxTemp(temp: lumped.hotSpotWindingTemperature, time: currentTime)
+                }
+                
+                if lumped.averageWindingTemperature > maxAveWdg.temp {
+                    
+                    maxAveWdg = OverloadModel.MaxTemp(temp: lumped.averageWindingTemperature, time: currentTime)
+                }
+                
+                if lumped.averageFluidTemperatureInCoolingDucts > maxAveOil.temp {
+                    
+                    maxAveOil = OverloadModel.MaxTemp(temp: lumped.averageFluidTemperatureInCoolingDucts, time: currentTime)
+                }
+                
+                if lumped.topFluidTemperatureInTankAndRads > maxTopOil.temp {
+                    
+                    maxTopOil = OverloadModel.MaxTemp(temp: lumped.topFluidTemperatureInTankAndRads, time: currentTime)
+                }
+                
+                for i in 0..<self.windings.count {
+                    
+                    if state.hotspotTemperatures[i] > windingMaxHotspot[i].temp {
+                        
+                        windingMaxHotspot[i] = OverloadModel.MaxTemp(temp: state.hotspotTemperatures[i], time: currentTime)
+                    }
+                    
+                    if state.averageWindingTemperatures[i] > windingMaxAverage[i].temp {
+                        
+                        windingMaxAverage[i] = OverloadModel.MaxTemp(temp: state.averageWindingTemperatures[i], time: currentTime)
+                    }
+                }
+                
+                if saveInterval > 0.0 && currentTime >= nextSaveTime {
+                    
+                    intermediateData.append(OverloadModel.IntermediateData(time: currentTime, loadPU: K, temps: lumped))
+                    nextSaveTime += saveInterval * 60.0
+                }
+                
+                // G.27 for every winding (the most restrictive one wins)
+                for i in 0..<self.windings.count {
+                    
+                    let averageDuct = (state.topDuctTemperatures[i] + state.bottomFluidTemperature) / 2.0
+                    let hotspotFluid = state.bottomFluidTemperature + lumped.hotSpotLocationPU * (state.topDuctTemperatures[i] - state.bottomFluidTemperature)
+                    
+                    var wdgTemp1 = [state.averageWindingTemperatures[i], state.hotspotTemperatures[i]]
+                    var wdgTempR = [self.testedAverage[i], self.testedHotspot[i]]
+                    var oilTemp1 = [averageDuct, hotspotFluid]
+                    var oilTempR = [self.testedAverageDuct[i], self.testedHotspotFluid[i]]
+                    var oilVisc1 = [MU(self.baseModel.fluidType, (wdgTemp1[0] + oilTemp1[0]) / 2.0), MU(self.baseModel.fluidType, (wdgTemp1[1] + oilTemp1[1]) / 2.0)]
+                    var oilViscR = [self.testedAveVisc[i], self.testedHotspotVisc[i]]
+                    
+                    if !TestStability(false, self.baseModel.coolingMode, self.tau[i], currentDeltaT, &maxDeltaT, &wdgTemp1, &wdgTempR, &oilTemp1, &oilTempR, &oilVisc1, &oilViscR) {
+                        
+                        currentDeltaT = min(currentDeltaT, maxDeltaT)
+                    }
+                }
+                
+                lastTime = currentTime
+                currentTime += currentDeltaT
+            }
+        }
+        
+        intermediateData.append(OverloadModel.IntermediateData(time: endTime, loadPU: loadCycles.last!.puLoad, temps: lumped))
+        
+        let cycleData = OverloadModel.CycleData(intermediateData: intermediateData, useOverExcitation: withCoreOverExcitation, maxWdgHotspot: maxHotspot, maxTopOil: maxTopOil, maxWdgAveTemp: maxAveWdg, maxAverageOil: maxAveOil, agingFactor: agingSum / currentTime)
+        
+        self.lastCycle = cycleData
+        self.windingResults = (0..<self.windings.count).map { WindingResult(maxHotspot: windingMaxHotspot[$0], maxAverage: windingMaxAverage[$0]) }
+        
+        return cycleData
+    }
+    
+    /// One Annex G step for all the windings. The equations are the same as OverloadModel.CalculateTempsForLoadCycle(), applied lane-by-lane for G.4 to G.17 and to the shared oil circuit for G.18 to G.26.
+    /// - Parameter state: the state at the start of the step
+    /// - Parameter K: the load at the end of the step (on the kVABaseForOverLoad base), per unit
+    /// - Parameter deltaT: the step length, minutes
+    /// - Parameter endingAmbient: the ambient at the end of the step, °C
+    /// - Parameter withCoreOverExcitation: if true, use the core losses with core overexcitation, otherwise normal core losses
+    /// - Returns: The state at the end of the step
+    func Step(_ state:State, K:Double, deltaT:Double, endingAmbient:Double, withCoreOverExcitation:Bool = false) -> State {
+        
+        let base = self.baseModel
+        let tested = base.testedTemperatures
+        let losses = base.testedLosses
+        let coolingIndex = Int(base.coolingMode.rawValue)
+        let fluidType = base.fluidType
+        let thetaK = base.conductorType == .CU ? 234.5 : 225.0
+        let hhs = tested.hotSpotLocationPU
+        let X = base.xExponent ?? AppController.X[coolingIndex]
+        let Y = base.yExponent ?? AppController.Y[coolingIndex]
+        let Z = base.zExponent ?? AppController.Z[coolingIndex]
+        
+        let bottom = Lanes(repeating: state.bottomFluidTemperature)
+        let topTank = Lanes(repeating: state.topFluidTemperatureInTankAndRads)
+        
+        // G.4 & G.5: heat generated by each winding
+        let lossK = K * base.kVABaseForOverLoad / base.kvaBaseForLoss
+        let windingK = lossK * self.loadShare
+        let kSquared = windingK * windingK
+        let corrFactor = (state.averageWindingTemperatures + thetaK) / (losses.referenceTemperature + thetaK)
+        let heatGeneratedByWdgs = deltaT * kSquared * (self.resistiveLoss * corrFactor + self.eddyLoss / corrFactor)
+        
+        // G.6: heat lost by each winding
+        let averageDuct = (state.topDuctTemperatures + bottom) / 2.0
+        var muFactor = Lanes(repeating: 1.0)
+        if base.coolingMode != .ODAF {
+            
+            let visc = MultiWindingModel.Map((state.averageWindingTemperatures + averageDuct) / 2.0) { MU(fluidType, $0) }
+            muFactor = MultiWindingModel.Map(self.testedAveVisc / visc) { pow($0, 0.25) }
+        }
+        
+        let ratedWindingLoss = self.ratedResistiveLoss + self.ratedEddyLoss
+        let gradientRatio = (state.averageWindingTemperatures - averageDuct) / (self.testedAverage - self.testedAverageDuct)
+        var heatLostByWdgs = MultiWindingModel.Map(gradientRatio) { pow($0, 1.25) } * muFactor * ratedWindingLoss * deltaT
+        heatLostByWdgs.replace(with: 0.0, where: state.averageWindingTemperatures .<= averageDuct)
+        
+        // G.8: average winding temperatures
+        let endingAveWdgTemps = (heatGeneratedByWdgs - heatLostByWdgs + self.mcp * pointwiseMax(state.averageWindingTemperatures, bottom)) / self.mcp
+        
+        // G.9 to G.11: duct oil and oil adjacent to each hotspot
+        let topOverBottomRise = MultiWindingModel.Map(heatLostByWdgs / (deltaT * ratedWindingLoss)) { pow($0, X) } * (self.testedTopDuct - tested.bottomFluidTemperature)
+        var endingTopDuctTemps = bottom + topOverBottomRise
+        let oilAdjacentToHotspot = (bottom + hhs * topOverBottomRise).replacing(with: topTank, where: endingTopDuctTemps + 0.1 .< topTank)
+        
+        let fixedHotspotTemps = pointwiseMax(pointwiseMax(state.hotspotTemperatures, endingAveWdgTemps), oilAdjacentToHotspot)
+        
+        // G.12 to G.15: heat generated at each hotspot
+        let hsCorrFactor = (fixedHotspotTemps + thetaK) / (losses.referenceTemperature + thetaK)
+        let heatGeneratedByHotspots = deltaT * kSquared * self.resistiveLoss * hsCorrFactor * (1.0 + self.hotspotEddyLossPU)
+        
+        // G.16: heat lost at each hotspot
+        var muHsFactor = Lanes(repeating: 1.0)
+        if base.coolingMode != .ODAF {
+            
+            let visc = MultiWindingModel.Map((fixedHotspotTemps + oilAdjacentToHotspot) / 2.0) { MU(fluidType, $0) }
+            muHsFactor = MultiWindingModel.Map(self.testedHotspotVisc / visc) { pow($0, 0.25) }
+        }
+        
+        let hsGradientRatio = (fixedHotspotTemps - oilAdjacentToHotspot) / (self.testedHotspot - self.testedHotspotFluid)
+        let heatLostByHotspots = MultiWindingModel.Map(hsGradientRatio) { pow($0, 1.25) } * muHsFactor * (self.ratedHsResistiveLoss + self.ratedHsEddyLoss) * deltaT
+        
+        // G.17: hotspot temperatures
+        let endingHotspotTemps = (heatGeneratedByHotspots - heatLostByHotspots + self.mcp * state.hotspotTemperatures) / self.mcp
+        
+        // G.18 to G.26: the shared oil circuit. The stray loss is corrected to the I2R-weighted average winding temperature.
+        let weights = self.resistiveLoss * self.activeMask
+        let weightedAveWdgTemp = (weights * state.averageWindingTemperatures).sum() / weights.sum()
+        let strayFactor = Kw(losses.referenceTemperature, weightedAveWdgTemp, thetaK)
+        let heatGeneratedByStrayLoss = deltaT * lossK * lossK * losses.strayLoss / strayFactor
+        
+        let ratedK = base.kVABaseForOverLoad / base.kvaBaseForLoss
+        let ratedFactor = Kw(losses.referenceTemperature, tested.ratedAverageWindingRise + tested.ambientTemperature, thetaK)
+        let ratedCoreLoss = withCoreOverExcitation ? max(losses.coreLoss, losses.coreLossWithOverexcitation) : losses.coreLoss
+        let ratedTotalLoss = (ratedWindingLoss * self.activeMask).sum() + ratedK * ratedK * losses.strayLoss / ratedFactor + ratedCoreLoss
+        
+        let heatLostToAmbient = QLOST_O(state.averageFluidTemperatureInTankAndRads, state.ambientTemperature, tested.averageFluidTemperatureInTankAndRads, tested.ambientTemperature, Y, ratedTotalLoss, deltaT)
+        
+        // same (inverted) selection of the core loss as OverloadModel.CalculateTempsForLoadCycle()
+        let heatGeneratedByCore = deltaT * (withCoreOverExcitation ? losses.coreLoss : losses.coreLossWithOverexcitation)
+        
+        let endingAverageOilInTankAndRadsTemp = Theta_AO_2((heatLostByWdgs * self.activeMask).sum(), heatGeneratedByStrayLoss, heatGeneratedByCore, heatLostToAmbient, state.averageFluidTemperatureInTankAndRads, base.SumM_Cp)
+        
+        let endingTopOilRiseOverBottomOilInTankAndRads = Delta_Theta_ToverB(heatLostToAmbient, ratedTotalLoss, deltaT, Z, tested.topFluidTemperatureInTankAndRads, tested.bottomFluidTemperature)
+        
+        let endingTopOilTemperature = Theta_TO(endingAverageOilInTankAndRadsTemp, endingTopOilRiseOverBottomOilInTankAndRads)
+        let endingBottomOilTemperature = max(endingAmbient, Theta_BO(endingAverageOilInTankAndRadsTemp, endingTopOilRiseOverBottomOilInTankAndRads))
+        
+        endingTopDuctTemps = pointwiseMax(endingTopDuctTemps, Lanes(repeating: endingBottomOilTemperature))
+        
+        return State(ambientTemperature: endingAmbient, averageWindingTemperatures: endingAveWdgTemps, hotspotTemperatures: endingHotspotTemps, topDuctTemperatures: endingTopDuctTemps, topFluidTemperatureInTankAndRads: endingTopOilTemperature, bottomFluidTemperature: endingBottomOilTemperature)
+    }
+    
+    // The starting state: each winding is offset from the base model's starting temperatures by the difference between its tested temperatures and the base model's tested temperatures
+    private func InitialState(_ temps:Temperatures) -> State {
+        
+        let tested = self.baseModel.testedTemperatures
+        
+        return State(ambientTemperature: temps.ambientTemperature, averageWindingTemperatures: temps.averageWindingTemperature + (self.testedAverage - tested.averageWindingTemperature), hotspotTemperatures: temps.hotSpotWindingTemperature + (self.testedHotspot - tested.hotSpotWindingTemperature), topDuctTemperatures: temps.topFluidTemperatureInCoolingDucts + (self.testedTopDuct - tested.topFluidTemperatureInCoolingDucts), topFluidTemperatureInTankAndRads: temps.topFluidTemperatureInTankAndRads, bottomFluidTemperature: temps.bottomFluidTemperature)
+    }
+    
+    // The unit as a whole (see the note in DoOverloadCalculations()). The unused lanes are copies of the first winding, so they don't affect the maximums.
+    private func LumpedTemps(_ state:State) -> Temperatures {
+        
+        let weights = self.resistiveLoss * self.activeMask
+        let averageWdg = (weights * state.averageWindingTemperatures).sum() / weights.sum()
+        
+        return Temperatures(ambientTemperature: state.ambientTemperature, ratedAverageWdgTempRise: self.baseModel.testedTemperatures.ratedAverageWindingRise, averageWdgTemp: averageWdg, hotspotWdgTemp: state.hotspotTemperatures.max(), hotSpotLocationPU: self.baseModel.testedTemperatures.hotSpotLocationPU, topOilTempInDucts: state.topDuctTemperatures.max(), topOilTempInTankAndRads: state.topFluidTemperatureInTankAndRads, bottomOilTemp: state.bottomFluidTemperature)
+    }
+    
+    // Apply a scalar function to every lane (used for the transcendental functions, which have no SIMD versions)
+    private static func Map(_ lanes:Lanes, _ function:(Double) -> Double) -> Lanes {
+        
+        var result = lanes
+        for i in 0..<Lanes.scalarCount {
+            
+            result[i] = function(lanes[i])
+        }
+        
+        return result
+    }
+}
@@ -0,0 +1,88 @@
+//
+//  NativeEngine.swift
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-25.
+//
+
+// Access to the native step engine (C57_91_Engine.h) from an OverloadModel
+
+import Foundation
+
+extension OverloadModel {
+    
+    // The model as a design for the native engine (already prepared)
+    var engineDesign:C57_91_Design {
+        
+        get {
+            
+            let coolingIndex = Int(self.coolingMode.rawValue)
+            let tested = self.testedTemperatures
+            let losses = self.testedLosses
+            
+            var design = C57_91_Design()
+            
+            design.cType = self.coolingMode
+            design.fType = self.fluidType
+            design.wType = self.conductorType
+            design.x = self.xExponent ?? AppController.X[coolingIndex]
+            design.y = self.yExponent ?? AppController.Y[coolingIndex]
+            design.z = self.zExponent ?? AppController.Z[coolingIndex]
+            design.lossK = self.kVABaseForOverLoad / self.kvaBaseForLoss
+            design.tau_W = self.windingTau
+            
+            design.theta_REF = losses.referenceTemperature
+            design.Pw = losses.windingResistiveLoss
+            design.Pe = losses.windingEddyLoss
+            design.EHS = losses.windingHotspotEddyLossPU
+            design.Ps = losses.strayLoss
+            design.PC = losses.coreLoss
+            design.PC_OE = losses.coreLossWithOverexcitation
+            
+            design.theta_A_R = tested.ambientTemperature
+            design.theta_W_R = tested.averageWindingTemperature
+            design.theta_H_R = tested.hotSpotWindingTemperature
+            design.theta_TDO_R = tested.topFluidTemperatureInCoolingDucts
+            design.theta_TO_R = tested.topFluidTemperatureInTankAndRads
+            design.theta_BO_R = tested.bottomFluidTemperature
+            design.HHS = tested.hotSpotLocationPU
+            design.ratedAverageWindingRise = tested.ratedAverageWindingRise
+            
+            design.MCp_W = self.MCp_Wdg
+            design.SumMCp = self.SumM_Cp
+            
+            C57_91_PrepareDesign(&design)
+            
+            return design
+        }
+    }
+    
+    /// Run a load profile on the native engine (the equivalent of DoOverloadCalculations(), without the intermediate data). The model is not modified.
+    /// - Parameter loadCycles: A non-empty array of LoadCycles (see DoOverloadCalculations() for the restrictions)
+    /// - Parameter precision: C57_91_DOUBLE or C57_91_SINGLE
+    /// - Parameter withCoreOverExcitation: If true, use the core losses with core overexcitation, otherwise normal core losses
+    /// - Returns: The result of the run, or nil if the load cycles are not valid
+    func RunNative(loadCycles:[LoadCycle], precision:C57_91_Precision, withCoreOverExcitation:Bool = false) -> C57_91_RunResult? {
+        
+        guard PreparedLoadProfile(loadCycles: loadCycles) != nil else {
+            
+            return nil
+        }
+        
+        var design = self.engineDesign
+        let startState = self.initialState ?? ThermalState(temps: self.testedTemperatures)
+        var start = OverloadModel.EngineState(startState.temps)
+        let profile = loadCycles.map { C57_91_ProfilePoint(time: $0.cycleStartTime * 60.0, K: $0.puLoad, theta_A: $0.ambient) }
+        
+        var result = C57_91_RunResult()
+        C57_91_Run(&design, &start, profile, Int32(profile.count), startState.deltaT, withCoreOverExcitation, precision, nil, 0.0, 0, &result)
+        
+        return result
+    }
+    
+    /// Convert Temperatures to the native engine's state
+    static func EngineState(_ temps:Temperatures) -> C57_91_State {
+        
+        return C57_91_State(theta_A: temps.ambientTemperature, theta_W: temps.averageWindingTemperature, theta_H: temps.hotSpotWindingTemperature, theta_TDO: temps.topFluidTemperatureInCoolingDucts, theta_TO: temps.topFluidTemperatureInTankAndRads, theta_BO: temps.bottomFluidTemperature)
+    }
+}
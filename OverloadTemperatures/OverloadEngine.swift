@@ -0,0 +1,166 @@
+//
+//  OverloadEngine.swift
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-13.
+//
+
+import Foundation
+
+// The common interface for the different overload calculation methods (Annex G heat-balance in OverloadModel and the Clause 7 exponential method in Clause7Model)
+protocol OverloadEngine {
+    
+    /// Do the overload calculations using the given load cycles (see OverloadModel.DoOverloadCalculations() for the restrictions on the loadCycles array)
+    func DoOverloadCalculations(loadCycles:[LoadCycle], saveInterval:Double, withCoreOverExcitation:Bool) -> OverloadModel.CycleData
+}
+
+extension OverloadModel: OverloadEngine {
+    
+}
+
+// Two-tier screening of a fleet: every unit is run with the cheap Clause 7 method, and only the units whose results are close to or above the limits (the "marginal" cases) are re-run with the full Annex G calculation.
+//
+// The screen's correctness rests entirely on the margins: a unit whose Clause 7 maxima are more than a margin below the limits passes on the Clause 7 result alone, so if Clause 7 under-estimates a maximum by more than its margin, a unit that is actually over the limit can pass. The two methods can differ by several degrees, and the difference depends on the design and the load cycle, so the margins must come from a measurement on units and load cycles that are representative of the fleet (see MeasuredMargins()).
+struct OverloadScreening {
+    
+    struct Result {
+        
+        // the Clause 7 result
+        let screen:OverloadModel.CycleData
+        
+        // the Annex G result (nil if the unit was not marginal)
+        let refined:OverloadModel.CycleData?
+        
+        // true if the final result is within both limits
+        let passed:Bool
+        
+        // the best available result
+        var final:OverloadModel.CycleData {
+            
+            get {
+                
+                return self.refined ?? self.screen
+            }
+        }
+    }
+    
+    // hotspot and top-oil limits, °C
+    let hotspotLimit:Double
+    let topOilLimit:Double
+    
+    // any unit whose Clause 7 hotspot or top-oil maximum is at or above (limit - margin) is re-run with Annex G, °C (see the comment at the top of the struct)
+    let hotspotMargin:Double
+    let topOilMargin:Double
+    
+    /// Set up a screen
+    /// - Parameter hotspotLimit: The hotspot limit, °C
+    /// - Parameter topOilLimit: The top-oil limit, °C
+    /// - Parameter hotspotMargin: The most that Clause 7 can under-estimate the maximum hotspot by, °C (use MeasuredMargins() to get this)
+    /// - Parameter topOilMargin: The most that Clause 7 can under-estimate the maximum top oil by, °C
+    init(hotspotLimit:Double = 180.0, topOilLimit:Double = 110.0, hotspotMargin:Double, topOilMargin:Double) {
+        
+        self.hotspotLimit = hotspotLimit
+        self.topOilLimit = topOilLimit
+        self.hotspotMargin = hotspotMargin
+        self.topOilMargin = topOilMargin
+    }
+    
+    /// Measure the margins by running both methods on a sample of units: the margin for each maximum is the largest amount by which Clause 7 under-estimated it (never less than 0), times the safety factor. The sample must be representative of the fleet and the load cycles that will be screened, since the screen is only as good as these numbers.
+    /// - Parameter models: The sample of units (they will hold the Annex G results on return)
+    /// - Parameter loadCycles: The load cycles to use for every model
+    /// - Parameter withCoreOverExcitation: If true, use the core losses with core overexcitation, otherwise normal core losses
+    /// - Parameter safetyFactor: The measured worst-case deviations are multiplied by this
+    /// - Returns: The margins, or nil if the sample is empty or any of the runs failed
+    static func MeasuredMargins(models:[OverloadModel], loadCycles:[LoadCycle], withCoreOverExcitation:Bool = false, safetyFactor:Double = 1.5) -> (hotspot:Double, topOil:Double)? {
+        
+        if models.isEmpty {
+            
+            DLog("No models to measure!")
+            return nil
+        }
+        
+        var deviations = [(hotspot:Double, topOil:Double)?](repeating: nil, count: models.count)
+        
+        deviations.withUnsafeMutableBufferPointer { buffer in
+            
+            DispatchQueue.concurrentPerform(iterations: models.count) { i in
+                
+                let screen = Clause7Model(model: models[i]).DoOverloadCalculations(loadCycles: loadCycles, saveInterval: 0.0, withCoreOverExcitation: withCoreOverExcitation)
+                let annexG = models[i].DoOverloadCalculations(loadCycles: loadCycles, saveInterval: 0.0, withCoreOverExcitation: withCoreOverExcitation)
+                
+                if screen.agingFactor >= 0.0 && annexG.agingFactor >= 0.0 {
+                    
+                    buffer[i] = (annexG.maxWdgHotspot.temp - screen.maxWdgHotspot.temp, annexG.maxTopOil.temp - screen.maxTopOil.temp)
+                }
+            }
+        }
+        
+        var worstHotspot = 0.0
+        var worstTopOil = 0.0
+        for nextDeviation in deviations {
+            
+            guard let deviation = nextDeviation else {
+                
+                DLog("Could not run one of the models!")
+                return nil
+            }
+            
+            worstHotspot = max(worstHotspot, deviation.hotspot)
+            worstTopOil = max(worstTopOil, deviation.topOil)
+        }
+        
+        return (worstHotspot * safetyFactor, worstTopOil * safetyFactor)
+    }
+    
+    /// Screen a set of models against the limits. Both tiers are run in parallel across the models.
+    /// - Parameter models: The models to screen (the models of the marginal cases will hold the Annex G results on return)
+    /// - Parameter loadCycles: The load cycles to use for every model
+    /// - Parameter withCoreOverExcitation: If true, use the core losses with core overexcitation, otherwise normal core losses
+    /// - Returns: An array of results in the same order as the models
+    func ScreenAndRefine(models:[OverloadModel], loadCycles:[LoadCycle], withCoreOverExcitation:Bool = false) -> [Result] {
+        
+        var screens = [OverloadModel.CycleData](repeating: OverloadModel.CycleData.NullData(), count: models.count)
+        
+        screens.withUnsafeMutableBufferPointer { buffer in
+            
+            DispatchQueue.concurrentPerform(iterations: models.count) { i in
+                
+                buffer[i] = Clause7Model(model: models[i]).DoOverloadCalculations(loadCycles: loadCycles, saveInterval: 0.0, withCoreOverExcitation: withCoreOverExcitation)
+            }
+        }
+        
+        let marginalIndices = screens.indices.filter { self.IsMarginal(screens[$0]) }
+        var refined = [OverloadModel.CycleData?](repeating: nil, count: models.count)
+        
+        refined.withUnsafeMutableBufferPointer { buffer in
+            
+            DispatchQueue.concurrentPerform(iterations: marginalIndices.count) { i in
+                
+                let index = marginalIndices[i]
+                buffer[index] = models[index].DoOverloadCalculations(loadCycles: loadCycles, saveInterval: 0.0, withCoreOverExcitation: withCoreOverExcitation)
+            }
+        }
+        
+        var result:[Result] = []
+        for i in 0..<models.count {
+            
+            let final = refined[i] ?? screens[i]
+            let passed = final.maxWdgHotspot.temp <= self.hotspotLimit && final.maxTopOil.temp <= self.topOilLimit
+            
+            result.append(Result(screen: screens[i], refined: refined[i], passed: passed))
+        }
+        
+        return result
+    }
+    
+    // A result is marginal if either maximum is at or above its limit less the margin (so everything that Clause 7 says fails is confirmed with Annex G too). Failed screening runs (null data) are always considered marginal.
+    private func IsMarginal(_ cycleData:OverloadModel.CycleData) -> Bool {
+        
+        if cycleData.agingFactor < 0.0 {
+            
+            return true
+        }
+        
+        return cycleData.maxWdgHotspot.temp >= self.hotspotLimit - self.hotspotMargin || cycleData.maxTopOil.temp >= self.topOilLimit - self.topOilMargin
+    }
+}
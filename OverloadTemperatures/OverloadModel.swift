@@ -94,6 +94,12 @@ class OverloadModel {
     
     var lastCycle:CycleData? = nil
     
+    // If non-nil, DoOverloadCalculations() starts from this state instead of the tested temperatures (see RestoreState())
+    var initialState:ThermalState? = nil
+    
+    // The state of the model at the end of the last call to DoOverloadCalculations() (nil if it has not been called yet)
+    var currentState:ThermalState? = nil
+    
     // sum of masses times specific heats
     var SumM_Cp:Double {
         
@@ -129,6 +135,58 @@ class OverloadModel {
         self.dataInterval = dataInterval
         self.overloadData = []
         self.lastCycle = nil
+        
+        if let initTemps = initialTemperatures {
+            
+            self.initialState = ThermalState(temps: initTemps)
+        }
+    }
+    
+    /// Restore the model to a previously saved state (usually from a checkpoint file). The next call to DoOverloadCalculations() will start from the restored state instead of the tested temperatures, and the aging accumulated in the state will be carried forward.
+    /// - Parameter state: The state to restore
+    func RestoreState(_ state:ThermalState) {
+        
+        self.initialState = state
+    }
+    
+    /// A new model with the same design data, exponents and initial state as this one, but none of the results of previous runs
+    func FreshCopy() -> OverloadModel {
+        
+        let model = OverloadModel(kvaBaseForTemperatures: self.kvaBaseForTemperatures, kvaBaseForLoss: self.kvaBaseForLoss, kVABaseForOverLoad: self.kVABaseForOverLoad, coolingMode: self.coolingMode, fluidType: self.fluidType, conductorType: self.conductorType, testedTemperatures: self.testedTemperatures, initialTemperatures: nil, testedLosses: self.testedLosses, massOfCore: self.massOfCore, massOfFluid: self.massOfFluid, massOfTank: self.massOfTank, massOfWinding: self.massOfWindings, windingTau: self.windingTau, dataInterval: self.dataInterval)
+        
+        model.xExponent = self.xExponent
+        model.yExponent = self.yExponent
+        model.zExponent = self.zExponent
+        model.initialState = self.initialState
+        
+        return model
+    }
+    
+    // The quantities used by every Annex G step that only depend on the design data (losses, tested temperatures, kVA bases and fluid). They are calculated once per run instead of once per step, and can be shared by any number of runs on models with the same design data (see DesignSweep).
+    struct StepInvariants {
+        
+        // losses at the overload base and the rated average winding temperature
+        let ratedLoss:Losses
+        
+        // losses at the overload base and the rated hotspot temperature
+        let ratedHsLoss:Losses
+        
+        // fluid viscosities at the tested temperatures, cP
+        let testedAveVisc:Double
+        let testedHotspotVisc:Double
+        
+        // the tested losses, for the fused loss kernel
+        let losses:C57_91_LossDescriptor
+    }
+    
+    /// Calculate the StepInvariants for the current design data (this must be redone if the losses, tested temperatures or fluid change)
+    func ComputeStepInvariants() -> StepInvariants {
+        
+        let ratedLoss = self.testedLosses.LossesAtLoadAndTemperature(K: self.kVABaseForOverLoad / self.kvaBaseForLoss, newTemp: self.testedTemperatures.ratedAverageWindingRise + self.testedTemperatures.ambientTemperature)
+        let ratedHsLoss = self.testedLosses.LossesAtLoadAndTemperature(K: self.kVABaseForOverLoad / self.kvaBaseForLoss, newTemp: self.testedTemperatures.hotSpotWindingTemperature)
+        let testedViscosity = FluidViscosity(atTemps: self.testedTemperatures)
+        
+        return StepInvariants(ratedLoss: ratedLoss, ratedHsLoss: ratedHsLoss, testedAveVisc: testedViscosity.aveVisc, testedHotspotVisc: testedViscosity.hotspotVisc, losses: self.testedLosses.descriptor)
     }
     
     /// Do the overload calculations using the given load cycles.
@@ -156,12 +214,13 @@ class OverloadModel {
             return CycleData.NullData()
         }
         
-        var currentTemps:Temperatures = self.testedTemperatures
+        let startState = self.initialState ?? ThermalState(temps: self.testedTemperatures)
+        var currentTemps:Temperatures = startState.temps
         self.maxHotspot = MaxTemp(temp: currentTemps.hotSpotWindingTemperature, time: 0.0)
         self.maxAverageOil = MaxTemp(temp: currentTemps.averageFluidTemperatureInCoolingDucts, time: 0.0)
         self.overloadData.append(IntermediateData(time: 0.0, loadPU: 1.0, temps: currentTemps))
         
-        var currentDeltaT = 0.5 // minutes
+        var currentDeltaT = startState.deltaT > 0.0 ? startState.deltaT : 0.5 // minutes
         var maxDeltaT = 0.0
 
         if !TestStability(true, self.coolingMode, self.windingTau, currentDeltaT, &maxDeltaT, nil, nil, nil, nil, nil, nil) {
@@ -183,6 +242,8 @@ class OverloadModel {
         let oilViscTuple = FluidViscosity(atTemps: self.testedTemperatures)
         var oilViscR = [MU(self.fluidType, (wdgTempR[0] + oilTempR[0]) / 2.0), oilViscTuple.hotspotVisc]
         
+        let invariants = self.ComputeStepInvariants()
+        
         var agingSum = 0.0
         // var finalTemps:Temperatures
         
@@ -201,7 +262,7 @@ class OverloadModel {
             
             while currentTime < nextLoadCycleStartTime {
                 
-                let newTemps = CalculateTempsForLoadCycle(atTime: currentTime, lastTime: lastTime, startingTemps: currentTemps, loadCycle: currentLoadCycle, loadSlope: loadSlope, ambientSlope: ambientSlope, withCoreOverExcitation: withCoreOverExcitation)
+                let newTemps = CalculateTempsForLoadCycle(atTime: currentTime, lastTime: lastTime, startingTemps: currentTemps, loadCycle: currentLoadCycle, loadSlope: loadSlope, ambientSlope: ambientSlope, withCoreOverExcitation: withCoreOverExcitation, invariants: invariants)
                 
                 // Line 2020-2030: Calculate aging acceleration factor & equivalent insulation aging over load cycle (see C57.92-2011 Section 5.2)
                 let agingExponent = (15000.0 / 383.0) - (15000.0 / (newTemps.hotSpotWindingTemperature + 273.0))
@@ -254,16 +315,142 @@ class OverloadModel {
         
         // calculate the equivalent aging factor for the total time period
         let totalAgingFactor = agingSum / currentTime
-        let finalTemps = CalculateTempsForLoadCycle(atTime: endTime, lastTime: endTime - currentDeltaT, startingTemps: currentTemps, loadCycle: lastLoadCycle, loadSlope: 0.0, ambientSlope: 0.0)
+        let finalTemps = CalculateTempsForLoadCycle(atTime: endTime, lastTime: endTime - currentDeltaT, startingTemps: currentTemps, loadCycle: lastLoadCycle, loadSlope: 0.0, ambientSlope: 0.0, invariants: invariants)
         self.overloadData.append(IntermediateData(time: endTime, loadPU: lastLoadCycle.puLoad, temps: finalTemps))
         
         let cycleData = CycleData(intermediateData: self.overloadData, useOverExcitation: withCoreOverExcitation, maxWdgHotspot: self.maxHotspot, maxTopOil: self.maxTopOil, maxWdgAveTemp: self.maxAveWdgTemp, maxAverageOil: self.maxAverageOil, agingFactor: totalAgingFactor)
         
         self.lastCycle = cycleData
+        self.currentState = ThermalState(time: startState.time + endTime, temps: finalTemps, deltaT: currentDeltaT, agingSum: startState.agingSum + agingSum)
         
         return cycleData
     }
     
+    struct PropagationResult {
+        
+        // the state at the end of the propagation
+        let state:ThermalState
+        
+        let maxWdgHotspot:MaxTemp
+        let maxTopOil:MaxTemp
+        let maxWdgAveTemp:MaxTemp
+        let maxAverageOil:MaxTemp
+        
+        // only filled in if a save interval was requested
+        let intermediateData:[IntermediateData]
+    }
+    
+    /// Propagate a state forward in time through a load profile using the same Annex G step as DoOverloadCalculations(). Unlike DoOverloadCalculations(), this routine does not touch any of the model's stored results, so it is safe to call it concurrently on the same model (this is what the parallel-in-time routines do).
+    /// - Parameter state: The starting state. Its 'time' field is interpreted as minutes since the start of the load profile and its agingSum is carried forward.
+    /// - Parameter toTime: The time (minutes since the start of the load profile) at which to stop. The last step is shortened so that the propagation ends exactly at this time, and steps that would cross a LoadCycle breakpoint are shortened to end at the breakpoint.
+    /// - Parameter profile: The load profile
+    /// - Parameter deltaT: The time step to use, in minutes
+    /// - Parameter adaptDeltaT: If true, Δt is reduced whenever the G.27 stability test fails (like DoOverloadCalculations() does)
+    /// - Parameter saveInterval: The interval (in minutes) for saving intermediate data (0 means don't save anything)
+    /// - Parameter withCoreOverExcitation: If true, use the core losses with core overexcitation, otherwise normal core losses
+    /// - Parameter invariants: The StepInvariants to use (if nil, they are calculated from the model)
+    /// - Returns: The state at toTime and the maximum temperatures that occurred along the way
+    func PropagateState(_ state:ThermalState, toTime:Double, profile:PreparedLoadProfile, deltaT:Double, adaptDeltaT:Bool = true, saveInterval:Double = 0.0, withCoreOverExcitation:Bool = false, invariants:StepInvariants? = nil) -> PropagationResult {
+        
+        var currentTemps = state.temps
+        var currentTime = state.time
+        var currentDeltaT = deltaT
+        var maxDeltaT = 0.0
+        var agingSum = state.agingSum
+        
+        var maxHotspot = MaxTemp(temp: currentTemps.hotSpotWindingTemperature, time: currentTime)
+        var maxTopOil = MaxTemp(temp: currentTemps.topFluidTemperatureInTankAndRads, time: currentTime)
+        var maxAveWdg = MaxTemp(temp: currentTemps.averageWindingTemperature, time: currentTime)
+        var maxAveOil = MaxTemp(temp: currentTemps.averageFluidTemperatureInCoolingDucts, time: currentTime)
+        
+        var intermediateData:[IntermediateData] = []
+        var nextSaveTime = currentTime
+        
+        var wdgTempR = [self.testedTemperatures.ratedAverageWindingTemperature, self.testedTemperatures.hotSpotWindingTemperature]
+        var oilTempR = [self.testedTemperatures.averageFluidTemperatureInCoolingDucts, self.testedTemperatures.hotSpotFluidTemperature]
+        var oilViscR = [MU(self.fluidType, (wdgTempR[0] + oilTempR[0]) / 2.0), FluidViscosity(atTemps: self.testedTemperatures).hotspotVisc]
+        
+        let stepInvariants = invariants ?? self.ComputeStepInvariants()
+        
+        while currentTime < toTime {
+            
+            // steps are split at the LoadCycle breakpoints, so every step uses the load & ambient slopes of the segment that it starts in
+            let segment = profile.SegmentIndex(atTime: currentTime)
+            var nextTime = min(currentTime + currentDeltaT, toTime)
+            if segment + 1 < profile.startTimes.count && profile.startTimes[segment + 1] > currentTime {
+                
+                nextTime = min(nextTime, profile.startTimes[segment + 1])
+            }
+            let stepDeltaT = nextTime - currentTime
+            
+            let newTemps = CalculateTempsForLoadCycle(atTime: nextTime, lastTime: currentTime, startingTemps: currentTemps, loadCycle: profile.loadCycles[segment], loadSlope: profile.loadSlopes[segment], ambientSlope: profile.ambientSlopes[segment], withCoreOverExcitation: withCoreOverExcitation, invariants: stepInvariants)
+            
+            let agingExponent = (15000.0 / 383.0) - (15000.0 / (newTemps.hotSpotWindingTemperature + 273.0))
+            agingSum += exp(agingExponent) * stepDeltaT
+            
+            if newTemps.hotSpotWindingTemperature > maxHotspot.temp {
+                
+                maxHotspot = MaxTemp(temp: newTemps.hotSpotWindingTemperature, time: nextTime)
+            }
+            
+            if newTemps.averageWindingTemperature > maxAveWdg.temp {
+                
+                maxAveWdg = MaxTemp(temp: newTemps.averageWindingTemperature, time: nextTime)
+            }
+            
+            if newTemps.averageFluidTemperatureInCoolingDucts > maxAveOil.temp {
+                
+                maxAveOil = MaxTemp(temp: newTemps.averageFluidTemperatureInCoolingDucts, time: nextTime)
+            }
+            
+            if newTemps.topFluidTemperatureInTankAndRads > maxTopOil.temp {
+                
+                maxTopOil = MaxTemp(temp: newTemps.topFluidTemperatureInTankAndRads, time: nextTime)
+            }
+            
+            if saveInterval > 0.0 && nextTime >= nextSaveTime {
+                
+                intermediateData.append(IntermediateData(time: nextTime, loadPU: profile.Load(atTime: nextTime), temps: newTemps))
+                nextSaveTime += saveInterval
+            }
+            
+            currentTemps = newTemps
+            currentTime = nextTime
+            
+            if adaptDeltaT {
+                
+                var wdgTemp1 = [currentTemps.averageWindingTemperature, currentTemps.hotSpotWindingTemperature]
+                var oilTemp1 = [currentTemps.averageFluidTemperatureInCoolingDucts, currentTemps.hotSpotFluidTemperature]
+                let oilViscTuple = FluidViscosity(atTemps: currentTemps)
+                var oilVisc1 = [oilViscTuple.aveVisc, oilViscTuple.hotspotVisc]
+                
+                if !TestStability(false, self.coolingMode, self.windingTau, currentDeltaT, &maxDeltaT, &wdgTemp1, &wdgTempR, &oilTemp1, &oilTempR, &oilVisc1, &oilViscR) {
+                    
+                    currentDeltaT = maxDeltaT
+                }
+            }
+        }
+        
+        let endState = ThermalState(time: currentTime, temps: currentTemps, deltaT: currentDeltaT, agingSum: agingSum)
+        
+        return PropagationResult(state: endState, maxWdgHotspot: maxHotspot, maxTopOil: maxTopOil, maxWdgAveTemp: maxAveWdg, maxAverageOil: maxAveOil, intermediateData: intermediateData)
+    }
+    
+    /// Do a single Annex G step at a constant load and ambient. This is the basic building block for the routines that need to treat the model as a discrete-time system (linearization, state estimation, etc).
+    /// - Parameter temps: the temperatures at the start of the step (the ambient is ignored and replaced by 'ambient')
+    /// - Parameter puLoad: the load (on the kVABaseForOverLoad base) during the step, per unit
+    /// - Parameter ambient: the ambient temperature during the step, °C
+    /// - Parameter deltaT: the step length, in minutes
+    /// - Parameter withCoreOverExcitation: if true, use the  core losses with core overexcitation, otherwise normal core losses
+    /// - Returns: The temperatures at the end of the step
+    func StepTemps(from temps:Temperatures, puLoad:Double, ambient:Double, deltaT:Double, withCoreOverExcitation:Bool = false) -> Temperatures {
+        
+        var startingTemps = temps
+        startingTemps.ambientTemperature = ambient
+        
+        return CalculateTempsForLoadCycle(atTime: deltaT, lastTime: 0.0, startingTemps: startingTemps, loadCycle: LoadCycle(cycleStartTime: 0.0, ambient: ambient, puLoad: puLoad), loadSlope: 0.0, ambientSlope: 0.0, withCoreOverExcitation: withCoreOverExcitation)
+    }
+    
     /// Calculate the new temperatures for the next time interval
     /// - Parameter atTime:the time at which to calculate new temperatures, in minutes since the start of the simulation (corresponds to t2 in the standard)
     /// - Parameter lastTime: the time at which the last set of temperatures was calculated, in minutes since the start of the simulation
@@ -272,24 +459,27 @@ class OverloadModel {
     /// - Parameter loadSlope: the slope of the line between the load at loadCycle and the load at the next LoadCycle, in pu/minute
     /// - Parameter ambientSlople: the slope of the line between the load at loadCycle and the load at the next LoadCycle, in °C/minute
     /// - Parameter withCoreOverExcitation: if true, use the  core losses with core overexcitation, otherwise normal core losses
+    /// - Parameter invariants: the StepInvariants to use (if nil, they are calculated from the model)
     /// - Returns: The temperatures after the time interval
-    private func CalculateTempsForLoadCycle(atTime:Double, lastTime:Double, startingTemps:Temperatures, loadCycle:LoadCycle, loadSlope:Double, ambientSlope:Double,  withCoreOverExcitation:Bool = false) -> Temperatures {
+    func CalculateTempsForLoadCycle(atTime:Double, lastTime:Double, startingTemps:Temperatures, loadCycle:LoadCycle, loadSlope:Double, ambientSlope:Double,  withCoreOverExcitation:Bool = false, invariants:StepInvariants? = nil) -> Temperatures {
         
         // BASIC program uses PL as the variable name for the "PU Load" instead of the more familiar "K", which we use here
         let currentK = loadCycle.puLoad + loadSlope * (atTime - loadCycle.cycleStartTime * 60.0)
         let endingAmbient = startingTemps.ambientTemperature + ambientSlope * (atTime - lastTime)
         
-        // Get the heat generated by the windings
+        // Get the heat generated by the windings and by the stray loss (the fused loss kernel folds the load and Δt into the tested losses once, then corrects for temperature)
         let lossK = currentK * self.kVABaseForOverLoad / self.kvaBaseForLoss
-        let corrLoss = self.testedLosses.LossesAtLoadAndTemperature(K: lossK, newTemp: startingTemps.averageWindingTemperature)
-        let heatGeneratedByWdgs = (atTime - lastTime) * corrLoss.windingLoss
-        let ratedLoss = self.testedLosses.LossesAtLoadAndTemperature(K: self.kVABaseForOverLoad / self.kvaBaseForLoss, newTemp: self.testedTemperatures.ratedAverageWindingRise + self.testedTemperatures.ambientTemperature)
-        let ratedHsLoss = self.testedLosses.LossesAtLoadAndTemperature(K: self.kVABaseForOverLoad / self.kvaBaseForLoss, newTemp: self.testedTemperatures.hotSpotWindingTemperature)
+        let stepInvariants = invariants ?? self.ComputeStepInvariants()
+        let stepLosses = C57_91_PrepareStepLosses(stepInvariants.losses, lossK, atTime - lastTime)
+        var heatGeneratedByStrayLoss = 0.0
+        let heatGeneratedByWdgs = C57_91_WindingHeat(stepLosses, startingTemps.averageWindingTemperature, &heatGeneratedByStrayLoss)
+        let ratedLoss = stepInvariants.ratedLoss
+        let ratedHsLoss = stepInvariants.ratedHsLoss
         
         var heatLostByWdgs = 0.0
         if startingTemps.averageWindingTemperature > startingTemps.averageFluidTemperatureInCoolingDucts {
             
-            heatLostByWdgs = QLOST_W(self.coolingMode, ratedLoss.windingEddyLoss, ratedLoss.windingResistiveLoss, startingTemps.averageFluidTemperatureInCoolingDucts, self.testedTemperatures.averageFluidTemperatureInCoolingDucts, startingTemps.averageWindingTemperature, self.testedTemperatures.averageWindingTemperature, atTime - lastTime, FluidViscosity(atTemps: startingTemps).aveVisc, FluidViscosity(atTemps: self.testedTemperatures).aveVisc)
+            heatLostByWdgs = QLOST_W(self.coolingMode, ratedLoss.windingEddyLoss, ratedLoss.windingResistiveLoss, startingTemps.averageFluidTemperatureInCoolingDucts, self.testedTemperatures.averageFluidTemperatureInCoolingDucts, startingTemps.averageWindingTemperature, self.testedTemperatures.averageWindingTemperature, atTime - lastTime, FluidViscosity(atTemps: startingTemps).aveVisc, stepInvariants.testedAveVisc)
         }
         
         // line 1760-1770: update average oil temp
@@ -310,17 +500,15 @@ class OverloadModel {
         let fixedHotspotTemp = max(startingTemps.hotSpotWindingTemperature, endingAveWdgTemp, endingOilAdjacentToHotspotTemp)
         
         // Line 1840: Calculate heat generated at hot spot
-        let corrHsLoss = self.testedLosses.LossesAtLoadAndTemperature(K: lossK, newTemp: fixedHotspotTemp)
-        let heatGeneratedByHotspot = (atTime - lastTime) * corrHsLoss.windingHotspotLoss
+        let heatGeneratedByHotspot = C57_91_HotspotHeat(stepLosses, fixedHotspotTemp)
         
         // Line 1850-1890: Calculate the viscosity and heat lost for hot-spot depending on the cooling mode
-        let heatLostByHotspot = QLOST_HS(self.coolingMode, ratedHsLoss.windingHotspotEddyLoss, ratedHsLoss.windingResistiveLoss, fixedHotspotTemp, self.testedTemperatures.hotSpotWindingTemperature, endingOilAdjacentToHotspotTemp, self.testedTemperatures.hotSpotFluidTemperature, atTime - lastTime, MU(self.fluidType, (fixedHotspotTemp + endingOilAdjacentToHotspotTemp) / 2.0), FluidViscosity(atTemps: self.testedTemperatures).hotspotVisc)
+        let heatLostByHotspot = QLOST_HS(self.coolingMode, ratedHsLoss.windingHotspotEddyLoss, ratedHsLoss.windingResistiveLoss, fixedHotspotTemp, self.testedTemperatures.hotSpotWindingTemperature, endingOilAdjacentToHotspotTemp, self.testedTemperatures.hotSpotFluidTemperature, atTime - lastTime, MU(self.fluidType, (fixedHotspotTemp + endingOilAdjacentToHotspotTemp) / 2.0), stepInvariants.testedHotspotVisc)
         
         // Line 1900: Calculate the winding hotspot temp
         let endingHotspotTemperature = Theta_H_2(heatGeneratedByHotspot, heatLostByHotspot, self.MCp_Wdg, startingTemps.hotSpotWindingTemperature)
         
-        // Line 1910: Calculate the heat generated by the stray loss
-        let heatGeneratedByStrayLoss = (atTime - lastTime) * corrLoss.strayLoss
+        // Line 1910: the heat generated by the stray loss was calculated with the heat generated by the windings
         
         // Line 1920: Calculate heat lost by fluid to the ambient
         let Y:Double = self.yExponent == nil ? AppController.Y[Int(self.coolingMode.rawValue)] : self.yExponent!
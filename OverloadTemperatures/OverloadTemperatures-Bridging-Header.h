@@ -3,3 +3,5 @@
 //
 
 #import "C57_91_Functions.h"
+#import "C57_91_Engine.h"
+#import "C57_91_ResultCache.h"
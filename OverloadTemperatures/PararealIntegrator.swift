@@ -0,0 +1,190 @@
+//
+//  PararealIntegrator.swift
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-11.
+//
+
+// Parallel-in-time ("parareal") version of the overload calculation, for very long load histories (multi-year loss-of-life studies and the like). The time-stepping in DoOverloadCalculations() is inherently serial, so a single long run can only ever use one core. Parareal gets around this by:
+//
+// 1) Splitting the horizon into N slices
+// 2) Sweeping a cheap "coarse" propagator (the Clause 7 method, with steps of up to an hour, see Clause7Model.PropagateState()) serially over all the slices to get a first guess at the state at the start of each slice
+// 3) Running the expensive "fine" propagator (the normal Δt, with the G.27 stability adjustment) on every slice in parallel, starting from the current guesses
+// 4) Correcting the slice-start states with U(n+1) = G(U(n)) + F(old U(n)) - G(old U(n)) and repeating 3) and 4) until the corrections are smaller than the tolerance
+//
+// After k iterations, the first k slices are exact, so the worst case is the same amount of work as the serial calculation (plus the coarse sweeps). In practice, the Annex G equations are strongly damped and 2 or 3 iterations are usually enough.
+//
+// The speedup with K iterations on N cores is at most 1 / ((K + 1) / r + K / N), where r is how much cheaper a coarse sweep is than the serial fine calculation. The coarse propagator must therefore be much cheaper than the fine one, not just somewhat cheaper: an Annex G coarse step is limited by G.27 to a few minutes (r ≈ 5, so the speedup can never reach 2 whatever N is), while a Clause 7 step is exact for a constant load and only has to stop at the LoadCycle breakpoints (r ≈ 100 for an hourly profile). The Clause 7 model does not agree with Annex G (a few °C at the end of a slice), but a bias like that is exactly what the parareal correction removes.
+
+import Foundation
+
+extension OverloadModel {
+    
+    struct PararealResult {
+        
+        let cycleData:CycleData
+        
+        // the number of parallel (fine) sweeps that were done
+        let iterations:Int
+        
+        // false if maxIterations was reached before the corrections fell below the tolerance
+        let converged:Bool
+    }
+    
+    /// Do the overload calculations using the parareal algorithm. The result converges to the same answer as PropagateState() with the fine time step, which is the same calculation that DoOverloadCalculations() does (the differences are that DoOverloadCalculations() also evaluates the step at time 0 and does not split the steps at the LoadCycle breakpoints).
+    /// - Parameter loadCycles: A non-empty array of LoadCycles (the same restrictions as DoOverloadCalculations() apply)
+    /// - Parameter saveInterval: The interval (in hours) for saving temperature data. Use 0 to skip saving intermediate data (recommended for very long runs).
+    /// - Parameter withCoreOverExcitation: If true, use the core losses with core overexcitation, otherwise normal core losses
+    /// - Parameter sliceCount: The number of time slices (there's no point in making this larger than the number of available cores)
+    /// - Parameter coarseStep: The longest step (minutes) of the coarse (Clause 7) propagator. The coarse steps also stop at every LoadCycle breakpoint.
+    /// - Parameter tolerance: The maximum change (°C) of any slice-start temperature for the iteration to be considered converged
+    /// - Parameter maxIterations: The maximum number of parallel sweeps
+    /// - Returns: The result of the calculation, or nil if the loadCycles array is not valid
+    func DoPararealOverloadCalculations(loadCycles:[LoadCycle], saveInterval:Double, withCoreOverExcitation:Bool = false, sliceCount:Int = ProcessInfo.processInfo.activeProcessorCount, coarseStep:Double = 60.0, tolerance:Double = 0.01, maxIterations:Int = 10) -> PararealResult? {
+        
+        guard let profile = PreparedLoadProfile(loadCycles: loadCycles) else {
+            
+            return nil
+        }
+        
+        let firstLoadCycle = loadCycles.first!
+        let lastLoadCycle = loadCycles.last!
+        if firstLoadCycle.ambient != lastLoadCycle.ambient || firstLoadCycle.puLoad != lastLoadCycle.puLoad {
+            
+            DLog("First and last load cycles are not the same!")
+            return nil
+        }
+        
+        let endTime = profile.endTime
+        let historyState = self.initialState ?? ThermalState(temps: self.testedTemperatures)
+        
+        // use the same starting Δt as the serial calculation
+        var fineDeltaT = historyState.deltaT > 0.0 ? historyState.deltaT : 0.5
+        var maxDeltaT = 0.0
+        if !TestStability(true, self.coolingMode, self.windingTau, fineDeltaT, &maxDeltaT, nil, nil, nil, nil, nil, nil) {
+            
+            fineDeltaT = maxDeltaT
+        }
+        
+        // every slice is at least one fine step long
+        let N = max(1, min(sliceCount, Int(endTime / fineDeltaT)))
+        let sliceTimes = (0...N).map { endTime * Double($0) / Double(N) }
+        let saveMinutes = saveInterval * 60.0
+        
+        let coarseModel = Clause7Model(model: self)
+        coarseModel.maxStep = max(coarseStep, fineDeltaT)
+        
+        func Coarse(_ state:ThermalState, _ slice:Int) -> ThermalState {
+            
+            return coarseModel.PropagateState(state, toTime: sliceTimes[slice + 1], profile: profile, withCoreOverExcitation: withCoreOverExcitation)
+        }
+        
+        // The slice-start states. Aging from any restored history is left out here and added back at the end.
+        var U:[ThermalState] = [ThermalState(time: 0.0, temps: historyState.temps, deltaT: fineDeltaT, agingSum: 0.0)]
+        // The coarse solutions from the previous iteration
+        var G:[ThermalState] = [U[0]]
+        
+        for n in 0..<N {
+            
+            let g = Coarse(U[n], n)
+            U.append(g)
+            G.append(g)
+        }
+        
+        var fineResults = [PropagationResult?](repeating: nil, count: N)
+        var iterations = 0
+        var converged = false
+        var firstOpenSlice = 0
+        
+        while iterations < maxIterations && !converged {
+            
+            let startStates = U
+            let open = firstOpenSlice
+            
+            fineResults.withUnsafeMutableBufferPointer { buffer in
+                
+                DispatchQueue.concurrentPerform(iterations: N - open) { i in
+                    
+                    let n = open + i
+                    // every slice starts with the fine Δt (the slice-start states after the first one come from the coarse sweep, which has no Δt of its own)
+                    buffer[n] = self.PropagateState(startStates[n], toTime: sliceTimes[n + 1], profile: profile, deltaT: fineDeltaT, adaptDeltaT: true, saveInterval: saveMinutes, withCoreOverExcitation: withCoreOverExcitation)
+                }
+            }
+            
+            iterations += 1
+            
+            // serial coarse sweep with the parareal correction
+            var maxChange = 0.0
+            for n in open..<N {
+                
+                let g = Coarse(U[n], n)
+                let newState = PararealCorrection(coarse: g, fine: fineResults[n]!.state, previousCoarse: G[n + 1], ambient: profile.Ambient(atTime: sliceTimes[n + 1]))
+                
+                maxChange = max(maxChange, PararealStateDifference(newState, U[n + 1]))
+                
+                G[n + 1] = g
+                U[n + 1] = newState
+            }
+            
+            // the first open slice was propagated from an exact starting state, so it is now exact as well
+            firstOpenSlice += 1
+            converged = maxChange < tolerance || firstOpenSlice >= N
+        }
+        
+        // collect the maxima & intermediate data from the last fine sweep
+        var intermediateData:[IntermediateData] = saveMinutes > 0.0 ? [IntermediateData(time: 0.0, loadPU: profile.Load(atTime: 0.0), temps: historyState.temps)] : []
+        var maxHotspot = MaxTemp(temp: historyState.temps.hotSpotWindingTemperature, time: 0.0)
+        var maxTopOil = MaxTemp(temp: historyState.temps.topFluidTemperatureInTankAndRads, time: 0.0)
+        var maxAveWdg = MaxTemp(temp: historyState.temps.averageWindingTemperature, time: 0.0)
+        var maxAveOil = MaxTemp(temp: historyState.temps.averageFluidTemperatureInCoolingDucts, time: 0.0)
+        
+        for nextResult in fineResults {
+            
+            guard let sliceResult = nextResult else {
+                
+                continue
+            }
+            
+            intermediateData.append(contentsOf: sliceResult.intermediateData)
+            
+            maxHotspot = sliceResult.maxWdgHotspot.temp > maxHotspot.temp ? sliceResult.maxWdgHotspot : maxHotspot
+            maxTopOil = sliceResult.maxTopOil.temp > maxTopOil.temp ? sliceResult.maxTopOil : maxTopOil
+            maxAveWdg = sliceResult.maxWdgAveTemp.temp > maxAveWdg.temp ? sliceResult.maxWdgAveTemp : maxAveWdg
+            maxAveOil = sliceResult.maxAverageOil.temp > maxAveOil.temp ? sliceResult.maxAverageOil : maxAveOil
+        }
+        
+        let finalState = U[N]
+        let cycleData = CycleData(intermediateData: intermediateData, useOverExcitation: withCoreOverExcitation, maxWdgHotspot: maxHotspot, maxTopOil: maxTopOil, maxWdgAveTemp: maxAveWdg, maxAverageOil: maxAveOil, agingFactor: finalState.agingSum / endTime)
+        
+        self.maxHotspot = maxHotspot
+        self.maxTopOil = maxTopOil
+        self.maxAveWdgTemp = maxAveWdg
+        self.maxAverageOil = maxAveOil
+        self.lastCycle = cycleData
+        self.currentState = ThermalState(time: historyState.time + endTime, temps: finalState.temps, deltaT: finalState.deltaT, agingSum: historyState.agingSum + finalState.agingSum)
+        
+        return PararealResult(cycleData: cycleData, iterations: iterations, converged: converged)
+    }
+    
+    // U(n+1) = G(new U(n)) + F(old U(n)) - G(old U(n)), applied to each of the Annex G temperatures and the aging sum. The ambient is an input, not a state, so it is simply taken from the load profile.
+    private func PararealCorrection(coarse:ThermalState, fine:ThermalState, previousCoarse:ThermalState, ambient:Double) -> ThermalState {
+        
+        func Corrected(_ keyPath:KeyPath<Temperatures, Double>) -> Double {
+            
+            return coarse.temps[keyPath: keyPath] + fine.temps[keyPath: keyPath] - previousCoarse.temps[keyPath: keyPath]
+        }
+        
+        let temps = Temperatures(ambientTemperature: ambient, ratedAverageWdgTempRise: fine.temps.ratedAverageWindingRise, averageWdgTemp: Corrected(\.averageWindingTemperature), hotspotWdgTemp: Corrected(\.hotSpotWindingTemperature), hotSpotLocationPU: fine.temps.hotSpotLocationPU, topOilTempInDucts: Corrected(\.topFluidTemperatureInCoolingDucts), topOilTempInTankAndRads: Corrected(\.topFluidTemperatureInTankAndRads), bottomOilTemp: Corrected(\.bottomFluidTemperature))
+        
+        return ThermalState(time: fine.time, temps: temps, deltaT: fine.deltaT, agingSum: coarse.agingSum + fine.agingSum - previousCoarse.agingSum)
+    }
+    
+    // The largest difference between any of the Annex G temperatures of two states, °C
+    private func PararealStateDifference(_ state1:ThermalState, _ state2:ThermalState) -> Double {
+        
+        let t1 = state1.temps
+        let t2 = state2.temps
+        
+        return max(abs(t1.averageWindingTemperature - t2.averageWindingTemperature), abs(t1.hotSpotWindingTemperature - t2.hotSpotWindingTemperature), abs(t1.topFluidTemperatureInCoolingDucts - t2.topFluidTemperatureInCoolingDucts), abs(t1.topFluidTemperatureInTankAndRads - t2.topFluidTemperatureInTankAndRads), abs(t1.bottomFluidTemperature - t2.bottomFluidTemperature))
+    }
+}
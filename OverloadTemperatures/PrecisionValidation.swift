@@ -0,0 +1,157 @@
+//
+//  PrecisionValidation.swift
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-25.
+//
+
+// Validation of the single-precision mode of the native engine against the double-precision engine (the reference), and of the double-precision engine against OverloadModel itself
+
+import Foundation
+
+struct PrecisionValidation {
+    
+    struct Case {
+        
+        let name:String
+        let model:OverloadModel
+        let loadCycles:[LoadCycle]
+    }
+    
+    struct Deviation {
+        
+        let name:String
+        
+        // maximum temperatures from OverloadModel.DoOverloadCalculations()
+        let modelMaxHotspot:Double
+        
+        // the double- and single-precision runs of the native engine
+        let doubleResult:C57_91_RunResult
+        let singleResult:C57_91_RunResult
+        
+        // the largest difference between any of the state temperatures of the single- and double-precision runs, over the whole trace, °C
+        let maxStateDeviation:Double
+        
+        var maxHotspotDeviation:Double {
+            
+            get {
+                
+                return abs(self.singleResult.maxHotspot - self.doubleResult.maxHotspot)
+            }
+        }
+        
+        var maxTopOilDeviation:Double {
+            
+            get {
+                
+                return abs(self.singleResult.maxTopOil - self.doubleResult.maxTopOil)
+            }
+        }
+        
+        var agingDeviationPU:Double {
+            
+            get {
+                
+                return abs(self.singleResult.agingFactor - self.doubleResult.agingFactor) / self.doubleResult.agingFactor
+            }
+        }
+    }
+    
+    // the interval between the trace points that are compared, minutes
+    static let traceInterval = 1.0
+    
+    /// Run every case in both precisions and compare the results.
+    /// - Parameter cases: The cases to run
+    /// - Returns: The deviations, or nil if any of the cases has invalid load cycles
+    static func Validate(cases:[Case]) -> [Deviation]? {
+        
+        var result:[Deviation] = []
+        
+        for nextCase in cases {
+            
+            guard let profile = PreparedLoadProfile(loadCycles: nextCase.loadCycles) else {
+                
+                return nil
+            }
+            
+            var design = nextCase.model.engineDesign
+            let startState = nextCase.model.initialState ?? ThermalState(temps: nextCase.model.testedTemperatures)
+            var start = OverloadModel.EngineState(startState.temps)
+            let points = nextCase.loadCycles.map { C57_91_ProfilePoint(time: $0.cycleStartTime * 60.0, K: $0.puLoad, theta_A: $0.ambient) }
+            let traceCapacity = Int(profile.endTime / PrecisionValidation.traceInterval) + 2
+            
+            var doubleTrace = [C57_91_State](repeating: C57_91_State(), count: traceCapacity)
+            var singleTrace = [C57_91_State](repeating: C57_91_State(), count: traceCapacity)
+            var doubleResult = C57_91_RunResult()
+            var singleResult = C57_91_RunResult()
+            
+            C57_91_Run(&design, &start, points, Int32(points.count), startState.deltaT, false, C57_91_DOUBLE, &doubleTrace, PrecisionValidation.traceInterval, Int32(traceCapacity), &doubleResult)
+            C57_91_Run(&design, &start, points, Int32(points.count), startState.deltaT, false, C57_91_SINGLE, &singleTrace, PrecisionValidation.traceInterval, Int32(traceCapacity), &singleResult)
+            
+            var maxStateDeviation = 0.0
+            for i in 0..<Int(min(doubleResult.traceCount, singleResult.traceCount)) {
+                
+                let d = doubleTrace[i]
+                let s = singleTrace[i]
+                
+                maxStateDeviation = max(maxStateDeviation, abs(d.theta_W - s.theta_W), abs(d.theta_H - s.theta_H), abs(d.theta_TDO - s.theta_TDO), abs(d.theta_TO - s.theta_TO), abs(d.theta_BO - s.theta_BO))
+            }
+            
+            // the reference model (a fresh copy, so that the caller's model does not accumulate data, but with the same initial state)
+            let cycleData = nextCase.model.FreshCopy().DoOverloadCalculations(loadCycles: nextCase.loadCycles, saveInterval: 0.0)
+            
+            result.append(Deviation(name: nextCase.name, modelMaxHotspot: cycleData.maxWdgHotspot.temp, doubleResult: doubleResult, singleResult: singleResult, maxStateDeviation: maxStateDeviation))
+        }
+        
+        return result
+    }
+    
+    /// The deviations as a report (suitable for printing or saving to a text file)
+    static func Report(_ deviations:[Deviation]) -> String {
+        
+        let columnWidth = 11
+        var result = "Single precision vs. double precision (native engine)\n\n"
+        
+        for title in ["Case", "MaxHS(D)", "MaxHS(S)", "ΔMaxHS", "ΔMaxTO", "ΔAging(pu)", "ΔState", "Steps(D/S)"] {
+            
+            result += title.CenterInSpace(width: columnWidth)
+        }
+        result += "\n"
+        
+        var worstState = 0.0
+        for nextDeviation in deviations {
+            
+            result += nextDeviation.name.CenterInSpace(width: columnWidth)
+            result += String(format: "%0.4f", nextDeviation.doubleResult.maxHotspot).CenterInSpace(width: columnWidth)
+            result += String(format: "%0.4f", nextDeviation.singleResult.maxHotspot).CenterInSpace(width: columnWidth)
+            result += String(format: "%0.2e", nextDeviation.maxHotspotDeviation).CenterInSpace(width: columnWidth)
+            result += String(format: "%0.2e", nextDeviation.maxTopOilDeviation).CenterInSpace(width: columnWidth)
+            result += String(format: "%0.2e", nextDeviation.agingDeviationPU).CenterInSpace(width: columnWidth)
+            result += String(format: "%0.2e", nextDeviation.maxStateDeviation).CenterInSpace(width: columnWidth)
+            result += "\(nextDeviation.doubleResult.steps)/\(nextDeviation.singleResult.steps)".CenterInSpace(width: columnWidth)
+            result += "\n"
+            
+            worstState = max(worstState, nextDeviation.maxStateDeviation)
+        }
+        
+        result += String(format: "\nMaximum deviation of any state temperature: %0.2e °C\n\n", worstState)
+        
+        result += "Double-precision native engine vs. OverloadModel\n\n"
+        for title in ["Case", "Model", "Engine", "ΔMaxHS"] {
+            
+            result += title.CenterInSpace(width: columnWidth)
+        }
+        result += "\n"
+        
+        for nextDeviation in deviations {
+            
+            result += nextDeviation.name.CenterInSpace(width: columnWidth)
+            result += String(format: "%0.4f", nextDeviation.modelMaxHotspot).CenterInSpace(width: columnWidth)
+            result += String(format: "%0.4f", nextDeviation.doubleResult.maxHotspot).CenterInSpace(width: columnWidth)
+            result += String(format: "%0.2e", abs(nextDeviation.doubleResult.maxHotspot - nextDeviation.modelMaxHotspot)).CenterInSpace(width: columnWidth)
+            result += "\n"
+        }
+        
+        return result
+    }
+}
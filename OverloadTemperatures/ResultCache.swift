@@ -0,0 +1,99 @@
+//
+//  ResultCache.swift
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-26.
+//
+
+// Swift access to the content-addressed result cache (C57_91_ResultCache.h). Runs are done on the native engine, so the key covers everything in the model that the engine uses (losses, tested temperatures, masses, exponents, cooling, fluid and conductor type and the starting state) plus the LoadCycle array and the options.
+
+import Foundation
+
+class ResultCache {
+    
+    private let cache:OpaquePointer
+    
+    // the interval between the trace points of a run that is stored in the cache, minutes
+    let traceInterval:Double
+    
+    var statistics:C57_91_CacheStatistics {
+        
+        get {
+            
+            return C57_91_CacheGetStatistics(self.cache)
+        }
+    }
+    
+    /// Open a cache
+    /// - Parameter memoryEntries: The number of entries in the in-memory tier
+    /// - Parameter path: The file for the on-disk tier (nil means no on-disk tier). A file that was written with a different number of entries or by a different version of the engine is not used (see C57_91_CacheOpen()).
+    /// - Parameter diskEntries: The number of entries in the on-disk tier
+    /// - Parameter traceInterval: The interval between the trace points of a run, before decimation (0 means don't store a trace)
+    /// - Returns: nil if the cache could not be created
+    init?(memoryEntries:Int = 4096, path:String? = nil, diskEntries:Int = 65536, traceInterval:Double = 15.0) {
+        
+        guard let newCache = C57_91_CacheOpen(Int32(memoryEntries), path, Int32(diskEntries)) else {
+            
+            DLog("Could not open the result cache!")
+            return nil
+        }
+        
+        if path != nil && !C57_91_CacheGetStatistics(newCache).hasDiskTier {
+            
+            DLog("The cache file was written with a different size or engine version, so only the in-memory tier is used")
+        }
+        
+        self.cache = newCache
+        self.traceInterval = traceInterval
+    }
+    
+    deinit {
+        
+        C57_91_CacheClose(self.cache)
+    }
+    
+    /// Get the result of a run, from the cache if possible, otherwise by running the native engine (and storing the result). This is thread-safe.
+    /// - Parameter model: The model (it is not modified)
+    /// - Parameter loadCycles: A non-empty array of LoadCycles (see OverloadModel.DoOverloadCalculations() for the restrictions)
+    /// - Parameter withCoreOverExcitation: If true, use the core losses with core overexcitation, otherwise normal core losses
+    /// - Parameter precision: The precision of the native engine
+    /// - Returns: The result, or nil if the load cycles are not valid
+    func Result(model:OverloadModel, loadCycles:[LoadCycle], withCoreOverExcitation:Bool = false, precision:C57_91_Precision = C57_91_DOUBLE) -> C57_91_CachedResult? {
+        
+        guard let profile = PreparedLoadProfile(loadCycles: loadCycles) else {
+            
+            return nil
+        }
+        
+        var design = model.engineDesign
+        let startState = model.initialState ?? ThermalState(temps: model.testedTemperatures)
+        var start = OverloadModel.EngineState(startState.temps)
+        let points = loadCycles.map { C57_91_ProfilePoint(time: $0.cycleStartTime * 60.0, K: $0.puLoad, theta_A: $0.ambient) }
+        
+        let key = C57_91_CacheKeyForRun(&design, &start, points, Int32(points.count), startState.deltaT, withCoreOverExcitation, precision)
+        
+        var result = C57_91_CachedResult()
+        if C57_91_CacheLookup(self.cache, key, &result) {
+            
+            return result
+        }
+        
+        let traceCapacity = self.traceInterval > 0.0 ? Int(profile.endTime / self.traceInterval) + 2 : 0
+        var trace = [C57_91_State](repeating: C57_91_State(), count: max(1, traceCapacity))
+        var runResult = C57_91_RunResult()
+        
+        if traceCapacity > 0 {
+            
+            C57_91_Run(&design, &start, points, Int32(points.count), startState.deltaT, withCoreOverExcitation, precision, &trace, self.traceInterval, Int32(traceCapacity), &runResult)
+        }
+        else {
+            
+            C57_91_Run(&design, &start, points, Int32(points.count), startState.deltaT, withCoreOverExcitation, precision, nil, 0.0, 0, &runResult)
+        }
+        
+        C57_91_CacheResultFromRun(&runResult, trace, runResult.traceCount, self.traceInterval, &result)
+        C57_91_CacheInsert(self.cache, key, &result)
+        
+        return result
+    }
+}
@@ -0,0 +1,524 @@
+//
+//  SensitivityAnalysis.swift
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-18.
+//
+
+// Sensitivities of the overload results (maximum hotspot, maximum top oil and the aging factor) with respect to the design data. The Annex G step is run once with DualNumbers (forward-mode automatic differentiation) instead of once per parameter with finite differences, so all of the derivatives come out of a single pass through the load cycle.
+
+import Foundation
+
+// The design data that the Annex G step depends on, in generic form
+struct AnnexGDesignData<T:ThermalScalar> {
+    
+    // losses at kvaBaseForLoss and the loss reference temperature, W
+    let windingResistiveLoss:T
+    let windingEddyLoss:T
+    let strayLoss:T
+    let coreLoss:T
+    let coreLossWithOverexcitation:T
+    
+    // eddy loss at the hotspot location, per unit of I2R loss (never less than the average eddy loss)
+    let hotspotEddyLossPU:T
+    
+    // masses, lb
+    let massOfCore:T
+    let massOfFluid:T
+    let massOfTank:T
+    let massOfWindings:T
+    
+    let xExponent:T
+    let yExponent:T
+    let zExponent:T
+    
+    /// Get the design data from a model
+    /// - Parameter model: The model that holds the design data
+    /// - Parameter scalar: A closure that converts the value of a parameter to the scalar type (for DualNumbers, this is where the independent variables are seeded)
+    init(model:OverloadModel, scalar:(Double, OverloadModel.SensitivityParameter) -> T) {
+        
+        let resistiveLoss = scalar(model.ParameterValue(.windingResistiveLoss), .windingResistiveLoss)
+        let eddyLoss = scalar(model.ParameterValue(.windingEddyLoss), .windingEddyLoss)
+        
+        self.windingResistiveLoss = resistiveLoss
+        self.windingEddyLoss = eddyLoss
+        self.strayLoss = scalar(model.ParameterValue(.strayLoss), .strayLoss)
+        self.coreLoss = scalar(model.ParameterValue(.coreLoss), .coreLoss)
+        self.coreLossWithOverexcitation = T(model.testedLosses.coreLossWithOverexcitation)
+        self.hotspotEddyLossPU = max(scalar(model.ParameterValue(.hotspotEddyLossPU), .hotspotEddyLossPU), eddyLoss / resistiveLoss)
+        self.massOfCore = scalar(model.ParameterValue(.massOfCore), .massOfCore)
+        self.massOfFluid = scalar(model.ParameterValue(.massOfFluid), .massOfFluid)
+        self.massOfTank = scalar(model.ParameterValue(.massOfTank), .massOfTank)
+        self.massOfWindings = scalar(model.ParameterValue(.massOfWindings), .massOfWindings)
+        self.xExponent = scalar(model.ParameterValue(.xExponent), .xExponent)
+        self.yExponent = scalar(model.ParameterValue(.yExponent), .yExponent)
+        self.zExponent = scalar(model.ParameterValue(.zExponent), .zExponent)
+    }
+}
+
+// The Annex G temperatures in generic form. The ambient and the hotspot location do not depend on the design data so they stay as Doubles.
+struct AnnexGTemps<T:ThermalScalar> {
+    
+    var ambientTemperature:Double
+    var averageWindingTemperature:T
+    var hotSpotWindingTemperature:T
+    var topFluidTemperatureInCoolingDucts:T
+    var topFluidTemperatureInTankAndRads:T
+    var bottomFluidTemperature:T
+    var hotSpotLocationPU:Double
+    
+    var averageFluidTemperatureInCoolingDucts:T {
+        
+        get {
+            
+            return (self.topFluidTemperatureInCoolingDucts + self.bottomFluidTemperature) / 2.0
+        }
+    }
+    
+    var averageFluidTemperatureInTankAndRads:T {
+        
+        get {
+            
+            return (self.topFluidTemperatureInTankAndRads + self.bottomFluidTemperature) / 2.0
+        }
+    }
+    
+    var hotSpotFluidTemperature:T {
+        
+        get {
+            
+            return self.bottomFluidTemperature + AnnexG.Delta_Theta_WOoverBO(T(self.hotSpotLocationPU), self.bottomFluidTemperature, self.topFluidTemperatureInCoolingDucts)
+        }
+    }
+    
+    init(_ temps:Temperatures) {
+        
+        self.ambientTemperature = temps.ambientTemperature
+        self.averageWindingTemperature = T(temps.averageWindingTemperature)
+        self.hotSpotWindingTemperature = T(temps.hotSpotWindingTemperature)
+        self.topFluidTemperatureInCoolingDucts = T(temps.topFluidTemperatureInCoolingDucts)
+        self.topFluidTemperatureInTankAndRads = T(temps.topFluidTemperatureInTankAndRads)
+        self.bottomFluidTemperature = T(temps.bottomFluidTemperature)
+        self.hotSpotLocationPU = temps.hotSpotLocationPU
+    }
+    
+    /// The plain values as a Temperatures struct
+    func PlainTemps(ratedAverageWdgTempRise:Double) -> Temperatures {
+        
+        return Temperatures(ambientTemperature: self.ambientTemperature, ratedAverageWdgTempRise: ratedAverageWdgTempRise, averageWdgTemp: self.averageWindingTemperature.value, hotspotWdgTemp: self.hotSpotWindingTemperature.value, hotSpotLocationPU: self.hotSpotLocationPU, topOilTempInDucts: self.topFluidTemperatureInCoolingDucts.value, topOilTempInTankAndRads: self.topFluidTemperatureInTankAndRads.value, bottomOilTemp: self.bottomFluidTemperature.value)
+    }
+}
+
+extension OverloadModel {
+    
+    // The design inputs for which sensitivities are calculated. The raw value is the index into the DualNumber partials (and the derivative arrays in SensitivityResult).
+    enum SensitivityParameter: Int, CaseIterable {
+        
+        case windingResistiveLoss = 0
+        case windingEddyLoss
+        case strayLoss
+        case coreLoss
+        case hotspotEddyLossPU
+        case massOfCore
+        case massOfFluid
+        case massOfTank
+        case massOfWindings
+        case windingTau
+        case xExponent
+        case yExponent
+        case zExponent
+        
+        var name:String {
+            
+            get {
+                
+                switch self {
+                
+                case .windingResistiveLoss:
+                    return "Wdg I2R Loss"
+                case .windingEddyLoss:
+                    return "Wdg Eddy Loss"
+                case .strayLoss:
+                    return "Stray Loss"
+                case .coreLoss:
+                    return "Core Loss"
+                case .hotspotEddyLossPU:
+                    return "HS Eddy PU"
+                case .massOfCore:
+                    return "Core Mass"
+                case .massOfFluid:
+                    return "Fluid Mass"
+                case .massOfTank:
+                    return "Tank Mass"
+                case .massOfWindings:
+                    return "Wdg Mass"
+                case .windingTau:
+                    return "Wdg Tau"
+                case .xExponent:
+                    return "x"
+                case .yExponent:
+                    return "y"
+                case .zExponent:
+                    return "z"
+                }
+            }
+        }
+    }
+    
+    struct SensitivityResult {
+        
+        let maxWdgHotspot:MaxTemp
+        let maxTopOil:MaxTemp
+        let agingFactor:Double
+        
+        // The derivatives of each result with respect to each SensitivityParameter (use the raw value of the parameter as the index)
+        let dMaxHotspot:[Double]
+        let dMaxTopOil:[Double]
+        let dAgingFactor:[Double]
+    }
+    
+    /// The current value of a design parameter
+    func ParameterValue(_ parameter:SensitivityParameter) -> Double {
+        
+        let coolingIndex = Int(self.coolingMode.rawValue)
+        
+        switch parameter {
+        
+        case .windingResistiveLoss:
+            return self.testedLosses.windingResistiveLoss
+        case .windingEddyLoss:
+            return self.testedLosses.windingEddyLoss
+        case .strayLoss:
+            return self.testedLosses.strayLoss
+        case .coreLoss:
+            return self.testedLosses.coreLoss
+        case .hotspotEddyLossPU:
+            return self.testedLosses.windingHotspotEddyLossPU
+        case .massOfCore:
+            return self.massOfCore
+        case .massOfFluid:
+            return self.massOfFluid
+        case .massOfTank:
+            return self.massOfTank
+        case .massOfWindings:
+            return self.massOfWindings
+        case .windingTau:
+            return self.windingTau
+        case .xExponent:
+            return self.xExponent ?? AppController.X[coolingIndex]
+        case .yExponent:
+            return self.yExponent ?? AppController.Y[coolingIndex]
+        case .zExponent:
+            return self.zExponent ?? AppController.Z[coolingIndex]
+        }
+    }
+    
+    /// Calculate the derivatives of the maximum hotspot temperature, maximum top oil temperature and aging factor with respect to every SensitivityParameter in a single forward-mode pass through the load cycle. The load cycle is run exactly like DoOverloadCalculations() does (same starting state, same Δt and the same branch decisions), but none of the model's stored results are changed.
+    /// - Note: In this implementation, the winding time constant only sets the maximum Δt (the thermal capacity of the windings comes from massOfWindings), so its derivative is found through the G.7/G.22 relationship between τW and the winding mass.
+    /// - Parameter loadCycles: A non-empty array of LoadCycles (see DoOverloadCalculations() for the restrictions)
+    /// - Parameter withCoreOverExcitation: If true, use the core losses with core overexcitation, otherwise normal core losses
+    /// - Returns: The results and their derivatives, or nil if the loadCycles array is not valid
+    func DoSensitivityCalculations(loadCycles:[LoadCycle], withCoreOverExcitation:Bool = false) -> SensitivityResult? {
+        
+        let design = AnnexGDesignData<DualNumber>(model: self, scalar: { DualNumber($0, seed: $1.rawValue) })
+        
+        guard let result = self.RunAnnexG(design: design, loadCycles: loadCycles, withCoreOverExcitation: withCoreOverExcitation) else {
+            
+            return nil
+        }
+        
+        // dMw/dτW from G.7 and G.22
+        let ratedLoss = self.testedLosses.LossesAtLoadAndTemperature(K: self.kVABaseForOverLoad / self.kvaBaseForLoss, newTemp: self.testedTemperatures.ratedAverageWindingTemperature)
+        let dMCpW_dTau = MCp_W(ratedLoss.windingResistiveLoss, ratedLoss.windingEddyLoss, 1.0, self.testedTemperatures.averageFluidTemperatureInCoolingDucts, self.testedTemperatures.averageWindingTemperature)
+        let dMass_dTau = MW(dMCpW_dTau, AppController.StdConductors[Int(self.conductorType.rawValue)].Cp)
+        
+        func Derivatives(_ x:DualNumber) -> [Double] {
+            
+            var result = SensitivityParameter.allCases.map { x.partials[$0.rawValue] }
+            result[SensitivityParameter.windingTau.rawValue] = x.partials[SensitivityParameter.massOfWindings.rawValue] * dMass_dTau
+            
+            return result
+        }
+        
+        return SensitivityResult(maxWdgHotspot: MaxTemp(temp: result.maxHotspot.value, time: result.maxHotspotTime), maxTopOil: MaxTemp(temp: result.maxTopOil.value, time: result.maxTopOilTime), agingFactor: result.agingFactor.value, dMaxHotspot: Derivatives(result.maxHotspot), dMaxTopOil: Derivatives(result.maxTopOil), dAgingFactor: Derivatives(result.agingFactor))
+    }
+    
+    /// The SensitivityResult as a String (suitable for printing). Besides the derivatives, the change in each result for a +1% change in each parameter is shown.
+    func SensitivityReport(_ sensitivity:SensitivityResult) -> String {
+        
+        var result = String(format: "Max. Hotspot = %0.1f °C, Max. Top Oil = %0.1f °C, Aging Factor = %0.4f\n\n", sensitivity.maxWdgHotspot.temp, sensitivity.maxTopOil.temp, sensitivity.agingFactor)
+        
+        let columnWidth = 14
+        for title in ["Parameter", "Value", "dHS/dP", "HS +1%", "TopOil +1%", "Aging +1%"] {
+            
+            result += title.CenterInSpace(width: columnWidth)
+        }
+        result += "\n"
+        
+        for parameter in SensitivityParameter.allCases {
+            
+            let value = self.ParameterValue(parameter)
+            let onePercent = value * 0.01
+            
+            result += parameter.name.CenterInSpace(width: columnWidth)
+            result += String(format: "%0.4g", value).CenterInSpace(width: columnWidth)
+            result += String(format: "%0.4g", sensitivity.dMaxHotspot[parameter.rawValue]).CenterInSpace(width: columnWidth)
+            result += String(format: "%0.3f", sensitivity.dMaxHotspot[parameter.rawValue] * onePercent).CenterInSpace(width: columnWidth)
+            result += String(format: "%0.3f", sensitivity.dMaxTopOil[parameter.rawValue] * onePercent).CenterInSpace(width: columnWidth)
+            result += String(format: "%0.5f", sensitivity.dAgingFactor[parameter.rawValue] * onePercent).CenterInSpace(width: columnWidth)
+            result += "\n"
+        }
+        
+        return result
+    }
+    
+    /// Run the load cycle with the generic Annex G step. This follows DoOverloadCalculations() step for step (the Δt adjustments are decided on the plain values) but only keeps track of the results that the sensitivity routines need.
+    /// - Parameter design: The design data (in the scalar type to use)
+    /// - Parameter loadCycles: A non-empty array of LoadCycles (see DoOverloadCalculations() for the restrictions)
+    /// - Parameter withCoreOverExcitation: If true, use the core losses with core overexcitation, otherwise normal core losses
+    /// - Returns: The maximum hotspot and top oil temperatures (with the times at which they occurred) and the aging factor, or nil if the loadCycles array is not valid
+    func RunAnnexG<T:ThermalScalar>(design:AnnexGDesignData<T>, loadCycles:[LoadCycle], withCoreOverExcitation:Bool = false) -> (maxHotspot:T, maxHotspotTime:Double, maxTopOil:T, maxTopOilTime:Double, agingFactor:T)? {
+        
+        guard let firstLoadCycle = loadCycles.first, let lastLoadCycle = loadCycles.last, firstLoadCycle.cycleStartTime == 0.0 else {
+            
+            DLog("Invalid loadCycles array!")
+            return nil
+        }
+        
+        if firstLoadCycle.ambient != lastLoadCycle.ambient || firstLoadCycle.puLoad != lastLoadCycle.puLoad {
+            
+            DLog("First and last load cycles are not the same!")
+            return nil
+        }
+        
+        let startState = self.initialState ?? ThermalState(temps: self.testedTemperatures)
+        var currentTemps = AnnexGTemps<T>(startState.temps)
+        
+        var maxHotspot = currentTemps.hotSpotWindingTemperature
+        var maxHotspotTime = 0.0
+        var maxTopOil = currentTemps.topFluidTemperatureInTankAndRads
+        var maxTopOilTime = 0.0
+        
+        var currentDeltaT = startState.deltaT > 0.0 ? startState.deltaT : 0.5 // minutes
+        var maxDeltaT = 0.0
+        
+        if !TestStability(true, self.coolingMode, self.windingTau, currentDeltaT, &maxDeltaT, nil, nil, nil, nil, nil, nil) {
+            
+            currentDeltaT = maxDeltaT
+        }
+        
+        var lastTime = -currentDeltaT
+        var currentTime = 0.0
+        var currentLoadCycleIndex = 0
+        let endTime = lastLoadCycle.cycleStartTime * 60.0
+        
+        var wdgTempR = [self.testedTemperatures.ratedAverageWindingTemperature, self.testedTemperatures.hotSpotWindingTemperature]
+        var oilTempR = [self.testedTemperatures.averageFluidTemperatureInCoolingDucts, self.testedTemperatures.hotSpotFluidTemperature]
+        var oilViscR = [MU(self.fluidType, (wdgTempR[0] + oilTempR[0]) / 2.0), FluidViscosity(atTemps: self.testedTemperatures).hotspotVisc]
+        
+        var agingSum:T = 0.0
+        
+        while currentTime < endTime && currentLoadCycleIndex < loadCycles.count - 1 {
+            
+            let currentLoadCycle = loadCycles[currentLoadCycleIndex]
+            let nextLoadCycleStartTime = loadCycles[currentLoadCycleIndex+1].cycleStartTime * 60.0
+            let loadCycleTimeStep = max(1.0E-12, nextLoadCycleStartTime - currentLoadCycle.cycleStartTime * 60.0)
+            let loadSlope = (loadCycles[currentLoadCycleIndex+1].puLoad - currentLoadCycle.puLoad) / loadCycleTimeStep
+            let ambientSlope = (loadCycles[currentLoadCycleIndex+1].ambient - currentLoadCycle.ambient) / loadCycleTimeStep
+            
+            while currentTime < nextLoadCycleStartTime {
+                
+                let newTemps = self.GenericTempsForLoadCycle(design: design, atTime: currentTime, lastTime: lastTime, startingTemps: currentTemps, loadCycle: currentLoadCycle, loadSlope: loadSlope, ambientSlope: ambientSlope, withCoreOverExcitation: withCoreOverExcitation)
+                
+                agingSum = agingSum + AnnexG.F_AA(newTemps.hotSpotWindingTemperature) * T(currentDeltaT)
+                
+                if newTemps.hotSpotWindingTemperature > maxHotspot {
+                    
+                    maxHotspot = newTemps.hotSpotWindingTemperature
+                    maxHotspotTime = currentTime
+                }
+                
+                if newTemps.topFluidTemperatureInTankAndRads > maxTopOil {
+                    
+                    maxTopOil = newTemps.topFluidTemperatureInTankAndRads
+                    maxTopOilTime = currentTime
+                }
+                
+                currentTemps = newTemps
+                
+                let plainTemps = currentTemps.PlainTemps(ratedAverageWdgTempRise: self.testedTemperatures.ratedAverageWindingRise)
+                var wdgTemp1 = [plainTemps.averageWindingTemperature, plainTemps.hotSpotWindingTemperature]
+                var oilTemp1 = [plainTemps.averageFluidTemperatureInCoolingDucts, plainTemps.hotSpotFluidTemperature]
+                let oilViscTuple = FluidViscosity(atTemps: plainTemps)
+                var oilVisc1 = [oilViscTuple.aveVisc, oilViscTuple.hotspotVisc]
+                
+                if !TestStability(false, self.coolingMode, self.windingTau, currentDeltaT, &maxDeltaT, &wdgTemp1, &wdgTempR, &oilTemp1, &oilTempR, &oilVisc1, &oilViscR) {
+                    
+                    currentDeltaT = maxDeltaT
+                }
+                
+                lastTime = currentTime
+                currentTime += currentDeltaT
+            }
+            
+            currentLoadCycleIndex += 1
+        }
+        
+        return (maxHotspot, maxHotspotTime, maxTopOil, maxTopOilTime, agingSum / T(currentTime))
+    }
+    
+    /// The generic version of CalculateTempsForLoadCycle(). The equations (and the fudges from the BASIC program) are identical, but the design data comes from 'design' instead of the model so that derivatives can be carried through.
+    func GenericTempsForLoadCycle<T:ThermalScalar>(design:AnnexGDesignData<T>, atTime:Double, lastTime:Double, startingTemps:AnnexGTemps<T>, loadCycle:LoadCycle, loadSlope:Double, ambientSlope:Double, withCoreOverExcitation:Bool = false) -> AnnexGTemps<T> {
+        
+        let currentK = loadCycle.puLoad + loadSlope * (atTime - loadCycle.cycleStartTime * 60.0)
+        let endingAmbient = startingTemps.ambientTemperature + ambientSlope * (atTime - lastTime)
+        
+        return self.GenericStep(design: design, startingTemps: startingTemps, puLoad: T(currentK), startingAmbient: T(startingTemps.ambientTemperature), endingAmbient: T(endingAmbient), deltaT: atTime - lastTime, withCoreOverExcitation: withCoreOverExcitation)
+    }
+    
+    /// One Annex G step (the body of GenericTempsForLoadCycle()) with the load and the ambient temperatures as scalars as well, so that derivatives with respect to the inputs can also be carried through (see StepJacobian()).
+    /// - Parameter design: The design data
+    /// - Parameter startingTemps: The temperatures at the start of the step (their ambientTemperature is ignored)
+    /// - Parameter puLoad: The load at the end of the step (on the kVABaseForOverLoad base), per unit
+    /// - Parameter startingAmbient: The ambient at the start of the step, °C
+    /// - Parameter endingAmbient: The ambient at the end of the step, °C
+    /// - Parameter deltaT: The length of the step, minutes
+    /// - Parameter withCoreOverExcitation: If true, use the core losses with core overexcitation, otherwise normal core losses
+    /// - Returns: The temperatures at the end of the step
+    func GenericStep<T:ThermalScalar>(design:AnnexGDesignData<T>, startingTemps:AnnexGTemps<T>, puLoad:T, startingAmbient:T, endingAmbient:T, deltaT stepDeltaT:Double, withCoreOverExcitation:Bool = false) -> AnnexGTemps<T> {
+        
+        let deltaT = T(stepDeltaT)
+        
+        let tested = self.testedTemperatures
+        let testedViscosity = self.FluidViscosity(atTemps: tested)
+        let thetaK = T(self.conductorType == .CU ? 234.5 : 225.0)
+        let referenceTemp = T(self.testedLosses.referenceTemperature)
+        
+        // Losses.LossesAtLoadAndTemperature(), written out for the generic losses
+        let lossK = puLoad * T(self.kVABaseForOverLoad / self.kvaBaseForLoss)
+        let lossKSquared = lossK * lossK
+        let ratedK = self.kVABaseForOverLoad / self.kvaBaseForLoss
+        let ratedKSquared = T(ratedK * ratedK)
+        
+        let corrFactor = AnnexG.Kw(referenceTemp, startingTemps.averageWindingTemperature, thetaK)
+        let corrWindingLoss = lossKSquared * (design.windingResistiveLoss * corrFactor + design.windingEddyLoss / corrFactor)
+        let corrStrayLoss = lossKSquared * design.strayLoss / corrFactor
+        
+        let ratedFactor = AnnexG.Kw(referenceTemp, T(tested.ratedAverageWindingRise + tested.ambientTemperature), thetaK)
+        let ratedResistiveLoss = ratedKSquared * design.windingResistiveLoss * ratedFactor
+        let ratedEddyLoss = ratedKSquared * design.windingEddyLoss / ratedFactor
+        let ratedStrayLoss = ratedKSquared * design.strayLoss / ratedFactor
+        let ratedCoreLoss = withCoreOverExcitation ? max(design.coreLoss, design.coreLossWithOverexcitation) : design.coreLoss
+        let ratedTotalLoss = ratedCoreLoss + ratedResistiveLoss + ratedEddyLoss + ratedStrayLoss
+        
+        let ratedHsFactor = AnnexG.Kw(referenceTemp, T(tested.hotSpotWindingTemperature), thetaK)
+        let ratedHsResistiveLoss = ratedKSquared * design.windingResistiveLoss * ratedHsFactor
+        let ratedHsEddyLoss = ratedHsResistiveLoss * design.hotspotEddyLossPU
+        
+        let cpConductor = T(AppController.StdConductors[Int(self.conductorType.rawValue)].Cp)
+        let mcpWdg = design.massOfWindings * cpConductor
+        let sumMCp = AnnexG.SumMCp(design.massOfTank, T(SPECIFIC_HEAT_STEEL), design.massOfCore, T(SPECIFIC_HEAT_CORESTEEL), design.massOfFluid, T(AppController.StdFluids[Int(self.fluidType.rawValue)].Cp))
+        
+        let heatGeneratedByWdgs = deltaT * corrWindingLoss
+        
+        var heatLostByWdgs:T = 0.0
+        if startingTemps.averageWindingTemperature > startingTemps.averageFluidTemperatureInCoolingDucts {
+            
+            let aveVisc = AnnexG.MU(self.fluidType, (startingTemps.averageWindingTemperature + startingTemps.averageFluidTemperatureInCoolingDucts) / 2.0)
+            heatLostByWdgs = AnnexG.QLOST_W(self.coolingMode, ratedEddyLoss, ratedResistiveLoss, startingTemps.averageFluidTemperatureInCoolingDucts, T(tested.averageFluidTemperatureInCoolingDucts), startingTemps.averageWindingTemperature, T(tested.averageWindingTemperature), deltaT, aveVisc, T(testedViscosity.aveVisc))
+        }
+        
+        let endingAveWdgTemp = AnnexG.Theta_W_2(heatGeneratedByWdgs, heatLostByWdgs, mcpWdg, max(startingTemps.averageWindingTemperature, startingTemps.bottomFluidTemperature))
+        
+        let endingTopOverBottomRise = AnnexG.Delta_Theta_DOoverBO(heatLostByWdgs, design.xExponent, deltaT, ratedResistiveLoss, ratedEddyLoss, T(tested.topFluidTemperatureInCoolingDucts), T(tested.bottomFluidTemperature))
+        
+        var endingTopOilInDuctsTemp = startingTemps.bottomFluidTemperature + endingTopOverBottomRise
+        
+        let endingOilAdjacentToHotspotTemp = (endingTopOilInDuctsTemp + 0.1) < startingTemps.topFluidTemperatureInTankAndRads ? startingTemps.topFluidTemperatureInTankAndRads : startingTemps.bottomFluidTemperature + T(tested.hotSpotLocationPU) * endingTopOverBottomRise
+        
+        let fixedHotspotTemp = max(startingTemps.hotSpotWindingTemperature, endingAveWdgTemp, endingOilAdjacentToHotspotTemp)
+        
+        // Losses.windingHotspotLoss at the corrected temperature
+        let hsCorrFactor = AnnexG.Kw(referenceTemp, fixedHotspotTemp, thetaK)
+        let heatGeneratedByHotspot = deltaT * lossKSquared * design.windingResistiveLoss * hsCorrFactor * (1.0 + design.hotspotEddyLossPU)
+        
+        let hsVisc = AnnexG.MU(self.fluidType, (fixedHotspotTemp + endingOilAdjacentToHotspotTemp) / 2.0)
+        let heatLostByHotspot = AnnexG.QLOST_HS(self.coolingMode, ratedHsEddyLoss, ratedHsResistiveLoss, fixedHotspotTemp, T(tested.hotSpotWindingTemperature), endingOilAdjacentToHotspotTemp, T(tested.hotSpotFluidTemperature), deltaT, hsVisc, T(testedViscosity.hotspotVisc))
+        
+        let endingHotspotTemperature = AnnexG.Theta_H_2(heatGeneratedByHotspot, heatLostByHotspot, mcpWdg, startingTemps.hotSpotWindingTemperature)
+        
+        let heatGeneratedByStrayLoss = deltaT * corrStrayLoss
+        
+        let heatLostToAmbient = AnnexG.QLOST_O(startingTemps.averageFluidTemperatureInTankAndRads, startingAmbient, T(tested.averageFluidTemperatureInTankAndRads), T(tested.ambientTemperature), design.yExponent, ratedTotalLoss, deltaT)
+        
+        // same (inverted) selection of the core loss as CalculateTempsForLoadCycle()
+        let heatGeneratedByCore = deltaT * (withCoreOverExcitation ? design.coreLoss : design.coreLossWithOverexcitation)
+        
+        let endingAverageOilInTankAndRadsTemp = AnnexG.Theta_AO_2(heatLostByWdgs, heatGeneratedByStrayLoss, heatGeneratedByCore, heatLostToAmbient, startingTemps.averageFluidTemperatureInTankAndRads, sumMCp)
+        
+        let endingTopOilRiseOverBottomOilInTankAndRads = AnnexG.Delta_Theta_ToverB(heatLostToAmbient, ratedTotalLoss, deltaT, design.zExponent, T(tested.topFluidTemperatureInTankAndRads), T(tested.bottomFluidTemperature))
+        
+        let endingTopOilTemperature = AnnexG.Theta_TO(endingAverageOilInTankAndRadsTemp, endingTopOilRiseOverBottomOilInTankAndRads)
+        let endingBottomOilTemperature = max(endingAmbient, AnnexG.Theta_BO(endingAverageOilInTankAndRadsTemp, endingTopOilRiseOverBottomOilInTankAndRads))
+        
+        endingTopOilInDuctsTemp = max(endingTopOilInDuctsTemp, endingBottomOilTemperature)
+        
+        var endingTemps = startingTemps
+        endingTemps.ambientTemperature = endingAmbient.value
+        endingTemps.averageWindingTemperature = endingAveWdgTemp
+        endingTemps.hotSpotWindingTemperature = endingHotspotTemperature
+        endingTemps.topFluidTemperatureInCoolingDucts = endingTopOilInDuctsTemp
+        endingTemps.topFluidTemperatureInTankAndRads = endingTopOilTemperature
+        endingTemps.bottomFluidTemperature = endingBottomOilTemperature
+        
+        return endingTemps
+    }
+    
+    /// The Jacobians of one Annex G step at a constant load and ambient, x(k+1) = f(x(k), u(k)), where x is Temperatures.annexGState and u is [load, ambient]. The step is run once with DualNumbers (see GenericStep()), so the derivatives of QLOST_W, QLOST_HS, QLOST_O, the ΔΘ relations and the viscosity corrections are exact instead of finite differences.
+    /// - Note: The step has a few switches from the BASIC program (the oil adjacent to the hotspot is taken from the top oil when the top duct oil is more than 0.1°C below it, and the floors on the winding, hotspot, top duct oil and bottom oil temperatures). The Jacobian is the derivative of whichever branch is active at 'temps', so it is only valid while the state stays on that side of every switch. In particular, at very light loads (bottom oil held at ambient) and near the top-oil switch, a small change of state can change the behaviour of the step much more than the Jacobian says.
+    /// - Parameter temps: The state at which to find the derivatives
+    /// - Parameter puLoad: The load (on the kVABaseForOverLoad base), per unit
+    /// - Parameter ambient: The ambient temperature, °C
+    /// - Parameter deltaT: The length of the step, minutes
+    /// - Parameter withCoreOverExcitation: If true, use the core losses with core overexcitation, otherwise normal core losses
+    /// - Returns: A (5x5, the derivatives with respect to the state) and B (5x2, the derivatives with respect to the load and the ambient)
+    func StepJacobian(at temps:Temperatures, puLoad:Double, ambient:Double, deltaT:Double, withCoreOverExcitation:Bool = false) -> (A:SmallMatrix, B:SmallMatrix) {
+        
+        let n = Temperatures.annexGStateCount
+        let loadSeed = n
+        let ambientSeed = n + 1
+        
+        let design = AnnexGDesignData<DualNumber>(model: self, scalar: { value, _ in DualNumber(value) })
+        
+        let x = temps.annexGState
+        var startingTemps = AnnexGTemps<DualNumber>(temps)
+        startingTemps.ambientTemperature = ambient
+        startingTemps.averageWindingTemperature = DualNumber(x[0], seed: 0)
+        startingTemps.hotSpotWindingTemperature = DualNumber(x[1], seed: 1)
+        startingTemps.topFluidTemperatureInCoolingDucts = DualNumber(x[2], seed: 2)
+        startingTemps.topFluidTemperatureInTankAndRads = DualNumber(x[3], seed: 3)
+        startingTemps.bottomFluidTemperature = DualNumber(x[4], seed: 4)
+        
+        // the ambient is constant over the step, so the starting and ending ambients are the same variable
+        let dualAmbient = DualNumber(ambient, seed: ambientSeed)
+        let endingTemps = self.GenericStep(design: design, startingTemps: startingTemps, puLoad: DualNumber(puLoad, seed: loadSeed), startingAmbient: dualAmbient, endingAmbient: dualAmbient, deltaT: deltaT, withCoreOverExcitation: withCoreOverExcitation)
+        
+        let f = [endingTemps.averageWindingTemperature, endingTemps.hotSpotWindingTemperature, endingTemps.topFluidTemperatureInCoolingDucts, endingTemps.topFluidTemperatureInTankAndRads, endingTemps.bottomFluidTemperature]
+        
+        var A = SmallMatrix(rows: n, cols: n)
+        var B = SmallMatrix(rows: n, cols: 2)
+        
+        for i in 0..<n {
+            
+            for j in 0..<n {
+                
+                A[i, j] = f[i].partials[j]
+            }
+            
+            B[i, 0] = f[i].partials[loadSeed]
+            B[i, 1] = f[i].partials[ambientSeed]
+        }
+        
+        return (A: A, B: B)
+    }
+}
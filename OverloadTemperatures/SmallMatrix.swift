@@ -0,0 +1,228 @@
+//
+//  SmallMatrix.swift
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-16.
+//
+
+// A very simple dense matrix for the handful of small (5x5 and the like) matrices that the state-space routines need. This is not meant to be a general-purpose linear algebra package - use Accelerate for anything big.
+
+import Foundation
+
+struct SmallMatrix {
+    
+    let rows:Int
+    let cols:Int
+    
+    // row-major storage
+    var values:[Double]
+    
+    init(rows:Int, cols:Int, value:Double = 0.0) {
+        
+        self.rows = rows
+        self.cols = cols
+        self.values = [Double](repeating: value, count: rows * cols)
+    }
+    
+    static func Identity(_ size:Int) -> SmallMatrix {
+        
+        var result = SmallMatrix(rows: size, cols: size)
+        for i in 0..<size {
+            
+            result[i, i] = 1.0
+        }
+        
+        return result
+    }
+    
+    // Create a column vector
+    init(column:[Double]) {
+        
+        self.rows = column.count
+        self.cols = 1
+        self.values = column
+    }
+    
+    subscript(row:Int, col:Int) -> Double {
+        
+        get {
+            
+            return self.values[row * self.cols + col]
+        }
+        
+        set {
+            
+            self.values[row * self.cols + col] = newValue
+        }
+    }
+    
+    static func + (lhs:SmallMatrix, rhs:SmallMatrix) -> SmallMatrix {
+        
+        var result = lhs
+        for i in 0..<result.values.count {
+            
+            result.values[i] += rhs.values[i]
+        }
+        
+        return result
+    }
+    
+    static func - (lhs:SmallMatrix, rhs:SmallMatrix) -> SmallMatrix {
+        
+        var result = lhs
+        for i in 0..<result.values.count {
+            
+            result.values[i] -= rhs.values[i]
+        }
+        
+        return result
+    }
+    
+    static func * (lhs:SmallMatrix, rhs:SmallMatrix) -> SmallMatrix {
+        
+        var result = SmallMatrix(rows: lhs.rows, cols: rhs.cols)
+        for i in 0..<lhs.rows {
+            
+            for k in 0..<lhs.cols {
+                
+                let a = lhs[i, k]
+                if a == 0.0 {
+                    
+                    continue
+                }
+                
+                for j in 0..<rhs.cols {
+                    
+                    result.values[i * rhs.cols + j] += a * rhs.values[k * rhs.cols + j]
+                }
+            }
+        }
+        
+        return result
+    }
+    
+    static func * (lhs:Double, rhs:SmallMatrix) -> SmallMatrix {
+        
+        var result = rhs
+        for i in 0..<result.values.count {
+            
+            result.values[i] *= lhs
+        }
+        
+        return result
+    }
+    
+    // The transpose of the matrix
+    var transpose:SmallMatrix {
+        
+        get {
+            
+            var result = SmallMatrix(rows: self.cols, cols: self.rows)
+            for i in 0..<self.rows {
+                
+                for j in 0..<self.cols {
+                    
+                    result[j, i] = self[i, j]
+                }
+            }
+            
+            return result
+        }
+    }
+    
+    /// Solve the system (self) X = B using Gaussian elimination with partial pivoting. The matrix must be square.
+    /// - Parameter B: The right-hand side (any number of columns)
+    /// - Returns: X, or nil if the matrix is singular (or not square)
+    func Solve(_ B:SmallMatrix) -> SmallMatrix? {
+        
+        if self.rows != self.cols || B.rows != self.rows {
+            
+            DLog("Incompatible matrix dimensions!")
+            return nil
+        }
+        
+        let n = self.rows
+        var A = self
+        var X = B
+        
+        for k in 0..<n {
+            
+            // find the pivot
+            var pivot = k
+            for i in k+1..<n {
+                
+                if abs(A[i, k]) > abs(A[pivot, k]) {
+                    
+                    pivot = i
+                }
+            }
+            
+            if A[pivot, k] == 0.0 || !A[pivot, k].isFinite {
+                
+                return nil
+            }
+            
+            if pivot != k {
+                
+                for j in 0..<n {
+                    
+                    let temp = A[k, j]
+                    A[k, j] = A[pivot, j]
+                    A[pivot, j] = temp
+                }
+                
+                for j in 0..<X.cols {
+                    
+                    let temp = X[k, j]
+                    X[k, j] = X[pivot, j]
+                    X[pivot, j] = temp
+                }
+            }
+            
+            for i in k+1..<n {
+                
+                let factor = A[i, k] / A[k, k]
+                if factor == 0.0 {
+                    
+                    continue
+                }
+                
+                for j in k..<n {
+                    
+                    A[i, j] -= factor * A[k, j]
+                }
+                
+                for j in 0..<X.cols {
+                    
+                    X[i, j] -= factor * X[k, j]
+                }
+            }
+        }
+        
+        // back substitution
+        for k in stride(from: n - 1, through: 0, by: -1) {
+            
+            for j in 0..<X.cols {
+                
+                var sum = X[k, j]
+                for i in k+1..<n {
+                    
+                    sum -= A[k, i] * X[i, j]
+                }
+                
+                X[k, j] = sum / A[k, k]
+            }
+        }
+        
+        return X
+    }
+    
+    // The largest absolute value of any element
+    var maxAbs:Double {
+        
+        get {
+            
+            return self.values.reduce(0.0, { max($0, abs($1)) })
+        }
+    }
+}
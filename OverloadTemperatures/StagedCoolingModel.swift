@@ -0,0 +1,291 @@
+//
+//  StagedCoolingModel.swift
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-23.
+//
+
+// Overload calculations for a unit with more than one cooling stage (for example ONAN/ONAF/OFAF), where the fans and pumps are switched on and off by top-oil or hotspot temperature thresholds during the run. Each stage has its own rating, tested temperatures, losses and exponents, and the active stage is chosen inside the step loop, so a single pass gives the whole trajectory.
+//
+// Every stage uses the same physical unit (masses, fluid, conductor and winding time constant come from the base model). The load in the LoadCycles is per-unit on the base model's kVABaseForOverLoad and is converted to each stage's rating when that stage is active.
+
+import Foundation
+
+struct CoolingStage {
+    
+    let coolingMode:C57_91_CoolingType
+    
+    // the kVA at which the stage's tested temperatures apply
+    let kvaRating:Double
+    
+    // tested or calculated temperatures at kvaRating
+    let testedTemperatures:Temperatures
+    
+    // tested or calculated losses at kvaBaseForLoss
+    let testedLosses:Losses
+    let kvaBaseForLoss:Double
+    
+    // if nil, the typical values for the cooling mode are used
+    var xExponent:Double? = nil
+    var yExponent:Double? = nil
+    var zExponent:Double? = nil
+    
+    // The stage is switched on when the top oil or the hotspot reaches its threshold (nil means "not used"). These are ignored for the first stage, which is always on.
+    var topOilOnThreshold:Double? = nil
+    var hotspotOnThreshold:Double? = nil
+    
+    // The stage is switched off when both temperatures are this far below their thresholds, °C
+    var hysteresis:Double = 5.0
+}
+
+class StagedCoolingModel: OverloadEngine {
+    
+    struct StageChange {
+        
+        // minutes since the start of the run
+        let time:Double
+        
+        // index into 'stages'
+        let stage:Int
+    }
+    
+    // the model that holds the physical data of the unit and the base for the load
+    let baseModel:OverloadModel
+    
+    // the stages, in the order that they are switched on
+    let stages:[CoolingStage]
+    
+    // one model per stage
+    private let stageModels:[OverloadModel]
+    
+    var lastCycle:OverloadModel.CycleData? = nil
+    
+    // the stage changes during the last run (the first entry is always the stage at time 0)
+    var stageHistory:[StageChange] = []
+    
+    /// Create a staged cooling model
+    /// - Parameter baseModel: The model that holds the masses, fluid, conductor, winding time constant, starting state and the kVA base for the load
+    /// - Parameter stages: The cooling stages, in the order that they are switched on
+    /// - Returns: nil if there are no stages, or if a stage (other than the first) has no threshold
+    init?(baseModel:OverloadModel, stages:[CoolingStage]) {
+        
+        if stages.isEmpty {
+            
+            DLog("There must be at least one stage!")
+            return nil
+        }
+        
+        for nextStage in stages.dropFirst() {
+            
+            if nextStage.topOilOnThreshold == nil && nextStage.hotspotOnThreshold == nil {
+                
+                DLog("Every stage after the first one needs a threshold!")
+                return nil
+            }
+        }
+        
+        self.baseModel = baseModel
+        self.stages = stages
+        
+        self.stageModels = stages.map { stage in
+            
+            let model = OverloadModel(kvaBaseForTemperatures: stage.kvaRating, kvaBaseForLoss: stage.kvaBaseForLoss, kVABaseForOverLoad: stage.kvaRating, coolingMode: stage.coolingMode, fluidType: baseModel.fluidType, conductorType: baseModel.conductorType, testedTemperatures: stage.testedTemperatures, initialTemperatures: nil, testedLosses: stage.testedLosses, massOfCore: baseModel.massOfCore, massOfFluid: baseModel.massOfFluid, massOfTank: baseModel.massOfTank, massOfWinding: baseModel.massOfWindings, windingTau: baseModel.windingTau, dataInterval: baseModel.dataInterval)
+            
+            model.xExponent = stage.xExponent
+            model.yExponent = stage.yExponent
+            model.zExponent = stage.zExponent
+            
+            return model
+        }
+    }
+    
+    /// Do the overload calculations, switching the cooling stages as the temperatures cross the thresholds.
+    /// - Parameter loadCycles: A non-empty array of LoadCycles (see OverloadModel.DoOverloadCalculations() for the restrictions). The load is per-unit on baseModel.kVABaseForOverLoad.
+    /// - Parameter saveInterval: The interval (in hours) for saving temperature data (0 means don't save anything)
+    /// - Parameter withCoreOverExcitation: If true, use the core losses with core overexcitation, otherwise normal core losses
+    func DoOverloadCalculations(loadCycles:[LoadCycle], saveInterval:Double, withCoreOverExcitation:Bool = false) -> OverloadModel.CycleData {
+        
+        guard let profile = PreparedLoadProfile(loadCycles: loadCycles) else {
+            
+            return OverloadModel.CycleData.NullData()
+        }
+        
+        if loadCycles.first!.ambient != loadCycles.last!.ambient || loadCycles.first!.puLoad != loadCycles.last!.puLoad {
+            
+            DLog("First and last load cycles are not the same!")
+            return OverloadModel.CycleData.NullData()
+        }
+        
+        let invariants = self.stageModels.map { $0.ComputeStepInvariants() }
+        let loadFactors = self.stages.map { self.baseModel.kVABaseForOverLoad / $0.kvaRating }
+        
+        let startState = self.baseModel.initialState ?? ThermalState(temps: self.baseModel.testedTemperatures)
+        var currentTemps = startState.temps
+        var stage = self.InitialStage(currentTemps)
+        self.stageHistory = [StageChange(time: 0.0, stage: stage)]
+        
+        var maxHotspot = OverloadModel.MaxTemp(temp: currentTemps.hotSpotWindingTemperature, time: 0.0)
+        var maxTopOil = OverloadModel.MaxTemp(temp: currentTemps.topFluidTemperatureInTankAndRads, time: 0.0)
+        var maxAveWdg = OverloadModel.MaxTemp(temp: currentTemps.averageWindingTemperature, time: 0.0)
+        var maxAveOil = OverloadModel.MaxTemp(temp: currentTemps.averageFluidTemperatureInCoolingDucts, time: 0.0)
+        
+        var intermediateData:[OverloadModel.IntermediateData] = [OverloadModel.IntermediateData(time: 0.0, loadPU: loadCycles[0].puLoad, temps: currentTemps)]
+        var nextSaveTime = saveInterval * 60.0
+        
+        var currentDeltaT = startState.deltaT > 0.0 ? startState.deltaT : 0.5
+        var maxDeltaT = 0.0
+        
+        // use the most restrictive stage for the starting Δt
+        for nextModel in self.stageModels {
+            
+            if !TestStability(true, nextModel.coolingMode, nextModel.windingTau, currentDeltaT, &maxDeltaT, nil, nil, nil, nil, nil, nil) {
+                
+                currentDeltaT = maxDeltaT
+            }
+        }
+        
+        var lastTime = -currentDeltaT
+        var currentTime = 0.0
+        let endTime = profile.endTime
+        var agingSum = 0.0
+        
+        for segment in 0..<profile.startTimes.count - 1 {
+            
+            let nextLoadCycleStartTime = profile.startTimes[segment + 1]
+            
+            while currentTime < nextLoadCycleStartTime && currentTime < endTime {
+                
+                let model = self.stageModels[stage]
+                let loadFactor = loadFactors[stage]
+                let loadCycle = profile.loadCycles[segment]
+                let stageLoadCycle = LoadCycle(cycleStartTime: loadCycle.cycleStartTime, ambient: loadCycle.ambient, puLoad: loadCycle.puLoad * loadFactor)
+                
+                let newTemps = model.CalculateTempsForLoadCycle(atTime: currentTime, lastTime: lastTime, startingTemps: currentTemps, loadCycle: stageLoadCycle, loadSlope: profile.loadSlopes[segment] * loadFactor, ambientSlope: profile.ambientSlopes[segment], withCoreOverExcitation: withCoreOverExcitation, invariants: invariants[stage])
+                
+                let agingExponent = (15000.0 / 383.0) - (15000.0 / (newTemps.hotSpotWindingTemperature + 273.0))
+                agingSum += exp(agingExponent) * currentDeltaT
+                
+                if newTemps.hotSpotWindingTemperature > maxHotspot.temp {
+                    
+                    maxHotspot = OverloadModel.MaxTemp(temp: newTemps.hotSpotWindingTemperature, time: currentTime)
+                }
+                
+                if newTemps.averageWindingTemperature > maxAveWdg.temp {
+                    
+                    maxAveWdg = OverloadModel.MaxTemp(temp: newTemps.averageWindingTemperature, time: currentTime)
+                }
+                
+                if newTemps.averageFluidTemperatureInCoolingDucts > maxAveOil.temp {
+                    
+                    maxAveOil = OverloadModel.MaxTemp(temp: newTemps.averageFluidTemperatureInCoolingDucts, time: currentTime)
+                }
+                
+                if newTemps.topFluidTemperatureInTankAndRads > maxTopOil.temp {
+                    
+                    maxTopOil = OverloadModel.MaxTemp(temp: newTemps.topFluidTemperatureInTankAndRads, time: currentTime)
+                }
+                
+                if saveInterval > 0.0 && currentTime >= nextSaveTime {
+                    
+                    intermediateData.append(OverloadModel.IntermediateData(time: currentTime, loadPU: profile.Load(atTime: currentTime), temps: newTemps))
+                    nextSaveTime += saveInterval * 60.0
+                }
+                
+                currentTemps = newTemps
+                
+                // switch stages (at most one stage per step)
+                let newStage = self.NextStage(from: stage, temps: currentTemps)
+                if newStage != stage {
+                    
+                    stage = newStage
+                    self.stageHistory.append(StageChange(time: currentTime, stage: stage))
+                }
+                
+                let stageModel = self.stageModels[stage]
+                var wdgTempR = [stageModel.testedTemperatures.ratedAverageWindingTemperature, stageModel.testedTemperatures.hotSpotWindingTemperature]
+                var oilTempR = [stageModel.testedTemperatures.averageFluidTemperatureInCoolingDucts, stageModel.testedTemperatures.hotSpotFluidTemperature]
+                var oilViscR = [MU(stageModel.fluidType, (wdgTempR[0] + oilTempR[0]) / 2.0), invariants[stage].testedHotspotVisc]
+                var wdgTemp1 = [currentTemps.averageWindingTemperature, currentTemps.hotSpotWindingTemperature]
+                var oilTemp1 = [currentTemps.averageFluidTemperatureInCoolingDucts, currentTemps.hotSpotFluidTemperature]
+                let oilViscTuple = stageModel.FluidViscosity(atTemps: currentTemps)
+                var oilVisc1 = [oilViscTuple.aveVisc, oilViscTuple.hotspotVisc]
+                
+                if !TestStability(false, stageModel.coolingMode, stageModel.windingTau, currentDeltaT, &maxDeltaT, &wdgTemp1, &wdgTempR, &oilTemp1, &oilTempR, &oilVisc1, &oilViscR) {
+                    
+                    currentDeltaT = maxDeltaT
+                }
+                
+                lastTime = currentTime
+                currentTime += currentDeltaT
+            }
+        }
+        
+        intermediateData.append(OverloadModel.IntermediateData(time: endTime, loadPU: loadCycles.last!.puLoad, temps: currentTemps))
+        
+        let cycleData = OverloadModel.CycleData(intermediateData: intermediateData, useOverExcitation: withCoreOverExcitation, maxWdgHotspot: maxHotspot, maxTopOil: maxTopOil, maxWdgAveTemp: maxAveWdg, maxAverageOil: maxAveOil, agingFactor: agingSum / currentTime)
+        
+        self.lastCycle = cycleData
+        
+        return cycleData
+    }
+    
+    // The stage that should be active for the starting temperatures (every stage whose threshold is already reached is switched on)
+    private func InitialStage(_ temps:Temperatures) -> Int {
+        
+        var result = 0
+        while result + 1 < self.stages.count && self.IsOn(self.stages[result + 1], temps: temps) {
+            
+            result += 1
+        }
+        
+        return result
+    }
+    
+    // Apply the threshold and hysteresis rules
+    private func NextStage(from stage:Int, temps:Temperatures) -> Int {
+        
+        if stage + 1 < self.stages.count && self.IsOn(self.stages[stage + 1], temps: temps) {
+            
+            return stage + 1
+        }
+        
+        if stage > 0 && self.IsOff(self.stages[stage], temps: temps) {
+            
+            return stage - 1
+        }
+        
+        return stage
+    }
+    
+    // true if either temperature has reached the stage's threshold
+    private func IsOn(_ stage:CoolingStage, temps:Temperatures) -> Bool {
+        
+        if let topOilThreshold = stage.topOilOnThreshold, temps.topFluidTemperatureInTankAndRads >= topOilThreshold {
+            
+            return true
+        }
+        
+        if let hotspotThreshold = stage.hotspotOnThreshold, temps.hotSpotWindingTemperature >= hotspotThreshold {
+            
+            return true
+        }
+        
+        return false
+    }
+    
+    // true if both temperatures are below the stage's thresholds by at least the hysteresis
+    private func IsOff(_ stage:CoolingStage, temps:Temperatures) -> Bool {
+        
+        if let topOilThreshold = stage.topOilOnThreshold, temps.topFluidTemperatureInTankAndRads > topOilThreshold - stage.hysteresis {
+            
+            return false
+        }
+        
+        if let hotspotThreshold = stage.hotspotOnThreshold, temps.hotSpotWindingTemperature > hotspotThreshold - stage.hysteresis {
+            
+            return false
+        }
+        
+        return true
+    }
+}
@@ -142,3 +142,26 @@ struct Temperatures {
         self.bottomFluidTemperature = self.topFluidTemperatureInTankAndRads - topToBottomDiff
     }
 }
+
+// The Annex G temperatures treated as the state vector of a discrete-time system (used by the linearization and state estimation routines). The order of the elements is always: average winding, winding hotspot, top fluid in cooling ducts, top fluid in tank & rads, bottom fluid.
+extension Temperatures {
+    
+    static let annexGStateCount = 5
+    
+    var annexGState:[Double] {
+        
+        get {
+            
+            return [self.averageWindingTemperature, self.hotSpotWindingTemperature, self.topFluidTemperatureInCoolingDucts, self.topFluidTemperatureInTankAndRads, self.bottomFluidTemperature]
+        }
+        
+        set {
+            
+            self.averageWindingTemperature = newValue[0]
+            self.hotSpotWindingTemperature = newValue[1]
+            self.topFluidTemperatureInCoolingDucts = newValue[2]
+            self.topFluidTemperatureInTankAndRads = newValue[3]
+            self.bottomFluidTemperature = newValue[4]
+        }
+    }
+}
@@ -0,0 +1,519 @@
+//
+//  ThermalCalibration.swift
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-20.
+//
+
+// Fit the Annex G exponents (x, y, z), the winding time constant and (optionally) the hotspot eddy loss PU to measured temperatures from a heat run or a field trace, by nonlinear least squares (Levenberg-Marquardt).
+//
+// Every iteration needs one run of the model for the Jacobian (with DualNumbers, so all of the columns come out of a single pass) and one run per trial step. The trial steps are independent, so several of them (with different damping factors) are evaluated concurrently and the best one is kept. Every run starts from the same ThermalState (which can come from a checkpoint file, so the history before the measured trace never needs to be replayed; the trace itself is run in full for every set of parameters, since every part of it depends on them), and the residuals of the accepted trial are reused as the base point for the next iteration.
+//
+// NOTE: In this implementation, the winding time constant does not appear in the heat-balance equations directly (the thermal capacity of the windings comes from massOfWindings). When τW is fitted, the winding mass is set from it using G.7 and G.22 and the core mass is adjusted to keep the core & coil mass constant (G.23), which is exactly how the C57.91 example splits the core & coil mass.
+
+import Foundation
+
+class ThermalCalibration {
+    
+    // A measured set of temperatures. Any temperature that was not measured should be left as nil.
+    struct Measurement {
+        
+        // minutes since the start of the load profile
+        let time:Double
+        
+        let topOil:Double?
+        let hotspot:Double?
+        let bottomOil:Double?
+        let averageWinding:Double?
+        
+        init(time:Double, topOil:Double? = nil, hotspot:Double? = nil, bottomOil:Double? = nil, averageWinding:Double? = nil) {
+            
+            self.time = time
+            self.topOil = topOil
+            self.hotspot = hotspot
+            self.bottomOil = bottomOil
+            self.averageWinding = averageWinding
+        }
+    }
+    
+    struct FitResult {
+        
+        let parameters:[OverloadModel.SensitivityParameter]
+        let values:[Double]
+        
+        // the root-mean-square difference between the model and the measurements at the fitted values, °C
+        let rmsError:Double
+        
+        let iterations:Int
+        
+        // the total number of model runs
+        let evaluations:Int
+        
+        // false if maxIterations was reached (or the fit stalled) before the relative improvement fell below the tolerance
+        let converged:Bool
+    }
+    
+    // the model that holds the design data. It is only modified by Apply().
+    let model:OverloadModel
+    
+    // the parameters to fit. Only .xExponent, .yExponent, .zExponent, .windingTau and .hotspotEddyLossPU are supported.
+    let parameters:[OverloadModel.SensitivityParameter]
+    
+    let profile:PreparedLoadProfile
+    let measurements:[Measurement]
+    
+    // the state at time 0 of the load profile (every model run starts here)
+    let startState:ThermalState
+    
+    let withCoreOverExcitation:Bool
+    
+    var maxIterations = 50
+    
+    // the fit has converged when the relative improvement in the sum of the squared errors is less than this
+    var tolerance = 1.0E-6
+    
+    // the damping factors that are tried (in parallel) at every iteration are the current one times each of these
+    var trialDampingFactors = [0.1, 1.0, 10.0, 100.0]
+    
+    private var evaluations = 0
+    private let evaluationLock = NSLock()
+    
+    /// Set up a calibration
+    /// - Parameter model: The model that holds the design data and the starting values of the parameters
+    /// - Parameter loadCycles: The load that was applied during the measurements (the first LoadCycle must start at time 0, and the last load is held past the end of the array)
+    /// - Parameter measurements: The measured temperatures
+    /// - Parameter parameters: The parameters to fit
+    /// - Parameter startState: The state at time 0 (for instance, from a checkpoint file). If nil, the model's initial state (or its tested temperatures) is used.
+    /// - Parameter withCoreOverExcitation: If true, use the core losses with core overexcitation, otherwise normal core losses
+    /// - Returns: nil if any of the inputs is not valid
+    init?(model:OverloadModel, loadCycles:[LoadCycle], measurements:[Measurement], parameters:[OverloadModel.SensitivityParameter] = [.xExponent, .yExponent, .zExponent, .windingTau], startState:ThermalState? = nil, withCoreOverExcitation:Bool = false) {
+        
+        guard let profile = PreparedLoadProfile(loadCycles: loadCycles) else {
+            
+            return nil
+        }
+        
+        let supported:[OverloadModel.SensitivityParameter] = [.xExponent, .yExponent, .zExponent, .windingTau, .hotspotEddyLossPU]
+        if parameters.isEmpty || parameters.contains(where: { !supported.contains($0) }) {
+            
+            DLog("Unsupported parameter!")
+            return nil
+        }
+        
+        let sortedMeasurements = measurements.sorted(by: { $0.time < $1.time })
+        if sortedMeasurements.isEmpty || sortedMeasurements[0].time < 0.0 {
+            
+            DLog("Invalid measurements!")
+            return nil
+        }
+        
+        self.model = model
+        self.parameters = parameters
+        self.profile = profile
+        self.measurements = sortedMeasurements
+        self.withCoreOverExcitation = withCoreOverExcitation
+        
+        var state = startState ?? model.initialState ?? ThermalState(temps: model.testedTemperatures)
+        state.time = 0.0
+        state.agingSum = 0.0
+        self.startState = state
+    }
+    
+    /// Do the fit. The model is not changed (use Apply() to put the fitted values into the model).
+    /// - Returns: The fitted values, or nil if the model could not be run with the starting values
+    func Fit() -> FitResult? {
+        
+        self.evaluations = 0
+        
+        var values = self.parameters.map { self.model.ParameterValue($0) }
+        
+        guard var residuals = self.Residuals(values) else {
+            
+            DLog("Could not run the model with the starting values!")
+            return nil
+        }
+        
+        var cost = SumOfSquares(residuals)
+        var lambda = 1.0E-3
+        var iterations = 0
+        var converged = false
+        
+        while iterations < self.maxIterations && !converged {
+            
+            iterations += 1
+            
+            guard let J = self.Jacobian(values) else {
+                
+                break
+            }
+            
+            let Jt = J.transpose
+            let JtJ = Jt * J
+            let gradient = Jt * SmallMatrix(column: residuals)
+            
+            // Try several damping factors at once and keep the best step
+            let lambdas = self.trialDampingFactors.map { lambda * $0 }
+            var trials = [(values:[Double], residuals:[Double], cost:Double)?](repeating: nil, count: lambdas.count)
+            
+            trials.withUnsafeMutableBufferPointer { buffer in
+                
+                DispatchQueue.concurrentPerform(iterations: lambdas.count) { i in
+                    
+                    // Marquardt's scaling: (JtJ + λ diag(JtJ)) δ = -Jt r
+                    var damped = JtJ
+                    for k in 0..<damped.rows {
+                        
+                        damped[k, k] += lambdas[i] * max(JtJ[k, k], 1.0E-12)
+                    }
+                    
+                    guard let step = damped.Solve(-1.0 * gradient) else {
+                        
+                        return
+                    }
+                    
+                    let trialValues = self.Clamped(zip(values, step.values).map { $0 + $1 })
+                    
+                    if let trialResiduals = self.Residuals(trialValues) {
+                        
+                        buffer[i] = (trialValues, trialResiduals, self.SumOfSquares(trialResiduals))
+                    }
+                }
+            }
+            
+            var best:Int? = nil
+            for i in 0..<trials.count {
+                
+                if let trial = trials[i], trial.cost.isFinite, trial.cost < (best == nil ? cost : trials[best!]!.cost) {
+                    
+                    best = i
+                }
+            }
+            
+            guard let bestIndex = best, let bestTrial = trials[bestIndex] else {
+                
+                // none of the trials improved things, so increase the damping
+                lambda *= 10.0 * self.trialDampingFactors.max()!
+                
+                if lambda > 1.0E12 {
+                    
+                    // the fit has stalled without meeting the tolerance, so it is reported as not converged
+                    DLog("The fit stalled!")
+                    break
+                }
+                
+                continue
+            }
+            
+            let improvement = (cost - bestTrial.cost) / max(cost, 1.0E-300)
+            
+            values = bestTrial.values
+            residuals = bestTrial.residuals
+            cost = bestTrial.cost
+            lambda = max(lambdas[bestIndex] / 10.0, 1.0E-12)
+            
+            converged = improvement < self.tolerance
+        }
+        
+        let rmsError = sqrt(cost / Double(max(1, residuals.count)))
+        
+        return FitResult(parameters: self.parameters, values: values, rmsError: rmsError, iterations: iterations, evaluations: self.evaluations, converged: converged)
+    }
+    
+    /// Put the fitted values into the model
+    func Apply(_ fit:FitResult) {
+        
+        ThermalCalibration.SetParameters(self.parameters, values: fit.values, on: self.model, from: self.model)
+    }
+    
+    /// The fit as a String (suitable for printing)
+    func FitReport(_ fit:FitResult) -> String {
+        
+        var result = String(format: "Fitted %d parameters to %d measurements in %d iterations (%d model runs)%@\n\n", fit.parameters.count, self.measurements.count, fit.iterations, fit.evaluations, fit.converged ? "" : " - DID NOT CONVERGE")
+        
+        let paddingLength = 20
+        for (parameter, value) in zip(fit.parameters, fit.values) {
+            
+            result += String(format: "%@ = %0.4f (was %0.4f)\n", parameter.name.padding(toLength: paddingLength, withPad: " ", startingAt: 0), value, self.model.ParameterValue(parameter))
+        }
+        
+        result += String(format: "\n%@ = %0.3f °C\n", "RMS Error".padding(toLength: paddingLength, withPad: " ", startingAt: 0), fit.rmsError)
+        
+        return result
+    }
+    
+    /// Check that the last load is held past the end of the load cycles. The temperatures of 'testCase' are "measured" on a copy of its load cycles that explicitly holds the last LoadCycle for another 'hoursPastEnd', at times up to the end of that copy, and then compared to the residuals of a calibration that only gets the original load cycles. Every measurement time (including the end of the original load cycles) is a step boundary in both runs, so the two should agree to round-off.
+    /// - Parameter testCase: The case to run (the C57.91 and T159 cases from AppController, for instance)
+    /// - Parameter hoursPastEnd: How long the last load is held, in hours
+    /// - Returns: The RMS difference, in °C, or nil if the case could not be run
+    static func HeldLoadCheck(_ testCase:PrecisionValidation.Case, hoursPastEnd:Double = 2.0) -> Double? {
+        
+        guard hoursPastEnd > 0.0, let lastLoadCycle = testCase.loadCycles.last, let heldProfile = PreparedLoadProfile(loadCycles: testCase.loadCycles + [LoadCycle(cycleStartTime: lastLoadCycle.cycleStartTime + hoursPastEnd, ambient: lastLoadCycle.ambient, puLoad: lastLoadCycle.puLoad)]) else {
+            
+            DLog("Invalid load cycles!")
+            return nil
+        }
+        
+        let model = testCase.model
+        let invariants = model.ComputeStepInvariants()
+        
+        // the same starting state and Δt as Residuals()
+        var state = model.initialState ?? ThermalState(temps: model.testedTemperatures)
+        state.time = 0.0
+        state.agingSum = 0.0
+        var deltaT = state.deltaT > 0.0 ? state.deltaT : 0.5
+        var maxDeltaT = 0.0
+        if !TestStability(true, model.coolingMode, model.windingTau, deltaT, &maxDeltaT, nil, nil, nil, nil, nil, nil) {
+            
+            deltaT = maxDeltaT
+        }
+        
+        let endTime = lastLoadCycle.cycleStartTime * 60.0
+        let measurementTimes = [endTime / 2.0, endTime, endTime + hoursPastEnd * 30.0, endTime + hoursPastEnd * 60.0]
+        var measurements:[Measurement] = []
+        
+        for time in measurementTimes {
+            
+            state = model.PropagateState(state, toTime: time, profile: heldProfile, deltaT: deltaT, invariants: invariants).state
+            deltaT = state.deltaT
+            
+            measurements.append(Measurement(time: time, topOil: state.temps.topFluidTemperatureInTankAndRads, hotspot: state.temps.hotSpotWindingTemperature, bottomOil: state.temps.bottomFluidTemperature, averageWinding: state.temps.averageWindingTemperature))
+        }
+        
+        // only the x exponent is "fitted", since it is the one parameter that TrialModel() sets without touching the masses
+        guard let calibration = ThermalCalibration(model: model, loadCycles: testCase.loadCycles, measurements: measurements, parameters: [.xExponent]), let residuals = calibration.Residuals([model.xExponent]) else {
+            
+            DLog("Could not run the calibration!")
+            return nil
+        }
+        
+        return sqrt(calibration.SumOfSquares(residuals) / Double(residuals.count))
+    }
+    
+    // The Jacobian of the residuals with respect to the parameters, from a single run of the generic Annex G step with DualNumbers (see SensitivityAnalysis.swift) that is seeded with the parameters being fitted. The run takes exactly the same steps as Residuals() (the step lengths, the G.27 adjustments and every branch in the step are decided on the plain values), so the derivatives are those of the branch that is active at 'values'. Finite differences would straddle the max() switches in the step and the jumps in Δt when τW changes the G.27 limit.
+    private func Jacobian(_ values:[Double]) -> SmallMatrix? {
+        
+        let trialModel = self.TrialModel(values)
+        
+        // τW only gets into the step through the winding and core masses (see SetParameters()), and the winding mass is linear in τW (G.7 and G.22)
+        var massPartials = SIMD16<Double>(repeating: 0.0)
+        if let tauIndex = self.parameters.firstIndex(of: .windingTau) {
+            
+            let ratedLoss = trialModel.testedLosses.LossesAtLoadAndTemperature(K: trialModel.kVABaseForOverLoad / trialModel.kvaBaseForLoss, newTemp: trialModel.testedTemperatures.ratedAverageWindingTemperature)
+            let dMCpW_dTau = MCp_W(ratedLoss.windingResistiveLoss, ratedLoss.windingEddyLoss, 1.0, trialModel.testedTemperatures.averageFluidTemperatureInCoolingDucts, trialModel.testedTemperatures.averageWindingTemperature)
+            massPartials[tauIndex] = MW(dMCpW_dTau, AppController.StdConductors[Int(trialModel.conductorType.rawValue)].Cp)
+        }
+        
+        let design = AnnexGDesignData<DualNumber>(model: trialModel, scalar: { value, parameter in
+            
+            if let index = self.parameters.firstIndex(of: parameter) {
+                
+                return DualNumber(value, seed: index)
+            }
+            
+            switch parameter {
+            
+            case .massOfWindings:
+                return DualNumber(value: value, partials: massPartials)
+            case .massOfCore:
+                return DualNumber(value: value, partials: -massPartials)
+            default:
+                return DualNumber(value)
+            }
+        })
+        
+        // the same starting state and Δt as Residuals()
+        var temps = AnnexGTemps<DualNumber>(self.startState.temps)
+        var currentTime = self.startState.time
+        var deltaT = self.startState.deltaT > 0.0 ? self.startState.deltaT : 0.5
+        var maxDeltaT = 0.0
+        if !TestStability(true, trialModel.coolingMode, trialModel.windingTau, deltaT, &maxDeltaT, nil, nil, nil, nil, nil, nil) {
+            
+            deltaT = maxDeltaT
+        }
+        
+        let tested = trialModel.testedTemperatures
+        var wdgTempR = [tested.ratedAverageWindingTemperature, tested.hotSpotWindingTemperature]
+        var oilTempR = [tested.averageFluidTemperatureInCoolingDucts, tested.hotSpotFluidTemperature]
+        var oilViscR = [MU(trialModel.fluidType, (wdgTempR[0] + oilTempR[0]) / 2.0), trialModel.FluidViscosity(atTemps: tested).hotspotVisc]
+        
+        var rows:[DualNumber] = []
+        
+        for measurement in self.measurements {
+            
+            // the same steps as OverloadModel.PropagateState()
+            while currentTime < measurement.time {
+                
+                let segment = self.profile.SegmentIndex(atTime: currentTime)
+                var nextTime = min(currentTime + deltaT, measurement.time)
+                if segment + 1 < self.profile.startTimes.count && self.profile.startTimes[segment + 1] > currentTime {
+                    
+                    nextTime = min(nextTime, self.profile.startTimes[segment + 1])
+                }
+                
+                temps = trialModel.GenericTempsForLoadCycle(design: design, atTime: nextTime, lastTime: currentTime, startingTemps: temps, loadCycle: self.profile.loadCycles[segment], loadSlope: self.profile.loadSlopes[segment], ambientSlope: self.profile.ambientSlopes[segment], withCoreOverExcitation: self.withCoreOverExcitation)
+                currentTime = nextTime
+                
+                let plainTemps = temps.PlainTemps(ratedAverageWdgTempRise: tested.ratedAverageWindingRise)
+                var wdgTemp1 = [plainTemps.averageWindingTemperature, plainTemps.hotSpotWindingTemperature]
+                var oilTemp1 = [plainTemps.averageFluidTemperatureInCoolingDucts, plainTemps.hotSpotFluidTemperature]
+                let oilViscTuple = trialModel.FluidViscosity(atTemps: plainTemps)
+                var oilVisc1 = [oilViscTuple.aveVisc, oilViscTuple.hotspotVisc]
+                
+                if !TestStability(false, trialModel.coolingMode, trialModel.windingTau, deltaT, &maxDeltaT, &wdgTemp1, &wdgTempR, &oilTemp1, &oilTempR, &oilVisc1, &oilViscR) {
+                    
+                    deltaT = maxDeltaT
+                }
+            }
+            
+            // the same order as Residuals()
+            let pairs:[(Double?, DualNumber)] = [(measurement.topOil, temps.topFluidTemperatureInTankAndRads), (measurement.hotspot, temps.hotSpotWindingTemperature), (measurement.bottomOil, temps.bottomFluidTemperature), (measurement.averageWinding, temps.averageWindingTemperature)]
+            
+            for (measured, calculated) in pairs where measured != nil {
+                
+                rows.append(calculated)
+            }
+        }
+        
+        self.evaluationLock.lock()
+        self.evaluations += 1
+        self.evaluationLock.unlock()
+        
+        var J = SmallMatrix(rows: rows.count, cols: values.count)
+        for i in 0..<rows.count {
+            
+            for j in 0..<values.count {
+                
+                if !rows[i].partials[j].isFinite {
+                    
+                    DLog("Could not calculate the Jacobian!")
+                    return nil
+                }
+                
+                J[i, j] = rows[i].partials[j]
+            }
+        }
+        
+        return J
+    }
+    
+    // Run the model with a set of parameter values and return the differences between the calculated and measured temperatures (nil if the model blew up)
+    private func Residuals(_ values:[Double]) -> [Double]? {
+        
+        let trialModel = self.TrialModel(values)
+        let invariants = trialModel.ComputeStepInvariants()
+        
+        var state = self.startState
+        var deltaT = state.deltaT > 0.0 ? state.deltaT : 0.5
+        var maxDeltaT = 0.0
+        if !TestStability(true, trialModel.coolingMode, trialModel.windingTau, deltaT, &maxDeltaT, nil, nil, nil, nil, nil, nil) {
+            
+            deltaT = maxDeltaT
+        }
+        
+        var result:[Double] = []
+        
+        for measurement in self.measurements {
+            
+            if measurement.time > state.time {
+                
+                state = trialModel.PropagateState(state, toTime: measurement.time, profile: self.profile, deltaT: deltaT, withCoreOverExcitation: self.withCoreOverExcitation, invariants: invariants).state
+                deltaT = state.deltaT
+            }
+            
+            let temps = state.temps
+            let pairs:[(Double?, Double)] = [(measurement.topOil, temps.topFluidTemperatureInTankAndRads), (measurement.hotspot, temps.hotSpotWindingTemperature), (measurement.bottomOil, temps.bottomFluidTemperature), (measurement.averageWinding, temps.averageWindingTemperature)]
+            
+            for (measured, calculated) in pairs {
+                
+                if let measured = measured {
+                    
+                    if !calculated.isFinite {
+                        
+                        return nil
+                    }
+                    
+                    result.append(calculated - measured)
+                }
+            }
+        }
+        
+        self.evaluationLock.lock()
+        self.evaluations += 1
+        self.evaluationLock.unlock()
+        
+        return result
+    }
+    
+    // Keep the parameters in a physically reasonable range
+    private func Clamped(_ values:[Double]) -> [Double] {
+        
+        var result = values
+        
+        for (i, parameter) in self.parameters.enumerated() {
+            
+            switch parameter {
+            
+            case .xExponent, .yExponent, .zExponent:
+                result[i] = min(max(result[i], 0.1), 2.0)
+            case .windingTau:
+                result[i] = min(max(result[i], 0.5), 60.0)
+            case .hotspotEddyLossPU:
+                result[i] = min(max(result[i], 0.0), 5.0)
+            default:
+                break
+            }
+        }
+        
+        return result
+    }
+    
+    // Create a model with the trial values of the parameters
+    private func TrialModel(_ values:[Double]) -> OverloadModel {
+        
+        let base = self.model
+        
+        let model = OverloadModel(kvaBaseForTemperatures: base.kvaBaseForTemperatures, kvaBaseForLoss: base.kvaBaseForLoss, kVABaseForOverLoad: base.kVABaseForOverLoad, coolingMode: base.coolingMode, fluidType: base.fluidType, conductorType: base.conductorType, testedTemperatures: base.testedTemperatures, initialTemperatures: nil, testedLosses: base.testedLosses, massOfCore: base.massOfCore, massOfFluid: base.massOfFluid, massOfTank: base.massOfTank, massOfWinding: base.massOfWindings, windingTau: base.windingTau, dataInterval: base.dataInterval)
+        
+        model.xExponent = base.xExponent
+        model.yExponent = base.yExponent
+        model.zExponent = base.zExponent
+        
+        ThermalCalibration.SetParameters(self.parameters, values: values, on: model, from: base)
+        
+        return model
+    }
+    
+    // Set the parameters on 'model'. The core & coil mass is taken from 'base' (see the note at the top of the file).
+    private static func SetParameters(_ parameters:[OverloadModel.SensitivityParameter], values:[Double], on model:OverloadModel, from base:OverloadModel) {
+        
+        let coreAndCoilMass = base.massOfCore + base.massOfWindings
+        
+        for (parameter, value) in zip(parameters, values) {
+            
+            switch parameter {
+            
+            case .xExponent:
+                model.xExponent = value
+            case .yExponent:
+                model.yExponent = value
+            case .zExponent:
+                model.zExponent = value
+            case .hotspotEddyLossPU:
+                model.testedLosses.windingHotspotEddyLossPU = value
+            case .windingTau:
+                let ratedLoss = model.testedLosses.LossesAtLoadAndTemperature(K: model.kVABaseForOverLoad / model.kvaBaseForLoss, newTemp: model.testedTemperatures.ratedAverageWindingTemperature)
+                let mcpW = MCp_W(ratedLoss.windingResistiveLoss, ratedLoss.windingEddyLoss, value, model.testedTemperatures.averageFluidTemperatureInCoolingDucts, model.testedTemperatures.averageWindingTemperature)
+                model.windingTau = value
+                model.massOfWindings = MW(mcpW, AppController.StdConductors[Int(model.conductorType.rawValue)].Cp)
+                model.massOfCore = MCORE(coreAndCoilMass, model.massOfWindings)
+            default:
+                break
+            }
+        }
+    }
+    
+    private func SumOfSquares(_ values:[Double]) -> Double {
+        
+        return values.reduce(0.0, { $0 + $1 * $1 })
+    }
+}
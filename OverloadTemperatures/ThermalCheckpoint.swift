@@ -0,0 +1,212 @@
+//
+//  ThermalCheckpoint.swift
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-09.
+//
+
+// Compact, versioned binary snapshots of the ThermalState of a whole fleet of transformers. The idea is that a monitoring service can periodically write a checkpoint and, on restart, map it back into memory and restore every unit without replaying any history.
+
+// File layout (all values little-endian, every field 8-byte aligned so that the mapped file can be read in place):
+//
+// Header (64 bytes):
+//   0: magic number (UInt64)
+//   8: format version (UInt32)
+//  12: record size in bytes (UInt32)
+//  16: number of records (UInt64)
+//  24: checksum of the record area (UInt64)
+//  32: reserved (zeros)
+//
+// Record (96 bytes):
+//   0: unit identifier (UInt64)
+//   8: time, deltaT, agingSum, ambient, rated average winding rise, hotspot location PU, average winding, hotspot, top oil in ducts, top oil in tank & rads, bottom oil (11 x Double)
+
+import Foundation
+
+struct ThermalCheckpoint {
+    
+    // "C5791CKP" in ASCII
+    static let magic:UInt64 = 0x504B433139373543
+    
+    // If the record layout is ever changed, this must be incremented (and Read() must be taught how to handle the older versions)
+    static let version:UInt32 = 1
+    
+    static let headerSize = 64
+    static let recordSize = 96
+    
+    struct Entry {
+        
+        let unitID:UInt64
+        let state:ThermalState
+    }
+    
+    /// Write the states of a set of units to a checkpoint file. The file is first written to a temporary location and then moved into place, so a crash during the write will never leave a partial checkpoint behind.
+    /// - Parameter entries: The unit identifiers and their states
+    /// - Parameter url: The file to write
+    /// - Returns: true if the checkpoint was written, otherwise false
+    static func Write(entries:[Entry], to url:URL) -> Bool {
+        
+        var data = Data(count: headerSize + entries.count * recordSize)
+        
+        data.withUnsafeMutableBytes { buffer in
+            
+            for (index, entry) in entries.enumerated() {
+                
+                let offset = headerSize + index * recordSize
+                let temps = entry.state.temps
+                let fields:[Double] = [entry.state.time, entry.state.deltaT, entry.state.agingSum, temps.ambientTemperature, temps.ratedAverageWindingRise, temps.hotSpotLocationPU, temps.averageWindingTemperature, temps.hotSpotWindingTemperature, temps.topFluidTemperatureInCoolingDucts, temps.topFluidTemperatureInTankAndRads, temps.bottomFluidTemperature]
+                
+                buffer.storeBytes(of: entry.unitID.littleEndian, toByteOffset: offset, as: UInt64.self)
+                for (fieldIndex, nextField) in fields.enumerated() {
+                    
+                    buffer.storeBytes(of: nextField.bitPattern.littleEndian, toByteOffset: offset + 8 * (fieldIndex + 1), as: UInt64.self)
+                }
+            }
+            
+            buffer.storeBytes(of: magic.littleEndian, toByteOffset: 0, as: UInt64.self)
+            buffer.storeBytes(of: version.littleEndian, toByteOffset: 8, as: UInt32.self)
+            buffer.storeBytes(of: UInt32(recordSize).littleEndian, toByteOffset: 12, as: UInt32.self)
+            buffer.storeBytes(of: UInt64(entries.count).littleEndian, toByteOffset: 16, as: UInt64.self)
+            buffer.storeBytes(of: Checksum(UnsafeRawBufferPointer(buffer), count: entries.count).littleEndian, toByteOffset: 24, as: UInt64.self)
+        }
+        
+        do {
+            
+            try data.write(to: url, options: .atomic)
+        }
+        catch {
+            
+            DLog("Could not write checkpoint: \(error)")
+            return false
+        }
+        
+        return true
+    }
+    
+    /// Read a checkpoint file. The file is memory-mapped and decoded in place.
+    /// - Parameter url: The checkpoint file
+    /// - Returns: The entries in the file (in the order they were written), or nil if the file could not be read or is not a valid checkpoint
+    static func Read(from url:URL) -> [Entry]? {
+        
+        guard let data = try? Data(contentsOf: url, options: .alwaysMapped) else {
+            
+            DLog("Could not map checkpoint file!")
+            return nil
+        }
+        
+        if data.count < headerSize {
+            
+            DLog("Checkpoint file is too short!")
+            return nil
+        }
+        
+        return data.withUnsafeBytes { (buffer:UnsafeRawBufferPointer) -> [Entry]? in
+            
+            if UInt64(littleEndian: buffer.load(fromByteOffset: 0, as: UInt64.self)) != magic {
+                
+                DLog("Not a checkpoint file!")
+                return nil
+            }
+            
+            let fileVersion = UInt32(littleEndian: buffer.load(fromByteOffset: 8, as: UInt32.self))
+            let fileRecordSize = UInt32(littleEndian: buffer.load(fromByteOffset: 12, as: UInt32.self))
+            if fileVersion != version || Int(fileRecordSize) != recordSize {
+                
+                DLog("Unsupported checkpoint version (\(fileVersion))!")
+                return nil
+            }
+            
+            // the count is checked against the size of the file before it is used, so a damaged header can't overflow the record arithmetic
+            let fileCount = UInt64(littleEndian: buffer.load(fromByteOffset: 16, as: UInt64.self))
+            if fileCount != UInt64((buffer.count - headerSize) / recordSize) || (buffer.count - headerSize) % recordSize != 0 {
+                
+                DLog("Checkpoint file is truncated!")
+                return nil
+            }
+            
+            let count = Int(fileCount)
+            
+            if UInt64(littleEndian: buffer.load(fromByteOffset: 24, as: UInt64.self)) != Checksum(buffer, count: count) {
+                
+                DLog("Checkpoint file is corrupt!")
+                return nil
+            }
+            
+            var result:[Entry] = []
+            result.reserveCapacity(count)
+            
+            for index in 0..<count {
+                
+                let offset = headerSize + index * recordSize
+                let unitID = UInt64(littleEndian: buffer.load(fromByteOffset: offset, as: UInt64.self))
+                
+                func field(_ fieldIndex:Int) -> Double {
+                    
+                    return Double(bitPattern: UInt64(littleEndian: buffer.load(fromByteOffset: offset + 8 * (fieldIndex + 1), as: UInt64.self)))
+                }
+                
+                let temps = Temperatures(ambientTemperature: field(3), ratedAverageWdgTempRise: field(4), averageWdgTemp: field(6), hotspotWdgTemp: field(7), hotSpotLocationPU: field(5), topOilTempInDucts: field(8), topOilTempInTankAndRads: field(9), bottomOilTemp: field(10))
+                
+                result.append(Entry(unitID: unitID, state: ThermalState(time: field(0), temps: temps, deltaT: field(1), agingSum: field(2))))
+            }
+            
+            return result
+        }
+    }
+    
+    /// Convenience routine to restore a fleet of models from a checkpoint file. Units in the file that do not have a model (and vice-versa) are ignored.
+    /// - Parameter models: The models, keyed by unit identifier
+    /// - Parameter url: The checkpoint file
+    /// - Returns: The number of models that were restored (or nil if the file could not be read)
+    static func RestoreModels(_ models:[UInt64:OverloadModel], from url:URL) -> Int? {
+        
+        guard let entries = Read(from: url) else {
+            
+            return nil
+        }
+        
+        var restoredCount = 0
+        for nextEntry in entries {
+            
+            if let model = models[nextEntry.unitID] {
+                
+                model.RestoreState(nextEntry.state)
+                restoredCount += 1
+            }
+        }
+        
+        return restoredCount
+    }
+    
+    /// Convenience routine to checkpoint a fleet of models. Models that have not been run yet (ie: they have no currentState) are skipped.
+    /// - Parameter models: The models, keyed by unit identifier
+    /// - Parameter url: The checkpoint file
+    /// - Returns: true if the checkpoint was written, otherwise false
+    static func CheckpointModels(_ models:[UInt64:OverloadModel], to url:URL) -> Bool {
+        
+        var entries:[Entry] = []
+        for (unitID, model) in models.sorted(by: { $0.key < $1.key }) {
+            
+            if let state = model.currentState {
+                
+                entries.append(Entry(unitID: unitID, state: state))
+            }
+        }
+        
+        return Write(entries: entries, to: url)
+    }
+    
+    // FNV-1a over the 64-bit words of the record area (fast enough that it doesn't show up next to the cost of mapping the file)
+    private static func Checksum(_ buffer:UnsafeRawBufferPointer, count:Int) -> UInt64 {
+        
+        var hash:UInt64 = 0xcbf29ce484222325
+        let wordCount = count * recordSize / 8
+        
+        for index in 0..<wordCount {
+            
+            hash = (hash ^ UInt64(littleEndian: buffer.load(fromByteOffset: headerSize + 8 * index, as: UInt64.self))) &* 0x100000001b3
+        }
+        
+        return hash
+    }
+}
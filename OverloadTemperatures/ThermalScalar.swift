@@ -0,0 +1,48 @@
+//
+//  ThermalScalar.swift
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-18.
+//
+
+// The scalar type used by the generic versions of the Annex G equations (see AnnexG). Double is the "plain" scalar. DualNumber carries first derivatives along with the value, which is what the forward-mode sensitivity routines use.
+
+import Foundation
+
+protocol ThermalScalar: Comparable, ExpressibleByFloatLiteral {
+    
+    init(_ value:Double)
+    
+    // the plain value (comparisons and branches in the equations are always decided on this)
+    var value:Double { get }
+    
+    static func + (lhs:Self, rhs:Self) -> Self
+    static func - (lhs:Self, rhs:Self) -> Self
+    static func * (lhs:Self, rhs:Self) -> Self
+    static func / (lhs:Self, rhs:Self) -> Self
+    static prefix func - (operand:Self) -> Self
+    
+    static func Pow(_ base:Self, _ exponent:Self) -> Self
+    static func Exp(_ x:Self) -> Self
+}
+
+extension Double: ThermalScalar {
+    
+    var value:Double {
+        
+        get {
+            
+            return self
+        }
+    }
+    
+    static func Pow(_ base:Double, _ exponent:Double) -> Double {
+        
+        return pow(base, exponent)
+    }
+    
+    static func Exp(_ x:Double) -> Double {
+        
+        return exp(x)
+    }
+}
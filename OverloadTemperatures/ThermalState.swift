@@ -0,0 +1,41 @@
+//
+//  ThermalState.swift
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-09.
+//
+
+import Foundation
+
+// Everything that is needed to pick up an overload simulation exactly where it left off (without replaying the history that led up to it)
+struct ThermalState {
+    
+    // Time in minutes since the start of the history that produced this state
+    var time:Double
+    
+    // The Annex G state (average winding, hotspot, top duct oil, top oil in tank & rads and bottom oil temperatures, plus the ambient at 'time')
+    var temps:Temperatures
+    
+    // The time step (Δt) that was in use when the state was captured, in minutes. A value of 0 means "let the model choose".
+    var deltaT:Double
+    
+    // Accumulated insulation aging, ie: the sum of (aging acceleration factor x Δt), in minutes
+    var agingSum:Double
+    
+    // The equivalent aging factor over the full history
+    var equivalentAgingFactor:Double {
+        
+        get {
+            
+            return self.time > 0.0 ? self.agingSum / self.time : 0.0
+        }
+    }
+    
+    init(time:Double = 0.0, temps:Temperatures, deltaT:Double = 0.0, agingSum:Double = 0.0) {
+        
+        self.time = time
+        self.temps = temps
+        self.deltaT = deltaT
+        self.agingSum = agingSum
+    }
+}
@@ -0,0 +1,327 @@
+//
+//  ThermalStateEstimator.swift
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-02-01.
+//
+
+// An extended Kalman filter over the five Annex G temperatures (see Temperatures.annexGState) that corrects a running prediction with measured top-oil (and, if the transformer has them, fibre-optic hot-spot) temperatures as they arrive. The model alone drifts away from the real transformer (the ambient at the site, the cooling, the actual losses), while the sensors alone do not show the hot-spot of a transformer that only has a top-oil gauge; the filter keeps a best estimate of the whole state and of its uncertainty, so that an alarm can be raised on the hot-spot with a known confidence.
+//
+// Predict() advances the state with the full Annex G step (OverloadModel.StepTemps) and the covariance with the Jacobian F of the step, from the same DualNumber pass that LinearizedModel uses (OverloadModel.StepJacobian()):
+//
+// x ← f(x, u), P ← F P Fᵀ + Q·Δt
+//
+// F changes with the state (the losses and the viscosities depend on the temperatures), so it is found again every jacobianInterval minutes of a prediction, at the state reached by then.
+//
+// Update() assimilates one reading z of a single state x[i] (with variance R) at a time:
+//
+// S = P[i,i] + R, K = P[:,i] / S, x ← x + K (z - x[i]), P ← (I - K hᵀ) P (I - K hᵀ)ᵀ + K R Kᵀ
+//
+// where h selects x[i]. Since every reading is a scalar, S does not need to be inverted, and the cost of a reading is a fixed number of 5x5 operations, no matter how long the estimator has been running (there is no history to replay). The "Joseph" form of the covariance update keeps P symmetric and positive.
+//
+// NOTE: The model is not modified. The corrected state can be handed to OverloadModel.RestoreState() to start a forecast from it.
+
+import Foundation
+
+class ThermalStateEstimator {
+    
+    // The outcome of one reading
+    struct Innovation {
+        
+        // the index of the measured state in Temperatures.annexGState
+        let stateIndex:Int
+        
+        // the reading minus the predicted temperature, °C
+        let residual:Double
+        
+        // the variance of the residual (predicted plus sensor), °C²
+        let variance:Double
+        
+        // false if the reading was rejected as an outlier
+        let accepted:Bool
+        
+        // the residual in standard deviations
+        var normalized:Double {
+            
+            get {
+                
+                return self.residual / sqrt(self.variance)
+            }
+        }
+    }
+    
+    // the indices of the measured states in Temperatures.annexGState
+    static let hotspotIndex = 1
+    static let topOilIndex = 3
+    
+    // the model that is used for the predictions (it is not modified)
+    let model:OverloadModel
+    
+    // the fixed step length, minutes (it should satisfy the G.27 stability criteria for the expected loads)
+    let deltaT:Double
+    
+    let withCoreOverExcitation:Bool
+    
+    // the corrected state (time in minutes since the estimator was created, and the aging since then)
+    private(set) var state:ThermalState
+    
+    // the covariance of the error of the Annex G temperatures, °C²
+    private(set) var covariance:SmallMatrix
+    
+    // the growth of the variance of each Annex G temperature from the model's own error, °C² per minute
+    var processNoise:[Double]
+    
+    // the variances of the sensors, °C²
+    var topOilVariance:Double
+    var hotspotVariance:Double
+    
+    // readings whose residual is more than this many standard deviations are rejected (0 to accept every reading)
+    var outlierGate = 5.0
+    
+    // the Jacobian of the step is found again after this many minutes of a prediction (0 to find it on every step)
+    var jacobianInterval = 5.0
+    
+    // the result of the last call to Update(), if any
+    private(set) var lastInnovations:[Innovation] = []
+    
+    var temps:Temperatures {
+        
+        get {
+            
+            return self.state.temps
+        }
+    }
+    
+    var hotspot:Double {
+        
+        get {
+            
+            return self.state.temps.hotSpotWindingTemperature
+        }
+    }
+    
+    var hotspotStandardDeviation:Double {
+        
+        get {
+            
+            return sqrt(max(0.0, self.covariance[ThermalStateEstimator.hotspotIndex, ThermalStateEstimator.hotspotIndex]))
+        }
+    }
+    
+    var topOil:Double {
+        
+        get {
+            
+            return self.state.temps.topFluidTemperatureInTankAndRads
+        }
+    }
+    
+    var topOilStandardDeviation:Double {
+        
+        get {
+            
+            return sqrt(max(0.0, self.covariance[ThermalStateEstimator.topOilIndex, ThermalStateEstimator.topOilIndex]))
+        }
+    }
+    
+    /// Create a ThermalStateEstimator
+    /// - Parameter model: The model to use for the predictions
+    /// - Parameter initialTemps: The best guess of the temperatures at the start (usually the steady-state temperatures at the present load)
+    /// - Parameter initialUncertainty: The standard deviation of the error of every initial temperature, °C
+    /// - Parameter deltaT: The step length, minutes
+    /// - Parameter processNoise: The growth of the variance of each Annex G temperature, °C² per minute (in the order of Temperatures.annexGState)
+    /// - Parameter topOilSensorError: The standard deviation of the top-oil sensor, °C
+    /// - Parameter hotspotSensorError: The standard deviation of the hot-spot sensor, °C
+    /// - Parameter withCoreOverExcitation: If true, use the core losses with core overexcitation, otherwise normal core losses
+    /// - Returns: The estimator, or nil if any of the parameters is invalid
+    init?(model:OverloadModel, initialTemps:Temperatures, initialUncertainty:Double = 5.0, deltaT:Double = 0.5, processNoise:[Double] = [0.004, 0.006, 0.002, 0.002, 0.002], topOilSensorError:Double = 0.5, hotspotSensorError:Double = 1.0, withCoreOverExcitation:Bool = false) {
+        
+        let n = Temperatures.annexGStateCount
+        
+        if !(deltaT > 0.0) || !(initialUncertainty >= 0.0) || !(topOilSensorError > 0.0) || !(hotspotSensorError > 0.0) {
+            
+            DLog("Invalid step length or uncertainties!")
+            return nil
+        }
+        
+        if processNoise.count != n || processNoise.contains(where: { !($0 >= 0.0) }) {
+            
+            DLog("The process noise must have \(n) non-negative entries!")
+            return nil
+        }
+        
+        self.model = model
+        self.deltaT = deltaT
+        self.withCoreOverExcitation = withCoreOverExcitation
+        self.state = ThermalState(time: 0.0, temps: initialTemps, deltaT: deltaT, agingSum: 0.0)
+        self.covariance = (initialUncertainty * initialUncertainty) * SmallMatrix.Identity(n)
+        self.processNoise = processNoise
+        self.topOilVariance = topOilSensorError * topOilSensorError
+        self.hotspotVariance = hotspotSensorError * hotspotSensorError
+    }
+    
+    /// Advance the estimate with a constant load and ambient (usually up to the time of the next reading)
+    /// - Parameter puLoad: The load (on the kVABaseForOverLoad base), per unit
+    /// - Parameter ambient: The ambient temperature, °C
+    /// - Parameter duration: The time to advance, minutes
+    /// - Returns: false if the duration is invalid or the model broke down (the estimate is not changed)
+    @discardableResult
+    func Predict(puLoad:Double, ambient:Double, duration:Double) -> Bool {
+        
+        if !(duration >= 0.0) || !duration.isFinite {
+            
+            DLog("Invalid duration!")
+            return false
+        }
+        
+        if duration == 0.0 {
+            
+            return true
+        }
+        
+        let n = Temperatures.annexGStateCount
+        
+        var temps = self.state.temps
+        var time = 0.0
+        var agingSum = self.state.agingSum
+        var P = self.covariance
+        
+        var F = SmallMatrix.Identity(n)
+        var jacobianTime = -Double.infinity
+        
+        while time < duration {
+            
+            let stepDeltaT = min(self.deltaT, duration - time)
+            
+            // the Jacobian at the start of the step, if it is due (a short last step gets its own)
+            if stepDeltaT < self.deltaT {
+                
+                F = self.StateJacobian(temps, puLoad: puLoad, ambient: ambient, deltaT: stepDeltaT)
+            }
+            else if !(time - jacobianTime < self.jacobianInterval) {
+                
+                F = self.StateJacobian(temps, puLoad: puLoad, ambient: ambient, deltaT: self.deltaT)
+                jacobianTime = time
+            }
+            
+            let newTemps = self.model.StepTemps(from: temps, puLoad: puLoad, ambient: ambient, deltaT: stepDeltaT, withCoreOverExcitation: self.withCoreOverExcitation)
+            
+            if newTemps.annexGState.contains(where: { !$0.isFinite }) {
+                
+                DLog("The model broke down!")
+                return false
+            }
+            
+            P = F * P * F.transpose
+            
+            for i in 0..<n {
+                
+                P[i, i] += self.processNoise[i] * stepDeltaT
+            }
+            
+            let agingExponent = (15000.0 / 383.0) - (15000.0 / (newTemps.hotSpotWindingTemperature + 273.0))
+            agingSum += exp(agingExponent) * stepDeltaT
+            
+            temps = newTemps
+            time += stepDeltaT
+        }
+        
+        self.state = ThermalState(time: self.state.time + duration, temps: temps, deltaT: self.deltaT, agingSum: agingSum)
+        self.covariance = P
+        
+        return true
+    }
+    
+    /// Correct the estimate with the readings taken at the present time (call Predict() up to the time of the readings first)
+    /// - Parameter topOil: The measured top-oil temperature, °C (nil if there is no reading)
+    /// - Parameter hotspot: The measured hot-spot temperature, °C (nil if there is no reading)
+    /// - Returns: false if any reading was rejected (see lastInnovations)
+    @discardableResult
+    func Update(topOil:Double? = nil, hotspot:Double? = nil) -> Bool {
+        
+        self.lastInnovations = []
+        
+        var allAccepted = true
+        
+        if let topOil = topOil {
+            
+            allAccepted = self.Assimilate(topOil, stateIndex: ThermalStateEstimator.topOilIndex, variance: self.topOilVariance) && allAccepted
+        }
+        
+        if let hotspot = hotspot {
+            
+            allAccepted = self.Assimilate(hotspot, stateIndex: ThermalStateEstimator.hotspotIndex, variance: self.hotspotVariance) && allAccepted
+        }
+        
+        return allAccepted
+    }
+    
+    /// Check the hot-spot against an alarm limit, allowing for the uncertainty of the estimate
+    /// - Parameter limit: The alarm limit, °C
+    /// - Parameter sigmas: The number of standard deviations to add to the estimate (2.0 is about 98% one-sided confidence that the hot-spot is below the limit when there is no alarm)
+    /// - Returns: true if the estimated hot-spot plus 'sigmas' standard deviations is over the limit
+    func HotspotAlarm(limit:Double, sigmas:Double = 2.0) -> Bool {
+        
+        return self.hotspot + sigmas * self.hotspotStandardDeviation > limit
+    }
+    
+    // Assimilate one reading of a single state
+    private func Assimilate(_ reading:Double, stateIndex:Int, variance:Double) -> Bool {
+        
+        let n = Temperatures.annexGStateCount
+        var x = self.state.temps.annexGState
+        let P = self.covariance
+        
+        let residual = reading - x[stateIndex]
+        let S = P[stateIndex, stateIndex] + variance
+        
+        if !reading.isFinite || !(S > 0.0) {
+            
+            DLog("Invalid reading!")
+            self.lastInnovations.append(Innovation(stateIndex: stateIndex, residual: residual, variance: S, accepted: false))
+            return false
+        }
+        
+        if self.outlierGate > 0.0 && residual * residual > self.outlierGate * self.outlierGate * S {
+            
+            DLog("Reading rejected (\(residual / sqrt(S)) standard deviations)")
+            self.lastInnovations.append(Innovation(stateIndex: stateIndex, residual: residual, variance: S, accepted: false))
+            return false
+        }
+        
+        // K = P hᵀ / S, which is column 'stateIndex' of P
+        var K = SmallMatrix(rows: n, cols: 1)
+        for i in 0..<n {
+            
+            K[i, 0] = P[i, stateIndex] / S
+            x[i] += K[i, 0] * residual
+        }
+        
+        var IKH = SmallMatrix.Identity(n)
+        for i in 0..<n {
+            
+            IKH[i, stateIndex] -= K[i, 0]
+        }
+        
+        self.covariance = IKH * P * IKH.transpose + variance * (K * K.transpose)
+        self.state.temps.annexGState = x
+        self.lastInnovations.append(Innovation(stateIndex: stateIndex, residual: residual, variance: S, accepted: true))
+        
+        return true
+    }
+    
+    // The Jacobian of one step with respect to the Annex G temperatures (see OverloadModel.StepJacobian())
+    private func StateJacobian(_ temps:Temperatures, puLoad:Double, ambient:Double, deltaT:Double) -> SmallMatrix {
+        
+        let F = self.model.StepJacobian(at: temps, puLoad: puLoad, ambient: ambient, deltaT: deltaT, withCoreOverExcitation: self.withCoreOverExcitation).A
+        
+        // a step that broke down contributes nothing to the propagation of the covariance
+        if F.values.contains(where: { !$0.isFinite }) {
+            
+            DLog("Could not find the Jacobian of the step!")
+            return SmallMatrix.Identity(Temperatures.annexGStateCount)
+        }
+        
+        return F
+    }
+}
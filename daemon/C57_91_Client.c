@@ -0,0 +1,377 @@
+//
+//  C57_91_Client.c
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-28.
+//
+
+// c57_91_client: a test client for c57_91d. It defines a test design, then sends run (and optionally allowable-load) requests from several connections at once, checks every run reply against a local run of the same engine (unless -x is given, which leaves the CPU to the daemon when measuring latency on a small machine), and reports the latency percentiles. The exit status is non-zero if any request fails, any reply does not match, or the p99 latency is not under the limit (-l, in µs, 1000 by default; 0 means no limit, for a check of the replies only, since the local runs compete with the daemon for the CPU).
+
+// usage: c57_91_client [-s socket] [-c connections] [-n requests] [-h hours] [-u uniqueProfiles] [-a allowableEvery] [-l p99Limit] [-x]
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "C57_91_Protocol.h"
+
+#define TEST_DESIGN_ID 1
+#define MAX_CONNECTIONS 256
+
+// the step for the test profiles, min
+#define TEST_DELTA_T 0.5
+
+static const char *SocketPath = C57_91D_DEFAULT_SOCKET;
+static int RequestCount = 2000;
+static double ProfileHours = 8.0;
+static int UniqueProfiles = 64;
+static int AllowableEvery = 0;
+static bool CheckReplies = true;
+static double LatencyLimit = 1000.0; // µs
+static C57_91_Design TestDesign;
+
+typedef struct {
+    
+    int index;
+    double *latencies; // µs
+    int completed;
+    int failures;
+    double maxDeviation;
+    
+} ClientThread;
+
+// The design of the C57.91 Annex G example (two windings lumped together)
+static void TestDesignFields(double *fields) {
+    
+    const double values[C57_91D_DESIGN_FIELDS] = {ONAN, MINERAL_OIL, CU, 0.5, 0.8, 0.5, 1.0, 5.0, 85.0, 12360.0 + 15169.0, 470.0 + 303.0, 0.061, 1205.0, 4809.0, 4809.0, 20.0, 78.6, 90.6, 76.1, 76.1, 53.7, 1.0, 65.0, 3630.0 * 2.91, 7000.0 * 2.2 * 3.51 + 11627.0 * 3.51 + 5321.0 * 2.2 * 13.92};
+    
+    memcpy(fields, values, sizeof(values));
+}
+
+static double Now(void) {
+    
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    
+    return (double)now.tv_sec * 1.0e6 + (double)now.tv_nsec / 1.0e3;
+}
+
+static int Connect(void) {
+    
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, SocketPath, sizeof(address.sun_path) - 1);
+    
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        
+        fprintf(stderr, "c57_91_client: could not connect to %s: %s\n", SocketPath, strerror(errno));
+        if (fd >= 0) {
+            
+            close(fd);
+        }
+        
+        return -1;
+    }
+    
+    return fd;
+}
+
+static bool WriteAll(int fd, const void *buffer, size_t length) {
+    
+    const uint8_t *bytes = buffer;
+    while (length > 0) {
+        
+        const ssize_t count = write(fd, bytes, length);
+        if (count < 0 && errno == EINTR) {
+            
+            continue;
+        }
+        
+        if (count <= 0) {
+            
+            return false;
+        }
+        
+        bytes += count;
+        length -= (size_t)count;
+    }
+    
+    return true;
+}
+
+static bool ReadAll(int fd, void *buffer, size_t length) {
+    
+    uint8_t *bytes = buffer;
+    while (length > 0) {
+        
+        const ssize_t count = read(fd, bytes, length);
+        if (count < 0 && errno == EINTR) {
+            
+            continue;
+        }
+        
+        if (count <= 0) {
+            
+            return false;
+        }
+        
+        bytes += count;
+        length -= (size_t)count;
+    }
+    
+    return true;
+}
+
+/// Send a request and wait for its reply
+/// - Returns: the status of the reply, or -1 if the connection failed
+static int Transact(int fd, uint16_t type, uint32_t requestId, const void *payload, uint32_t length, void *reply, uint32_t replyCapacity) {
+    
+    uint8_t message[sizeof(C57_91D_Header) + C57_91D_MAX_PAYLOAD];
+    const C57_91D_Header header = {C57_91D_MAGIC, type, 0, requestId, length};
+    
+    memcpy(message, &header, sizeof(header));
+    memcpy(message + sizeof(header), payload, length);
+    if (!WriteAll(fd, message, sizeof(header) + length)) {
+        
+        return -1;
+    }
+    
+    C57_91D_Header replyHeader;
+    if (!ReadAll(fd, &replyHeader, sizeof(replyHeader)) || replyHeader.magic != C57_91D_MAGIC || replyHeader.requestId != requestId || replyHeader.length > replyCapacity) {
+        
+        return -1;
+    }
+    
+    if (!ReadAll(fd, reply, replyHeader.length)) {
+        
+        return -1;
+    }
+    
+    return replyHeader.status;
+}
+
+// A test profile: hourly points with random loads and ambients (the same seed always gives the same profile)
+static int TestProfile(unsigned int seed, C57_91_ProfilePoint *points) {
+    
+    const int count = (int)ProfileHours + 1;
+    for (int i = 0; i < count; i++) {
+        
+        seed = seed * 1103515245u + 12345u;
+        const double K = 0.6 + 0.7 * (double)((seed >> 8) & 0xFFFF) / 65535.0;
+        seed = seed * 1103515245u + 12345u;
+        const double ambient = 20.0 + 10.0 * (double)((seed >> 8) & 0xFFFF) / 65535.0;
+        
+        points[i].time = 60.0 * i;
+        points[i].K = K;
+        points[i].theta_A = ambient;
+    }
+    
+    return count;
+}
+
+static void *RunClient(void *argument) {
+    
+    ClientThread *thread = argument;
+    
+    const int fd = Connect();
+    if (fd < 0) {
+        
+        thread->failures = RequestCount;
+        return NULL;
+    }
+    
+    uint8_t payload[C57_91D_MAX_PAYLOAD];
+    C57_91_ProfilePoint points[C57_91D_MAX_POINTS];
+    const C57_91_State tested = C57_91_TestedState(&TestDesign);
+    
+    for (int i = 0; i < RequestCount; i++) {
+        
+        const uint32_t requestId = (uint32_t)(thread->index * RequestCount + i);
+        
+        if (AllowableEvery > 0 && i % AllowableEvery == AllowableEvery - 1) {
+            
+            C57_91D_AllowableLoadRequest request = {TEST_DESIGN_ID, 0, 0.8 + 0.01 * (i % 4), 30.0, 240.0, 140.0, 110.0, TEST_DELTA_T};
+            C57_91D_AllowableLoadReply reply;
+            
+            const double start = Now();
+            const int status = Transact(fd, C57_91D_ALLOWABLE_LOAD, requestId, &request, sizeof(request), &reply, sizeof(reply));
+            thread->latencies[thread->completed++] = Now() - start;
+            
+            if (status != C57_91D_OK || !(reply.K > 0.0) || reply.maxHotspot > request.hotspotLimit + 1.0e-9) {
+                
+                thread->failures += 1;
+            }
+            
+            continue;
+        }
+        
+        const unsigned int seed = (unsigned int)(UniqueProfiles > 0 ? (i * 7919 + thread->index) % UniqueProfiles : thread->index * RequestCount + i);
+        const int count = TestProfile(seed, points);
+        
+        C57_91D_RunRequest request;
+        memset(&request, 0, sizeof(request));
+        request.designId = TEST_DESIGN_ID;
+        request.count = (uint32_t)count;
+        request.deltaT = TEST_DELTA_T;
+        
+        memcpy(payload, &request, sizeof(request));
+        memcpy(payload + sizeof(request), points, (size_t)count * sizeof(C57_91_ProfilePoint));
+        
+        C57_91D_RunReply reply;
+        const double start = Now();
+        const int status = Transact(fd, C57_91D_RUN, requestId, payload, (uint32_t)(sizeof(request) + (size_t)count * sizeof(C57_91_ProfilePoint)), &reply, sizeof(reply));
+        thread->latencies[thread->completed++] = Now() - start;
+        
+        if (status != C57_91D_OK) {
+            
+            thread->failures += 1;
+            
+            if (status < 0) {
+                
+                break;
+            }
+            
+            continue;
+        }
+        
+        if (!CheckReplies) {
+            
+            continue;
+        }
+        
+        // check the reply against a local run
+        C57_91_RunResult local;
+        C57_91_Run(&TestDesign, &tested, points, count, TEST_DELTA_T, false, C57_91_DOUBLE, NULL, 0.0, 0, &local);
+        
+        const double deviation = fmax(fmax(fabs(local.maxHotspot - reply.maxHotspot), fabs(local.maxTopOil - reply.maxTopOil)), fmax(fabs(local.maxAverageWinding - reply.maxAverageWinding), fabs(local.agingFactor - reply.agingFactor)));
+        thread->maxDeviation = fmax(thread->maxDeviation, deviation);
+    }
+    
+    close(fd);
+    
+    return NULL;
+}
+
+static int CompareDoubles(const void *lhs, const void *rhs) {
+    
+    const double a = *(const double *)lhs;
+    const double b = *(const double *)rhs;
+    
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+int main(int argc, char *argv[]) {
+    
+    int connectionCount = 4;
+    
+    int option;
+    while ((option = getopt(argc, argv, "s:c:n:h:u:a:l:x")) != -1) {
+        
+        switch (option) {
+            
+            case 's': SocketPath = optarg; break;
+            case 'c': connectionCount = atoi(optarg); break;
+            case 'n': RequestCount = atoi(optarg); break;
+            case 'h': ProfileHours = atof(optarg); break;
+            case 'u': UniqueProfiles = atoi(optarg); break;
+            case 'a': AllowableEvery = atoi(optarg); break;
+            case 'l': LatencyLimit = atof(optarg); break;
+            case 'x': CheckReplies = false; break;
+            
+            default:
+                fprintf(stderr, "usage: c57_91_client [-s socket] [-c connections] [-n requests] [-h hours] [-u uniqueProfiles] [-a allowableEvery] [-l p99Limit] [-x]\n");
+                return EXIT_FAILURE;
+        }
+    }
+    
+    if (connectionCount < 1 || connectionCount > MAX_CONNECTIONS || RequestCount < 1 || ProfileHours < 1.0 || ProfileHours + 1.0 > C57_91D_MAX_POINTS || !(LatencyLimit >= 0.0)) {
+        
+        fprintf(stderr, "c57_91_client: invalid arguments\n");
+        return EXIT_FAILURE;
+    }
+    
+    // define the test design (and keep a local copy to check the replies)
+    C57_91D_DesignRequest designRequest;
+    memset(&designRequest, 0, sizeof(designRequest));
+    designRequest.designId = TEST_DESIGN_ID;
+    TestDesignFields(designRequest.fields);
+    C57_91_DesignFromFields(designRequest.fields, &TestDesign);
+    
+    const int fd = Connect();
+    if (fd < 0) {
+        
+        return EXIT_FAILURE;
+    }
+    
+    uint8_t nothing[8];
+    if (Transact(fd, C57_91D_PING, 0, NULL, 0, nothing, 0) != C57_91D_OK || Transact(fd, C57_91D_DEFINE_DESIGN, 1, &designRequest, sizeof(designRequest), nothing, 0) != C57_91D_OK) {
+        
+        fprintf(stderr, "c57_91_client: the daemon did not accept the test design\n");
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    
+    close(fd);
+    
+    ClientThread threads[MAX_CONNECTIONS];
+    pthread_t handles[MAX_CONNECTIONS];
+    
+    const double start = Now();
+    for (int i = 0; i < connectionCount; i++) {
+        
+        memset(&threads[i], 0, sizeof(ClientThread));
+        threads[i].index = i;
+        threads[i].latencies = malloc((size_t)RequestCount * sizeof(double));
+        pthread_create(&handles[i], NULL, RunClient, &threads[i]);
+    }
+    
+    for (int i = 0; i < connectionCount; i++) {
+        
+        pthread_join(handles[i], NULL);
+    }
+    const double elapsed = Now() - start;
+    
+    double *latencies = malloc((size_t)connectionCount * (size_t)RequestCount * sizeof(double));
+    size_t latencyCount = 0;
+    int failures = 0;
+    double maxDeviation = 0.0;
+    
+    for (int i = 0; i < connectionCount; i++) {
+        
+        memcpy(latencies + latencyCount, threads[i].latencies, (size_t)threads[i].completed * sizeof(double));
+        latencyCount += (size_t)threads[i].completed;
+        failures += threads[i].failures;
+        maxDeviation = fmax(maxDeviation, threads[i].maxDeviation);
+        free(threads[i].latencies);
+    }
+    
+    qsort(latencies, latencyCount, sizeof(double), CompareDoubles);
+    
+    printf("%zu requests on %d connections in %0.1f ms (%0.0f requests/s)\n", latencyCount, connectionCount, elapsed / 1000.0, latencyCount / (elapsed / 1.0e6));
+    if (latencyCount > 0) {
+        
+        printf("latency (µs): p50 %0.1f, p90 %0.1f, p99 %0.1f, max %0.1f\n", latencies[latencyCount / 2], latencies[latencyCount * 9 / 10], latencies[latencyCount * 99 / 100], latencies[latencyCount - 1]);
+    }
+    printf("failures: %d, maximum deviation from a local run: %0.3g\n", failures, maxDeviation);
+    
+    bool fastEnough = true;
+    if (LatencyLimit > 0.0 && latencyCount > 0) {
+        
+        fastEnough = latencies[latencyCount * 99 / 100] < LatencyLimit;
+        printf("p99 latency limit %0.0f µs: %s\n", LatencyLimit, fastEnough ? "met" : "EXCEEDED");
+    }
+    
+    free(latencies);
+    
+    return failures == 0 && maxDeviation < 1.0e-9 && latencyCount == (size_t)connectionCount * (size_t)RequestCount && fastEnough ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,1119 @@
+//
+//  C57_91_Daemon.c
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-28.
+//
+
+// c57_91d: a local rating service. Designs are kept resident (prepared once, when they are defined), and requests arrive over a Unix domain socket using the binary protocol in C57_91_Protocol.h. Everything is local, so the service works offline.
+
+// One I/O thread polls the listening socket and the connections. Every request that has arrived since the last batch (on any connection) is collected into the next batch, which is sorted by design and spread over a pool of worker threads (the I/O thread works too). The replies are written when the whole batch is done. Batches are never delayed to wait for more requests: while one batch is being run, the requests that arrive queue up in the sockets and become the next batch, so the batches get larger as the load goes up and latency stays low when it is light.
+
+// Run requests go through a C57_91_ResultCache, so repeated questions (the common case for tools that poll) are answered without running the engine. Allowable-load requests remember the preload states and the answers of the last few requests for each design, and find the load with a bracketed secant (Illinois) search, which typically needs a third of the runs of a bisection.
+
+// Latency: the target is a p99 under 1 ms (and 'make check' fails if it is missed) for two request mixes: several connections asking mostly repeated questions (8-hour profiles at a Δt of 0.5 min, with one allowable-load request in 50, for 4 hours from a preload), and uncached 8-hour runs on one connection. An uncached 8-hour run costs about 0.25 ms of CPU, and an allowable-load search four or five runs of its duration (plus a 24-hour run the first time a preload is used), so longer profiles, or more uncached requests at once than there are worker threads, are not covered by the target.
+
+// usage: c57_91d [-s socket] [-d designFile] [-t threads] [-c cacheEntries] [-p cacheFile] [-v]
+//
+// The design file has one design per line: the design id followed by the C57_91D_DESIGN_FIELDS fields (see C57_91D_DesignRequest). Blank lines and lines starting with '#' are ignored.
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "C57_91_Protocol.h"
+#include "C57_91_ResultCache.h"
+
+#define MAX_CONNECTIONS 256
+#define MAX_THREADS 64
+
+// the length of the preload for allowable-load requests, min
+#define PRELOAD_DURATION 1440.0
+
+// the number of preload states and of allowable-load answers that are remembered for each design
+#define PRELOAD_ENTRIES 8
+#define ANSWER_ENTRIES 16
+
+// the search range and tolerances for allowable-load requests: the load (pu) and how close to the limit (°C) is close enough
+#define MAX_ALLOWABLE_LOAD 4.0
+#define ALLOWABLE_LOAD_TOLERANCE 0.001
+#define ALLOWABLE_LIMIT_TOLERANCE 0.005
+
+typedef struct {
+    
+    bool valid;
+    double K;
+    double ambient;
+    double deltaT;
+    bool withOverexcitation;
+    C57_91_Precision precision;
+    C57_91_State state;
+    
+} Preload;
+
+typedef struct {
+    
+    bool valid;
+    C57_91D_AllowableLoadRequest request;
+    C57_91D_Status status;
+    C57_91D_AllowableLoadReply reply;
+    
+} AllowableAnswer;
+
+typedef struct {
+    
+    bool defined;
+    C57_91_Design design;
+    
+    // the preload states and the answers of the last few allowable-load requests
+    pthread_mutex_t memoLock;
+    Preload preloads[PRELOAD_ENTRIES];
+    int nextPreload;
+    AllowableAnswer answers[ANSWER_ENTRIES];
+    int nextAnswer;
+    
+} ResidentDesign;
+
+typedef struct {
+    
+    int fd;
+    bool closing;
+    
+    uint8_t *input;
+    size_t inputLength;
+    size_t inputCapacity;
+    size_t inputConsumed;
+    
+    uint8_t *output;
+    size_t outputLength;
+    size_t outputCapacity;
+    
+} Connection;
+
+typedef struct {
+    
+    int connection;
+    C57_91D_Header header;
+    const uint8_t *payload;
+    
+    C57_91D_Status status;
+    uint32_t replyLength;
+    union {
+        
+        C57_91D_RunReply run;
+        C57_91D_AllowableLoadReply allowable;
+        
+    } reply;
+    
+} Job;
+
+static ResidentDesign Designs[C57_91D_MAX_DESIGNS];
+static Connection Connections[MAX_CONNECTIONS];
+static C57_91_ResultCache *Cache = NULL;
+static volatile sig_atomic_t Quit = 0;
+static bool Verbose = false;
+
+// the worker pool
+static struct {
+    
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    uint64_t generation;
+    int active;
+    int workerCount;
+    
+    Job *jobs;
+    size_t *order;
+    size_t count;
+    _Atomic size_t next;
+    
+} Pool = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0, 0, NULL, NULL, 0, 0};
+
+static struct {
+    
+    uint64_t requests;
+    uint64_t batches;
+    size_t largestBatch;
+    
+} Statistics;
+
+// MARK: - Requests
+
+// The tested state, shifted so that the ambient is 'ambient'
+static C57_91_State StateAtAmbient(const C57_91_Design *design, double ambient) {
+    
+    C57_91_State result = C57_91_TestedState(design);
+    const double shift = ambient - result.theta_A;
+    
+    result.theta_A += shift;
+    result.theta_W += shift;
+    result.theta_H += shift;
+    result.theta_TDO += shift;
+    result.theta_TO += shift;
+    result.theta_BO += shift;
+    
+    return result;
+}
+
+static void DoRun(Job *job) {
+    
+    // the points are copied so that a malformed (misaligned) request can never cause an unaligned access
+    static _Thread_local C57_91_ProfilePoint points[C57_91D_MAX_POINTS];
+    
+    C57_91D_RunRequest request;
+    if (job->header.length < sizeof(request)) {
+        
+        job->status = C57_91D_BAD_REQUEST;
+        return;
+    }
+    
+    memcpy(&request, job->payload, sizeof(request));
+    if (request.count < 1 || request.count > C57_91D_MAX_POINTS || job->header.length != sizeof(request) + request.count * sizeof(C57_91_ProfilePoint) || !(request.deltaT > 0.0)) {
+        
+        job->status = C57_91D_BAD_REQUEST;
+        return;
+    }
+    
+    if (request.designId >= C57_91D_MAX_DESIGNS || !Designs[request.designId].defined) {
+        
+        job->status = C57_91D_UNKNOWN_DESIGN;
+        return;
+    }
+    
+    memcpy(points, job->payload + sizeof(request), request.count * sizeof(C57_91_ProfilePoint));
+    for (uint32_t i = 0; i < request.count; i++) {
+        
+        if ((i == 0 && points[0].time != 0.0) || (i > 0 && !(points[i].time >= points[i - 1].time)) || !isfinite(points[i].K) || !isfinite(points[i].theta_A) || points[i].K < 0.0) {
+            
+            job->status = C57_91D_INVALID_PROFILE;
+            return;
+        }
+    }
+    
+    const C57_91_Design *design = &Designs[request.designId].design;
+    const C57_91_State start = (request.flags & C57_91D_FLAG_START_STATE) != 0 ? request.start : C57_91_TestedState(design);
+    const bool withOverexcitation = (request.flags & C57_91D_FLAG_OVEREXCITATION) != 0;
+    const C57_91_Precision precision = (request.flags & C57_91D_FLAG_SINGLE) != 0 ? C57_91_SINGLE : C57_91_DOUBLE;
+    
+    const C57_91_CacheKey key = C57_91_CacheKeyForRun(design, &start, points, (int)request.count, request.deltaT, withOverexcitation, precision);
+    
+    C57_91_CachedResult result;
+    if (!C57_91_CacheLookup(Cache, key, &result)) {
+        
+        C57_91_RunResult runResult;
+        C57_91_Run(design, &start, points, (int)request.count, request.deltaT, withOverexcitation, precision, NULL, 0.0, 0, &runResult);
+        
+        C57_91_CacheResultFromRun(&runResult, NULL, 0, 0.0, &result);
+        C57_91_CacheInsert(Cache, key, &result);
+    }
+    
+    job->reply.run.maxHotspot = result.maxHotspot;
+    job->reply.run.maxHotspotTime = result.maxHotspotTime;
+    job->reply.run.maxTopOil = result.maxTopOil;
+    job->reply.run.maxTopOilTime = result.maxTopOilTime;
+    job->reply.run.maxAverageWinding = result.maxAverageWinding;
+    job->reply.run.maxAverageWindingTime = result.maxAverageWindingTime;
+    job->reply.run.agingFactor = result.agingFactor;
+    job->replyLength = sizeof(C57_91D_RunReply);
+}
+
+// Run a constant load for 'duration' minutes
+static void RunConstantLoad(const C57_91_Design *design, const C57_91_State *start, double K, double ambient, double duration, double deltaT, bool withOverexcitation, C57_91_Precision precision, C57_91_RunResult *result) {
+    
+    const C57_91_ProfilePoint profile[2] = {{0.0, K, ambient}, {duration, K, ambient}};
+    
+    C57_91_Run(design, start, profile, 2, deltaT, withOverexcitation, precision, NULL, 0.0, 0, result);
+}
+
+// How far a run is over the limits (positive means a limit is exceeded), °C
+static double Excess(const C57_91_RunResult *result, const C57_91D_AllowableLoadRequest *request) {
+    
+    return fmax(result->maxHotspot - request->hotspotLimit, result->maxTopOil - request->topOilLimit);
+}
+
+// The steady state at the preload of a request (from the memo of the design, if possible)
+static C57_91_State PreloadState(ResidentDesign *resident, const C57_91D_AllowableLoadRequest *request, bool withOverexcitation, C57_91_Precision precision) {
+    
+    pthread_mutex_lock(&resident->memoLock);
+    for (int i = 0; i < PRELOAD_ENTRIES; i++) {
+        
+        const Preload *preload = &resident->preloads[i];
+        if (preload->valid && preload->K == request->preloadK && preload->ambient == request->ambient && preload->deltaT == request->deltaT && preload->withOverexcitation == withOverexcitation && preload->precision == precision) {
+            
+            const C57_91_State result = preload->state;
+            pthread_mutex_unlock(&resident->memoLock);
+            return result;
+        }
+    }
+    pthread_mutex_unlock(&resident->memoLock);
+    
+    // the lock is not held while the preload is run, so two threads may both run it, which is harmless
+    const C57_91_State tested = StateAtAmbient(&resident->design, request->ambient);
+    C57_91_RunResult preload;
+    RunConstantLoad(&resident->design, &tested, request->preloadK, request->ambient, PRELOAD_DURATION, request->deltaT, withOverexcitation, precision, &preload);
+    
+    pthread_mutex_lock(&resident->memoLock);
+    const Preload newPreload = {true, request->preloadK, request->ambient, request->deltaT, withOverexcitation, precision, preload.finalState};
+    resident->preloads[resident->nextPreload] = newPreload;
+    resident->nextPreload = (resident->nextPreload + 1) % PRELOAD_ENTRIES;
+    pthread_mutex_unlock(&resident->memoLock);
+    
+    return preload.finalState;
+}
+
+// The answer to an identical allowable-load request, if it is remembered (tools that poll ask the same question over and over)
+static bool RecallAnswer(ResidentDesign *resident, const C57_91D_AllowableLoadRequest *request, Job *job) {
+    
+    bool found = false;
+    
+    pthread_mutex_lock(&resident->memoLock);
+    for (int i = 0; i < ANSWER_ENTRIES && !found; i++) {
+        
+        const AllowableAnswer *answer = &resident->answers[i];
+        if (answer->valid && memcmp(&answer->request, request, sizeof(C57_91D_AllowableLoadRequest)) == 0) {
+            
+            job->status = answer->status;
+            job->reply.allowable = answer->reply;
+            job->replyLength = answer->status == C57_91D_OK ? sizeof(C57_91D_AllowableLoadReply) : 0;
+            found = true;
+        }
+    }
+    pthread_mutex_unlock(&resident->memoLock);
+    
+    return found;
+}
+
+static void RememberAnswer(ResidentDesign *resident, const C57_91D_AllowableLoadRequest *request, const Job *job) {
+    
+    pthread_mutex_lock(&resident->memoLock);
+    AllowableAnswer *answer = &resident->answers[resident->nextAnswer];
+    answer->valid = true;
+    answer->request = *request;
+    answer->status = job->status;
+    answer->reply = job->reply.allowable;
+    resident->nextAnswer = (resident->nextAnswer + 1) % ANSWER_ENTRIES;
+    pthread_mutex_unlock(&resident->memoLock);
+}
+
+static void DoAllowableLoad(Job *job) {
+    
+    C57_91D_AllowableLoadRequest request;
+    if (job->header.length != sizeof(request)) {
+        
+        job->status = C57_91D_BAD_REQUEST;
+        return;
+    }
+    
+    memcpy(&request, job->payload, sizeof(request));
+    if (!(request.duration > 0.0) || !(request.deltaT > 0.0) || !(request.preloadK >= 0.0) || !isfinite(request.ambient) || !isfinite(request.hotspotLimit) || !isfinite(request.topOilLimit)) {
+        
+        job->status = C57_91D_BAD_REQUEST;
+        return;
+    }
+    
+    if (request.designId >= C57_91D_MAX_DESIGNS || !Designs[request.designId].defined) {
+        
+        job->status = C57_91D_UNKNOWN_DESIGN;
+        return;
+    }
+    
+    ResidentDesign *resident = &Designs[request.designId];
+    if (RecallAnswer(resident, &request, job)) {
+        
+        return;
+    }
+    
+    const C57_91_Design *design = &resident->design;
+    const bool withOverexcitation = (request.flags & C57_91D_FLAG_OVEREXCITATION) != 0;
+    const C57_91_Precision precision = (request.flags & C57_91D_FLAG_SINGLE) != 0 ? C57_91_SINGLE : C57_91_DOUBLE;
+    const C57_91_State start = PreloadState(resident, &request, withOverexcitation, precision);
+    
+    // bracket the answer: 'low' is always within the limits and 'high' is always over them. The load goes up from max(preloadK, 1), and the no-load run is only needed if that first load is already over the limits (a lower load can never be hotter).
+    double low = 0.0;
+    double lowExcess = 0.0;
+    bool haveLow = false;
+    C57_91_RunResult best;
+    
+    double high = fmax(request.preloadK, 1.0);
+    double highExcess = 0.0;
+    bool bracketed = false;
+    
+    while (!bracketed) {
+        
+        C57_91_RunResult result;
+        RunConstantLoad(design, &start, high, request.ambient, request.duration, request.deltaT, withOverexcitation, precision, &result);
+        const double excess = Excess(&result, &request);
+        
+        if (excess > 0.0) {
+            
+            highExcess = excess;
+            bracketed = true;
+        }
+        else {
+            
+            low = high;
+            lowExcess = excess;
+            haveLow = true;
+            best = result;
+            
+            if (high >= MAX_ALLOWABLE_LOAD) {
+                
+                break;
+            }
+            
+            high = fmin(high * 1.5, MAX_ALLOWABLE_LOAD);
+        }
+    }
+    
+    if (!haveLow) {
+        
+        RunConstantLoad(design, &start, low, request.ambient, request.duration, request.deltaT, withOverexcitation, precision, &best);
+        lowExcess = Excess(&best, &request);
+        
+        if (lowExcess > 0.0) {
+            
+            job->status = C57_91D_NOT_FOUND;
+            RememberAnswer(resident, &request, job);
+            return;
+        }
+    }
+    
+    // Illinois (regula falsi that halves the weight of an end that is kept twice in a row), with a bisection as a safeguard
+    int keptSide = 0;
+    while (bracketed && high - low > ALLOWABLE_LOAD_TOLERANCE && lowExcess < -ALLOWABLE_LIMIT_TOLERANCE) {
+        
+        double K = (low * highExcess - high * lowExcess) / (highExcess - lowExcess);
+        if (!(K > low && K < high)) {
+            
+            K = (low + high) / 2.0;
+        }
+        
+        C57_91_RunResult result;
+        RunConstantLoad(design, &start, K, request.ambient, request.duration, request.deltaT, withOverexcitation, precision, &result);
+        const double excess = Excess(&result, &request);
+        
+        if (excess > 0.0) {
+            
+            high = K;
+            highExcess = excess;
+            
+            if (keptSide == -1) {
+                
+                lowExcess /= 2.0;
+            }
+            keptSide = -1;
+        }
+        else {
+            
+            low = K;
+            lowExcess = excess;
+            best = result;
+            
+            if (keptSide == 1) {
+                
+                highExcess /= 2.0;
+            }
+            keptSide = 1;
+        }
+    }
+    
+    job->reply.allowable.K = low;
+    job->reply.allowable.maxHotspot = best.maxHotspot;
+    job->reply.allowable.maxTopOil = best.maxTopOil;
+    job->reply.allowable.agingFactor = best.agingFactor;
+    job->replyLength = sizeof(C57_91D_AllowableLoadReply);
+    
+    RememberAnswer(resident, &request, job);
+}
+
+static void DoJob(Job *job) {
+    
+    job->status = C57_91D_OK;
+    job->replyLength = 0;
+    
+    switch (job->header.type) {
+        
+        case C57_91D_RUN:
+            DoRun(job);
+            break;
+        
+        case C57_91D_ALLOWABLE_LOAD:
+            DoAllowableLoad(job);
+            break;
+        
+        default:
+            job->status = C57_91D_BAD_REQUEST;
+            break;
+    }
+}
+
+// MARK: - Worker pool
+
+static void RunJobs(void) {
+    
+    while (true) {
+        
+        const size_t next = atomic_fetch_add_explicit(&Pool.next, 1, memory_order_relaxed);
+        if (next >= Pool.count) {
+            
+            break;
+        }
+        
+        DoJob(&Pool.jobs[Pool.order[next]]);
+    }
+}
+
+static void *Worker(void *argument) {
+    
+    (void)argument;
+    uint64_t seen = 0;
+    
+    while (true) {
+        
+        pthread_mutex_lock(&Pool.lock);
+        while (Pool.generation == seen) {
+            
+            pthread_cond_wait(&Pool.start, &Pool.lock);
+        }
+        seen = Pool.generation;
+        pthread_mutex_unlock(&Pool.lock);
+        
+        RunJobs();
+        
+        pthread_mutex_lock(&Pool.lock);
+        Pool.active -= 1;
+        if (Pool.active == 0) {
+            
+            pthread_cond_signal(&Pool.done);
+        }
+        pthread_mutex_unlock(&Pool.lock);
+    }
+    
+    return NULL;
+}
+
+static const Job *SortJobs;
+
+static int CompareJobs(const void *lhs, const void *rhs) {
+    
+    const size_t a = *(const size_t *)lhs;
+    const size_t b = *(const size_t *)rhs;
+    
+    // the design id is the first field of every request that reaches the pool
+    uint32_t designA = UINT32_MAX, designB = UINT32_MAX;
+    if (SortJobs[a].header.length >= sizeof(uint32_t)) {
+        
+        memcpy(&designA, SortJobs[a].payload, sizeof(uint32_t));
+    }
+    if (SortJobs[b].header.length >= sizeof(uint32_t)) {
+        
+        memcpy(&designB, SortJobs[b].payload, sizeof(uint32_t));
+    }
+    
+    if (designA != designB) {
+        
+        return designA < designB ? -1 : 1;
+    }
+    
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+// Run a batch on the pool (returns when every job is done)
+static void RunBatch(Job *jobs, size_t *order, size_t count) {
+    
+    for (size_t i = 0; i < count; i++) {
+        
+        order[i] = i;
+    }
+    
+    // jobs for the same design run together, so the design stays in the cache of the core
+    SortJobs = jobs;
+    qsort(order, count, sizeof(size_t), CompareJobs);
+    
+    pthread_mutex_lock(&Pool.lock);
+    Pool.jobs = jobs;
+    Pool.order = order;
+    Pool.count = count;
+    atomic_store(&Pool.next, 0);
+    Pool.active = Pool.workerCount;
+    Pool.generation += 1;
+    pthread_cond_broadcast(&Pool.start);
+    pthread_mutex_unlock(&Pool.lock);
+    
+    RunJobs();
+    
+    pthread_mutex_lock(&Pool.lock);
+    while (Pool.active > 0) {
+        
+        pthread_cond_wait(&Pool.done, &Pool.lock);
+    }
+    pthread_mutex_unlock(&Pool.lock);
+}
+
+// MARK: - Connections
+
+static bool Reserve(uint8_t **buffer, size_t *capacity, size_t needed) {
+    
+    if (needed <= *capacity) {
+        
+        return true;
+    }
+    
+    size_t newCapacity = *capacity > 0 ? *capacity : 4096;
+    while (newCapacity < needed) {
+        
+        newCapacity *= 2;
+    }
+    
+    uint8_t *newBuffer = realloc(*buffer, newCapacity);
+    if (newBuffer == NULL) {
+        
+        return false;
+    }
+    
+    *buffer = newBuffer;
+    *capacity = newCapacity;
+    
+    return true;
+}
+
+static void QueueReply(Connection *connection, uint16_t type, uint16_t status, uint32_t requestId, const void *payload, uint32_t length) {
+    
+    if (connection->closing || !Reserve(&connection->output, &connection->outputCapacity, connection->outputLength + sizeof(C57_91D_Header) + length)) {
+        
+        return;
+    }
+    
+    const C57_91D_Header header = {C57_91D_MAGIC, type, status, requestId, length};
+    memcpy(connection->output + connection->outputLength, &header, sizeof(header));
+    memcpy(connection->output + connection->outputLength + sizeof(header), payload, length);
+    connection->outputLength += sizeof(header) + length;
+}
+
+static void CloseConnection(Connection *connection) {
+    
+    close(connection->fd);
+    free(connection->input);
+    free(connection->output);
+    memset(connection, 0, sizeof(Connection));
+    connection->fd = -1;
+}
+
+static void FlushOutput(Connection *connection) {
+    
+    size_t written = 0;
+    while (written < connection->outputLength) {
+        
+        const ssize_t count = write(connection->fd, connection->output + written, connection->outputLength - written);
+        if (count < 0) {
+            
+            if (errno == EINTR) {
+                
+                continue;
+            }
+            
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                
+                connection->closing = true;
+            }
+            
+            break;
+        }
+        
+        written += (size_t)count;
+    }
+    
+    memmove(connection->output, connection->output + written, connection->outputLength - written);
+    connection->outputLength -= written;
+}
+
+// Handle a request that is answered by the I/O thread
+static bool HandleImmediately(Connection *connection, const C57_91D_Header *header, const uint8_t *payload) {
+    
+    if (header->type == C57_91D_PING) {
+        
+        QueueReply(connection, header->type, C57_91D_OK, header->requestId, NULL, 0);
+        return true;
+    }
+    
+    if (header->type == C57_91D_DEFINE_DESIGN) {
+        
+        // designs are only changed by this thread, and only between batches
+        C57_91D_DesignRequest request;
+        C57_91D_Status status = C57_91D_BAD_REQUEST;
+        
+        if (header->length == sizeof(request)) {
+            
+            memcpy(&request, payload, sizeof(request));
+            C57_91_Design design;
+            
+            if (request.designId < C57_91D_MAX_DESIGNS && C57_91_DesignFromFields(request.fields, &design)) {
+                
+                ResidentDesign *resident = &Designs[request.designId];
+                resident->design = design;
+                resident->defined = true;
+                
+                pthread_mutex_lock(&resident->memoLock);
+                memset(resident->preloads, 0, sizeof(resident->preloads));
+                memset(resident->answers, 0, sizeof(resident->answers));
+                pthread_mutex_unlock(&resident->memoLock);
+                status = C57_91D_OK;
+            }
+        }
+        
+        QueueReply(connection, header->type, (uint16_t)status, header->requestId, NULL, 0);
+        return true;
+    }
+    
+    return false;
+}
+
+// Read what is available and add the complete requests to the batch
+static bool ReadRequests(int index, Job **jobs, size_t *count, size_t *capacity) {
+    
+    Connection *connection = &Connections[index];
+    
+    while (true) {
+        
+        if (!Reserve(&connection->input, &connection->inputCapacity, connection->inputLength + 65536)) {
+            
+            connection->closing = true;
+            return false;
+        }
+        
+        const ssize_t received = read(connection->fd, connection->input + connection->inputLength, connection->inputCapacity - connection->inputLength);
+        if (received > 0) {
+            
+            connection->inputLength += (size_t)received;
+            continue;
+        }
+        
+        if (received < 0 && errno == EINTR) {
+            
+            continue;
+        }
+        
+        if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            
+            connection->closing = true;
+        }
+        
+        break;
+    }
+    
+    while (connection->inputLength - connection->inputConsumed >= sizeof(C57_91D_Header)) {
+        
+        C57_91D_Header header;
+        memcpy(&header, connection->input + connection->inputConsumed, sizeof(header));
+        
+        if (header.magic != C57_91D_MAGIC || header.length > C57_91D_MAX_PAYLOAD) {
+            
+            if (Verbose) {
+                
+                fprintf(stderr, "c57_91d: protocol error on connection %d, closing it\n", connection->fd);
+            }
+            
+            connection->closing = true;
+            return false;
+        }
+        
+        if (connection->inputLength - connection->inputConsumed < sizeof(header) + header.length) {
+            
+            break;
+        }
+        
+        const uint8_t *payload = connection->input + connection->inputConsumed + sizeof(header);
+        connection->inputConsumed += sizeof(header) + header.length;
+        Statistics.requests += 1;
+        
+        if (HandleImmediately(connection, &header, payload)) {
+            
+            continue;
+        }
+        
+        if (*count == *capacity) {
+            
+            const size_t newCapacity = *capacity > 0 ? *capacity * 2 : 256;
+            Job *newJobs = realloc(*jobs, newCapacity * sizeof(Job));
+            if (newJobs == NULL) {
+                
+                connection->closing = true;
+                return false;
+            }
+            
+            *jobs = newJobs;
+            *capacity = newCapacity;
+        }
+        
+        Job *job = &(*jobs)[*count];
+        job->connection = index;
+        job->header = header;
+        job->payload = payload;
+        *count += 1;
+    }
+    
+    return true;
+}
+
+// MARK: - Startup
+
+static bool LoadDesigns(const char *path) {
+    
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        
+        fprintf(stderr, "c57_91d: could not open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    
+    char line[4096];
+    int lineNumber = 0;
+    int loaded = 0;
+    
+    while (fgets(line, sizeof(line), file) != NULL) {
+        
+        lineNumber += 1;
+        
+        char *cursor = line;
+        while (*cursor == ' ' || *cursor == '\t') {
+            
+            cursor += 1;
+        }
+        
+        if (*cursor == '#' || *cursor == '\n' || *cursor == '\0') {
+            
+            continue;
+        }
+        
+        double values[C57_91D_DESIGN_FIELDS + 1];
+        int found = 0;
+        
+        while (found < C57_91D_DESIGN_FIELDS + 1) {
+            
+            char *end;
+            values[found] = strtod(cursor, &end);
+            if (end == cursor) {
+                
+                break;
+            }
+            
+            cursor = end;
+            found += 1;
+        }
+        
+        // the id is checked with a negated test so that a NaN is rejected before it is converted
+        C57_91_Design design;
+        if (found != C57_91D_DESIGN_FIELDS + 1 || !(values[0] >= 0.0 && values[0] < C57_91D_MAX_DESIGNS) || !C57_91_DesignFromFields(&values[1], &design)) {
+            
+            fprintf(stderr, "c57_91d: %s, line %d: invalid design (expected an id and %d fields)\n", path, lineNumber, C57_91D_DESIGN_FIELDS);
+            fclose(file);
+            return false;
+        }
+        
+        Designs[(int)values[0]].design = design;
+        Designs[(int)values[0]].defined = true;
+        loaded += 1;
+    }
+    
+    fclose(file);
+    
+    if (Verbose) {
+        
+        fprintf(stderr, "c57_91d: loaded %d designs from %s\n", loaded, path);
+    }
+    
+    return true;
+}
+
+static int OpenSocket(const char *path) {
+    
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        
+        fprintf(stderr, "c57_91d: the socket path is too long\n");
+        return -1;
+    }
+    
+    strcpy(address.sun_path, path);
+    
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        
+        perror("c57_91d: socket");
+        return -1;
+    }
+    
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, 128) != 0) {
+        
+        perror("c57_91d: bind");
+        close(fd);
+        return -1;
+    }
+    
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    
+    return fd;
+}
+
+static void HandleSignal(int signal) {
+    
+    (void)signal;
+    Quit = 1;
+}
+
+int main(int argc, char *argv[]) {
+    
+    const char *socketPath = C57_91D_DEFAULT_SOCKET;
+    const char *designPath = NULL;
+    const char *cachePath = NULL;
+    int threadCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int cacheEntries = 65536;
+    
+    int option;
+    while ((option = getopt(argc, argv, "s:d:t:c:p:v")) != -1) {
+        
+        switch (option) {
+            
+            case 's': socketPath = optarg; break;
+            case 'd': designPath = optarg; break;
+            case 't': threadCount = atoi(optarg); break;
+            case 'c': cacheEntries = atoi(optarg); break;
+            case 'p': cachePath = optarg; break;
+            case 'v': Verbose = true; break;
+            
+            default:
+                fprintf(stderr, "usage: c57_91d [-s socket] [-d designFile] [-t threads] [-c cacheEntries] [-p cacheFile] [-v]\n");
+                return EXIT_FAILURE;
+        }
+    }
+    
+    threadCount = threadCount < 1 ? 1 : (threadCount > MAX_THREADS ? MAX_THREADS : threadCount);
+    
+    for (int i = 0; i < C57_91D_MAX_DESIGNS; i++) {
+        
+        pthread_mutex_init(&Designs[i].memoLock, NULL);
+    }
+    
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+        
+        Connections[i].fd = -1;
+    }
+    
+    if (designPath != NULL && !LoadDesigns(designPath)) {
+        
+        return EXIT_FAILURE;
+    }
+    
+    Cache = C57_91_CacheOpen(cacheEntries, cachePath, cacheEntries);
+    if (Cache == NULL) {
+        
+        fprintf(stderr, "c57_91d: could not open the result cache\n");
+        return EXIT_FAILURE;
+    }
+    
+    if (cachePath != NULL && !C57_91_CacheGetStatistics(Cache).hasDiskTier) {
+        
+        fprintf(stderr, "c57_91d: %s was written with a different cache size or engine version, running without the on-disk cache\n", cachePath);
+    }
+    
+    const int listener = OpenSocket(socketPath);
+    if (listener < 0) {
+        
+        return EXIT_FAILURE;
+    }
+    
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = HandleSignal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    
+    // the I/O thread is one of the workers
+    Pool.workerCount = threadCount - 1;
+    for (int i = 0; i < Pool.workerCount; i++) {
+        
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, Worker, NULL) != 0) {
+            
+            Pool.workerCount = i;
+            break;
+        }
+        
+        pthread_detach(thread);
+    }
+    
+    if (Verbose) {
+        
+        fprintf(stderr, "c57_91d: listening on %s with %d threads\n", socketPath, Pool.workerCount + 1);
+    }
+    
+    struct pollfd fds[MAX_CONNECTIONS + 1];
+    int fdConnection[MAX_CONNECTIONS + 1];
+    Job *jobs = NULL;
+    size_t *order = NULL;
+    size_t jobCapacity = 0;
+    size_t orderCapacity = 0;
+    
+    while (!Quit) {
+        
+        int fdCount = 0;
+        fds[fdCount].fd = listener;
+        fds[fdCount].events = POLLIN;
+        fdConnection[fdCount] = -1;
+        fdCount += 1;
+        
+        for (int i = 0; i < MAX_CONNECTIONS; i++) {
+            
+            if (Connections[i].fd >= 0) {
+                
+                fds[fdCount].fd = Connections[i].fd;
+                fds[fdCount].events = POLLIN | (Connections[i].outputLength > 0 ? POLLOUT : 0);
+                fdConnection[fdCount] = i;
+                fdCount += 1;
+            }
+        }
+        
+        if (poll(fds, (nfds_t)fdCount, -1) < 0) {
+            
+            if (errno == EINTR) {
+                
+                continue;
+            }
+            
+            perror("c57_91d: poll");
+            break;
+        }
+        
+        if (fds[0].revents & POLLIN) {
+            
+            int fd;
+            while ((fd = accept(listener, NULL, NULL)) >= 0) {
+                
+                int slot = 0;
+                while (slot < MAX_CONNECTIONS && Connections[slot].fd >= 0) {
+                    
+                    slot += 1;
+                }
+                
+                if (slot == MAX_CONNECTIONS) {
+                    
+                    close(fd);
+                    continue;
+                }
+                
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                Connections[slot].fd = fd;
+            }
+        }
+        
+        // collect everything that has arrived into one batch
+        size_t jobCount = 0;
+        for (int i = 1; i < fdCount; i++) {
+            
+            Connection *connection = &Connections[fdConnection[i]];
+            
+            if (fds[i].revents & POLLOUT) {
+                
+                FlushOutput(connection);
+            }
+            
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                
+                ReadRequests(fdConnection[i], &jobs, &jobCount, &jobCapacity);
+            }
+        }
+        
+        if (jobCount > 0) {
+            
+            if (jobCount > orderCapacity) {
+                
+                free(order);
+                orderCapacity = jobCapacity;
+                order = malloc(orderCapacity * sizeof(size_t));
+                if (order == NULL) {
+                    
+                    fprintf(stderr, "c57_91d: out of memory\n");
+                    break;
+                }
+            }
+            
+            RunBatch(jobs, order, jobCount);
+            
+            Statistics.batches += 1;
+            if (jobCount > Statistics.largestBatch) {
+                
+                Statistics.largestBatch = jobCount;
+            }
+            
+            for (size_t i = 0; i < jobCount; i++) {
+                
+                QueueReply(&Connections[jobs[i].connection], jobs[i].header.type, (uint16_t)jobs[i].status, jobs[i].header.requestId, &jobs[i].reply, jobs[i].replyLength);
+            }
+        }
+        
+        // send the replies and drop the requests that have been answered
+        for (int i = 0; i < MAX_CONNECTIONS; i++) {
+            
+            Connection *connection = &Connections[i];
+            if (connection->fd < 0) {
+                
+                continue;
+            }
+            
+            if (connection->outputLength > 0) {
+                
+                FlushOutput(connection);
+            }
+            
+            if (connection->closing) {
+                
+                CloseConnection(connection);
+                continue;
+            }
+            
+            memmove(connection->input, connection->input + connection->inputConsumed, connection->inputLength - connection->inputConsumed);
+            connection->inputLength -= connection->inputConsumed;
+            connection->inputConsumed = 0;
+        }
+    }
+    
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+        
+        if (Connections[i].fd >= 0) {
+            
+            CloseConnection(&Connections[i]);
+        }
+    }
+    
+    close(listener);
+    unlink(socketPath);
+    
+    if (Verbose) {
+        
+        const C57_91_CacheStatistics cacheStatistics = C57_91_CacheGetStatistics(Cache);
+        fprintf(stderr, "c57_91d: %llu requests in %llu batches (largest %zu), cache hits %llu, misses %llu\n", (unsigned long long)Statistics.requests, (unsigned long long)Statistics.batches, Statistics.largestBatch, (unsigned long long)(cacheStatistics.memoryHits + cacheStatistics.diskHits), (unsigned long long)cacheStatistics.misses);
+    }
+    
+    C57_91_CacheClose(Cache);
+    free(jobs);
+    free(order);
+    
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+//
+//  C57_91_Protocol.h
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-28.
+//
+
+// The binary protocol of the rating service (c57_91d). Every message (in both directions) is a C57_91D_Header followed by 'length' bytes of payload. The socket is a local (Unix domain) socket, so all values are in the byte order of the host and the structs are sent as they are laid out in memory (every struct here is a multiple of 8 bytes with no implicit padding).
+
+// A client can send any number of requests without waiting for the replies. Replies carry the requestId of the request, and replies to requests on one connection are not necessarily sent in the order of the requests.
+
+#ifndef C57_91_Protocol_h
+#define C57_91_Protocol_h
+
+#include "C57_91_Engine.h"
+#include <stdint.h>
+
+#define C57_91D_MAGIC 0x39354335u // "5C59" in memory on little-endian hosts
+#define C57_91D_DEFAULT_SOCKET "/tmp/c57_91d.sock"
+
+// limits
+#define C57_91D_MAX_DESIGNS 1024
+#define C57_91D_MAX_POINTS 4096
+#define C57_91D_MAX_PAYLOAD (sizeof(C57_91D_RunRequest) + C57_91D_MAX_POINTS * sizeof(C57_91_ProfilePoint))
+
+// the number of doubles in a design (a design row, see C57_91_DesignFromFields())
+#define C57_91D_DESIGN_FIELDS C57_91_DESIGN_FIELDS
+
+typedef enum {
+    
+    C57_91D_DEFINE_DESIGN = 1,  // C57_91D_DesignRequest -> no payload
+    C57_91D_RUN = 2,            // C57_91D_RunRequest + profile points -> C57_91D_RunReply
+    C57_91D_ALLOWABLE_LOAD = 3, // C57_91D_AllowableLoadRequest -> C57_91D_AllowableLoadReply
+    C57_91D_PING = 4            // no payload -> no payload
+    
+} C57_91D_MessageType;
+
+typedef enum {
+    
+    C57_91D_OK = 0,
+    C57_91D_BAD_REQUEST,
+    C57_91D_UNKNOWN_DESIGN,
+    C57_91D_INVALID_PROFILE,
+    C57_91D_NOT_FOUND // no allowable load (the limits are exceeded even at no load)
+    
+} C57_91D_Status;
+
+// run flags
+#define C57_91D_FLAG_OVEREXCITATION 0x01u  // use the core losses with overexcitation
+#define C57_91D_FLAG_SINGLE 0x02u          // use the single-precision engine
+#define C57_91D_FLAG_START_STATE 0x04u     // start at the state in the request instead of the tested temperatures
+
+typedef struct {
+    
+    uint32_t magic;
+    uint16_t type;   // C57_91D_MessageType
+    uint16_t status; // C57_91D_Status (replies only)
+    uint32_t requestId;
+    uint32_t length; // payload bytes
+    
+} C57_91D_Header;
+
+// Define (or replace) a resident design
+typedef struct {
+    
+    uint32_t designId; // less than C57_91D_MAX_DESIGNS
+    uint32_t reserved;
+    double fields[C57_91D_DESIGN_FIELDS];
+    
+} C57_91D_DesignRequest;
+
+// Run a load profile on a design. The payload is followed by 'count' C57_91_ProfilePoints (see C57_91_Run()).
+typedef struct {
+    
+    uint32_t designId;
+    uint32_t count;
+    uint32_t flags;
+    uint32_t reserved;
+    double deltaT; // min
+    C57_91_State start; // only used with C57_91D_FLAG_START_STATE
+    
+} C57_91D_RunRequest;
+
+typedef struct {
+    
+    double maxHotspot;
+    double maxHotspotTime;
+    double maxTopOil;
+    double maxTopOilTime;
+    double maxAverageWinding;
+    double maxAverageWindingTime;
+    double agingFactor;
+    
+} C57_91D_RunReply;
+
+// Find the highest constant load that can be carried for 'duration' minutes without exceeding the limits. The transformer starts in the steady state at 'preloadK' (24 hours at the preload and ambient, starting from the tested temperatures shifted to the ambient).
+typedef struct {
+    
+    uint32_t designId;
+    uint32_t flags;
+    double preloadK;
+    double ambient; // °C
+    double duration; // min
+    double hotspotLimit; // °C
+    double topOilLimit; // °C
+    double deltaT; // min
+    
+} C57_91D_AllowableLoadRequest;
+
+typedef struct {
+    
+    double K;
+    double maxHotspot;
+    double maxTopOil;
+    double agingFactor;
+    
+} C57_91D_AllowableLoadReply;
+
+#endif /* C57_91_Protocol_h */
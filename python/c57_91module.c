@@ -0,0 +1,507 @@
+//
+//  c57_91module.c
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-27.
+//
+
+// Python bindings for the native engine (C57_91_Engine.h). The interface is batch-oriented: arrays of designs and profiles go in, arrays of maxima (and optionally trajectories) come out. All arrays are passed through the buffer protocol, so NumPy arrays (or array.array, memoryview, etc) are used in place without copying, and output arrays can be supplied by the caller. The GIL is released while the engine runs, and the batch is split over worker threads.
+//
+// Usage (with NumPy):
+//
+//  import numpy as np, c57_91
+//  designs = np.zeros((n, c57_91.DESIGN_SIZE))     # one row per design, columns in the order of c57_91.DESIGN_FIELDS
+//  points = np.array([[0, 1.0, 30], [720, 1.2, 30], [1440, 1.0, 30]])   # time (min), load (pu), ambient (°C)
+//  offsets = np.array([0, 3], dtype=np.int64)     # profile i is points[offsets[i]:offsets[i+1]]
+//  maxima, traces = c57_91.run_batch(designs, points, offsets, trace_interval=15.0, trace_capacity=100)
+//  maxima = np.asarray(maxima)                     # shape (designs, profiles, RESULT_SIZE), no copy
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "C57_91_Engine.h"
+
+// The columns of a design row (see C57_91_DesignFromFields())
+#define DESIGN_SIZE ((Py_ssize_t)C57_91_DESIGN_FIELDS)
+
+// The columns of a result row
+static const char *const ResultFields[] = {"maxHotspot", "maxHotspotTime", "maxTopOil", "maxTopOilTime", "maxAverageWinding", "maxAverageWindingTime", "agingFactor", "steps"};
+#define RESULT_SIZE ((Py_ssize_t)(sizeof(ResultFields) / sizeof(ResultFields[0])))
+
+// The columns of a trace entry (the members of C57_91_State)
+static const char *const StateFields[] = {"theta_A", "theta_W", "theta_H", "theta_TDO", "theta_TO", "theta_BO"};
+#define STATE_SIZE ((Py_ssize_t)(sizeof(StateFields) / sizeof(StateFields[0])))
+
+// Everything the worker threads need
+typedef struct {
+    
+    const C57_91_Design *designs;
+    Py_ssize_t designCount;
+    
+    const C57_91_ProfilePoint *points;
+    const int64_t *offsets;
+    Py_ssize_t profileCount;
+    
+    // one per design (NULL means start at the tested temperatures)
+    const C57_91_State *starts;
+    
+    double deltaT;
+    bool withOverexcitation;
+    C57_91_Precision precision;
+    
+    double *maxima;
+    C57_91_State *traces;
+    double traceInterval;
+    int traceCapacity;
+    
+    _Atomic Py_ssize_t nextJob;
+    
+} BatchJob;
+
+static void RunJob(BatchJob *batch, Py_ssize_t job) {
+    
+    const Py_ssize_t designIndex = job / batch->profileCount;
+    const Py_ssize_t profileIndex = job % batch->profileCount;
+    
+    const C57_91_Design *design = &batch->designs[designIndex];
+    const C57_91_State start = batch->starts != NULL ? batch->starts[designIndex] : C57_91_TestedState(design);
+    const int64_t first = batch->offsets[profileIndex];
+    const int count = (int)(batch->offsets[profileIndex + 1] - first);
+    
+    C57_91_State *trace = batch->traces != NULL ? &batch->traces[job * batch->traceCapacity] : NULL;
+    
+    C57_91_RunResult result;
+    C57_91_Run(design, &start, &batch->points[first], count, batch->deltaT, batch->withOverexcitation, batch->precision, trace, batch->traceInterval, batch->traceCapacity, &result);
+    
+    double *row = &batch->maxima[job * RESULT_SIZE];
+    row[0] = result.maxHotspot;
+    row[1] = result.maxHotspotTime;
+    row[2] = result.maxTopOil;
+    row[3] = result.maxTopOilTime;
+    row[4] = result.maxAverageWinding;
+    row[5] = result.maxAverageWindingTime;
+    row[6] = result.agingFactor;
+    row[7] = (double)result.steps;
+    
+    // unused trace entries are marked with NaN
+    for (int i = result.traceCount; trace != NULL && i < batch->traceCapacity; i++) {
+        
+        C57_91_State empty = {NAN, NAN, NAN, NAN, NAN, NAN};
+        trace[i] = empty;
+    }
+}
+
+static void *Worker(void *argument) {
+    
+    BatchJob *batch = (BatchJob *)argument;
+    const Py_ssize_t jobCount = batch->designCount * batch->profileCount;
+    
+    while (true) {
+        
+        const Py_ssize_t job = atomic_fetch_add_explicit(&batch->nextJob, 1, memory_order_relaxed);
+        if (job >= jobCount) {
+            
+            break;
+        }
+        
+        RunJob(batch, job);
+    }
+    
+    return NULL;
+}
+
+// Get a C-contiguous buffer of doubles (or int64s) with the given number of columns (0 means any shape)
+static bool GetBuffer(PyObject *object, Py_buffer *view, bool writable, char type, Py_ssize_t columns, const char *name) {
+    
+    int flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT;
+    if (writable) {
+        
+        flags |= PyBUF_WRITABLE;
+    }
+    
+    if (PyObject_GetBuffer(object, view, flags) != 0) {
+        
+        return false;
+    }
+    
+    // accept native and explicit little-endian formats
+    const char *format = view->format != NULL ? view->format : "B";
+    if (format[0] == '<' || format[0] == '=' || format[0] == '@') {
+        
+        format += 1;
+    }
+    
+    const bool isDouble = type == 'd' && strcmp(format, "d") == 0 && view->itemsize == 8;
+    const bool isInt64 = type == 'q' && (strcmp(format, "q") == 0 || (strcmp(format, "l") == 0 && view->itemsize == 8)) && view->itemsize == 8;
+    if (!isDouble && !isInt64) {
+        
+        PyErr_Format(PyExc_TypeError, "%s must be a contiguous array of %s", name, type == 'd' ? "float64" : "int64");
+        PyBuffer_Release(view);
+        return false;
+    }
+    
+    const Py_ssize_t items = view->len / view->itemsize;
+    if (columns > 0 && (items % columns != 0 || (view->ndim > 1 && view->shape[view->ndim - 1] != columns))) {
+        
+        PyErr_Format(PyExc_ValueError, "%s must have %zd columns", name, columns);
+        PyBuffer_Release(view);
+        return false;
+    }
+    
+    return true;
+}
+
+// A new writable array of doubles with the given shape (a memoryview over a bytearray, which NumPy can wrap without copying)
+static PyObject *NewArray(Py_ssize_t *shape, int ndim) {
+    
+    Py_ssize_t items = 1;
+    for (int i = 0; i < ndim; i++) {
+        
+        items *= shape[i];
+    }
+    
+    PyObject *bytes = PyByteArray_FromStringAndSize(NULL, items * (Py_ssize_t)sizeof(double));
+    if (bytes == NULL) {
+        
+        return NULL;
+    }
+    
+    memset(PyByteArray_AsString(bytes), 0, (size_t)(items * (Py_ssize_t)sizeof(double)));
+    
+    PyObject *view = PyMemoryView_FromObject(bytes);
+    Py_DECREF(bytes);
+    if (view == NULL) {
+        
+        return NULL;
+    }
+    
+    PyObject *shapeTuple = PyTuple_New(ndim);
+    for (int i = 0; i < ndim; i++) {
+        
+        PyTuple_SET_ITEM(shapeTuple, i, PyLong_FromSsize_t(shape[i]));
+    }
+    
+    PyObject *result = PyObject_CallMethod(view, "cast", "sO", "d", shapeTuple);
+    Py_DECREF(shapeTuple);
+    Py_DECREF(view);
+    
+    return result;
+}
+
+PyDoc_STRVAR(RunBatchDoc,
+"run_batch(designs, points, offsets, starts=None, delta_t=0.5, overexcitation=False, single_precision=False, trace_interval=0.0, trace_capacity=0, maxima=None, traces=None, threads=0)\n"
+"\n"
+"Run every profile on every design. 'designs' is float64 (designs, DESIGN_SIZE); 'points' is float64 (n, 3) holding\n"
+"time (min), load (pu) and ambient (°C); profile i is points[offsets[i]:offsets[i+1]] ('offsets' is int64). 'starts'\n"
+"is an optional float64 (designs, STATE_SIZE) of starting states (default: the tested temperatures).\n"
+"\n"
+"Returns (maxima, traces): maxima is (designs, profiles, RESULT_SIZE) and traces is (designs, profiles,\n"
+"trace_capacity, STATE_SIZE) or None. If 'maxima' or 'traces' are given, they are filled in place and returned.\n"
+"The GIL is released during the computation, which uses 'threads' worker threads (0 means one per CPU).");
+
+static PyObject *RunBatch(PyObject *self, PyObject *args, PyObject *kwargs) {
+    
+    (void)self;
+    
+    static char *keywords[] = {"designs", "points", "offsets", "starts", "delta_t", "overexcitation", "single_precision", "trace_interval", "trace_capacity", "maxima", "traces", "threads", NULL};
+    
+    PyObject *designsObject = NULL;
+    PyObject *pointsObject = NULL;
+    PyObject *offsetsObject = NULL;
+    PyObject *startsObject = Py_None;
+    double deltaT = 0.5;
+    int withOverexcitation = 0;
+    int singlePrecision = 0;
+    double traceInterval = 0.0;
+    int traceCapacity = 0;
+    PyObject *maximaObject = Py_None;
+    PyObject *tracesObject = Py_None;
+    int threadCount = 0;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOO|Odppdi$OOi", keywords, &designsObject, &pointsObject, &offsetsObject, &startsObject, &deltaT, &withOverexcitation, &singlePrecision, &traceInterval, &traceCapacity, &maximaObject, &tracesObject, &threadCount)) {
+        
+        return NULL;
+    }
+    
+    if (traceCapacity < 0 || (traceCapacity > 0 && traceInterval <= 0.0)) {
+        
+        PyErr_SetString(PyExc_ValueError, "trace_capacity must be >= 0 and trace_interval must be > 0 when a trace is requested");
+        return NULL;
+    }
+    
+    Py_buffer designsView, pointsView, offsetsView, startsView, maximaView, tracesView;
+    bool haveStarts = false, haveMaxima = false, haveTraces = false;
+    PyObject *result = NULL;
+    PyObject *maxima = NULL;
+    PyObject *traces = NULL;
+    C57_91_Design *designs = NULL;
+    
+    if (!GetBuffer(designsObject, &designsView, false, 'd', DESIGN_SIZE, "designs")) {
+        
+        return NULL;
+    }
+    
+    if (!GetBuffer(pointsObject, &pointsView, false, 'd', 3, "points")) {
+        
+        PyBuffer_Release(&designsView);
+        return NULL;
+    }
+    
+    if (!GetBuffer(offsetsObject, &offsetsView, false, 'q', 0, "offsets")) {
+        
+        PyBuffer_Release(&designsView);
+        PyBuffer_Release(&pointsView);
+        return NULL;
+    }
+    
+    const Py_ssize_t designCount = designsView.len / (DESIGN_SIZE * (Py_ssize_t)sizeof(double));
+    const Py_ssize_t pointCount = pointsView.len / (3 * (Py_ssize_t)sizeof(double));
+    const Py_ssize_t profileCount = offsetsView.len / (Py_ssize_t)sizeof(int64_t) - 1;
+    const int64_t *offsets = (const int64_t *)offsetsView.buf;
+    
+    if (profileCount < 1) {
+        
+        PyErr_SetString(PyExc_ValueError, "offsets must have at least 2 entries");
+        goto cleanup;
+    }
+    
+    for (Py_ssize_t i = 0; i < profileCount; i++) {
+        
+        if (offsets[i] < 0 || offsets[i + 1] <= offsets[i] || offsets[i + 1] > pointCount || ((const double *)pointsView.buf)[offsets[i] * 3] != 0.0) {
+            
+            PyErr_Format(PyExc_ValueError, "profile %zd is empty, out of range, or does not start at time 0", i);
+            goto cleanup;
+        }
+    }
+    
+    if (startsObject != Py_None) {
+        
+        if (!GetBuffer(startsObject, &startsView, false, 'd', STATE_SIZE, "starts")) {
+            
+            goto cleanup;
+        }
+        
+        haveStarts = true;
+        if (startsView.len / (STATE_SIZE * (Py_ssize_t)sizeof(double)) != designCount) {
+            
+            PyErr_SetString(PyExc_ValueError, "starts must have one row per design");
+            goto cleanup;
+        }
+    }
+    
+    // outputs: the caller's arrays, or new ones
+    if (maximaObject == Py_None) {
+        
+        Py_ssize_t shape[3] = {designCount, profileCount, RESULT_SIZE};
+        maxima = NewArray(shape, 3);
+        if (maxima == NULL) {
+            
+            goto cleanup;
+        }
+    }
+    else {
+        
+        maxima = maximaObject;
+        Py_INCREF(maxima);
+    }
+    
+    if (!GetBuffer(maxima, &maximaView, true, 'd', RESULT_SIZE, "maxima")) {
+        
+        goto cleanup;
+    }
+    
+    haveMaxima = true;
+    if (maximaView.len != designCount * profileCount * RESULT_SIZE * (Py_ssize_t)sizeof(double)) {
+        
+        PyErr_SetString(PyExc_ValueError, "maxima has the wrong size");
+        goto cleanup;
+    }
+    
+    if (traceCapacity > 0) {
+        
+        if (tracesObject == Py_None) {
+            
+            Py_ssize_t shape[4] = {designCount, profileCount, traceCapacity, STATE_SIZE};
+            traces = NewArray(shape, 4);
+            if (traces == NULL) {
+                
+                goto cleanup;
+            }
+        }
+        else {
+            
+            traces = tracesObject;
+            Py_INCREF(traces);
+        }
+        
+        if (!GetBuffer(traces, &tracesView, true, 'd', STATE_SIZE, "traces")) {
+            
+            goto cleanup;
+        }
+        
+        haveTraces = true;
+        if (tracesView.len != designCount * profileCount * traceCapacity * STATE_SIZE * (Py_ssize_t)sizeof(double)) {
+            
+            PyErr_SetString(PyExc_ValueError, "traces has the wrong size");
+            goto cleanup;
+        }
+    }
+    
+    // the designs are the only thing that is converted (they are small, and need their derived fields calculated)
+    designs = PyMem_RawMalloc((size_t)(designCount > 0 ? designCount : 1) * sizeof(C57_91_Design));
+    if (designs == NULL) {
+        
+        PyErr_NoMemory();
+        goto cleanup;
+    }
+    
+    const double *rows = (const double *)designsView.buf;
+    for (Py_ssize_t i = 0; i < designCount; i++) {
+        
+        const double *row = &rows[i * DESIGN_SIZE];
+        C57_91_Design *design = &designs[i];
+        
+        if (!C57_91_DesignFromFields(row, design)) {
+            
+            PyErr_Format(PyExc_ValueError, "design %zd has an invalid cooling, fluid or conductor type", i);
+            goto cleanup;
+        }
+    }
+    
+    BatchJob batch;
+    batch.designs = designs;
+    batch.designCount = designCount;
+    batch.points = (const C57_91_ProfilePoint *)pointsView.buf;
+    batch.offsets = offsets;
+    batch.profileCount = profileCount;
+    batch.starts = haveStarts ? (const C57_91_State *)startsView.buf : NULL;
+    batch.deltaT = deltaT;
+    batch.withOverexcitation = withOverexcitation != 0;
+    batch.precision = singlePrecision ? C57_91_SINGLE : C57_91_DOUBLE;
+    batch.maxima = (double *)maximaView.buf;
+    batch.traces = haveTraces ? (C57_91_State *)tracesView.buf : NULL;
+    batch.traceInterval = traceInterval;
+    batch.traceCapacity = haveTraces ? traceCapacity : 0;
+    atomic_init(&batch.nextJob, 0);
+    
+    const Py_ssize_t jobCount = designCount * profileCount;
+    if (threadCount <= 0) {
+        
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = cpus > 0 ? (int)cpus : 1;
+    }
+    if (threadCount > jobCount) {
+        
+        threadCount = jobCount > 0 ? (int)jobCount : 1;
+    }
+    
+    Py_BEGIN_ALLOW_THREADS
+    
+    pthread_t workers[64];
+    int started = 0;
+    for (int i = 1; i < threadCount && started < 64; i++) {
+        
+        if (pthread_create(&workers[started], NULL, Worker, &batch) == 0) {
+            
+            started += 1;
+        }
+    }
+    
+    // this thread works too
+    Worker(&batch);
+    
+    for (int i = 0; i < started; i++) {
+        
+        pthread_join(workers[i], NULL);
+    }
+    
+    Py_END_ALLOW_THREADS
+    
+    result = Py_BuildValue("(OO)", maxima, traces != NULL ? traces : Py_None);
+
+cleanup:
+    
+    PyMem_RawFree(designs);
+    PyBuffer_Release(&designsView);
+    PyBuffer_Release(&pointsView);
+    PyBuffer_Release(&offsetsView);
+    
+    if (haveStarts) {
+        
+        PyBuffer_Release(&startsView);
+    }
+    
+    if (haveMaxima) {
+        
+        PyBuffer_Release(&maximaView);
+    }
+    
+    if (haveTraces) {
+        
+        PyBuffer_Release(&tracesView);
+    }
+    
+    Py_XDECREF(maxima);
+    Py_XDECREF(traces);
+    
+    return result;
+}
+
+static PyMethodDef ModuleMethods[] = {
+    
+    {"run_batch", (PyCFunction)(void (*)(void))RunBatch, METH_VARARGS | METH_KEYWORDS, RunBatchDoc},
+    {NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef ModuleDefinition = {
+    
+    PyModuleDef_HEAD_INIT,
+    "c57_91",
+    "Batched IEEE C57.91 Annex G overload calculations (see run_batch).",
+    -1,
+    ModuleMethods,
+    NULL, NULL, NULL, NULL
+};
+
+static PyObject *FieldTuple(const char *const *fields, Py_ssize_t count) {
+    
+    PyObject *result = PyTuple_New(count);
+    for (Py_ssize_t i = 0; result != NULL && i < count; i++) {
+        
+        PyTuple_SET_ITEM(result, i, PyUnicode_FromString(fields[i]));
+    }
+    
+    return result;
+}
+
+PyMODINIT_FUNC PyInit_c57_91(void) {
+    
+    PyObject *module = PyModule_Create(&ModuleDefinition);
+    if (module == NULL) {
+        
+        return NULL;
+    }
+    
+    PyModule_AddObject(module, "DESIGN_FIELDS", FieldTuple(C57_91_DesignFieldNames, DESIGN_SIZE));
+    PyModule_AddObject(module, "RESULT_FIELDS", FieldTuple(ResultFields, RESULT_SIZE));
+    PyModule_AddObject(module, "STATE_FIELDS", FieldTuple(StateFields, STATE_SIZE));
+    PyModule_AddIntConstant(module, "DESIGN_SIZE", DESIGN_SIZE);
+    PyModule_AddIntConstant(module, "RESULT_SIZE", RESULT_SIZE);
+    PyModule_AddIntConstant(module, "STATE_SIZE", STATE_SIZE);
+    
+    PyModule_AddIntConstant(module, "ONAN", ONAN);
+    PyModule_AddIntConstant(module, "ONAF", ONAF);
+    PyModule_AddIntConstant(module, "OFAF", OFAF);
+    PyModule_AddIntConstant(module, "ODAF", ODAF);
+    PyModule_AddIntConstant(module, "MINERAL_OIL", MINERAL_OIL);
+    PyModule_AddIntConstant(module, "SILICON_OIL", SILICON_OIL);
+    PyModule_AddIntConstant(module, "HTHC", HTHC);
+    PyModule_AddIntConstant(module, "CU", CU);
+    PyModule_AddIntConstant(module, "AL", AL);
+    
+    return module;
+}
@@ -0,0 +1,33 @@
+#
+#  setup.py
+#  OverloadTemperatures
+#
+#  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-27.
+#
+
+# Builds the c57_91 extension module from the native engine sources in ../OverloadTemperatures:
+#
+#   python3 setup.py build_ext --inplace
+#
+# NumPy is not required to build or use the module; any object that supports the buffer protocol is accepted.
+
+import os
+from setuptools import setup, Extension
+
+engineDirectory = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "OverloadTemperatures")
+engineSources = ["C57_91_Functions.c", "C57_91_Engine.c"]
+
+module = Extension(
+    "c57_91",
+    sources=["c57_91module.c"] + [os.path.relpath(os.path.join(engineDirectory, source)) for source in engineSources],
+    include_dirs=[engineDirectory],
+    extra_compile_args=["-std=c11", "-O2"],
+    libraries=["m", "pthread"],
+)
+
+setup(
+    name="c57_91",
+    version="1.0",
+    description="Batched IEEE C57.91 Annex G overload calculations",
+    ext_modules=[module],
+)
@@ -0,0 +1,677 @@
+//
+//  C57_91_Validation.c
+//  OverloadTemperatures
+//
+//  Created by Peter Huber (Huberis Technologies Inc.) on 2023-01-30.
+//
+
+// c57_91_validation: the accuracy-versus-speed harness for the approximate execution modes of the native engine. It builds a randomized (but reproducible) corpus of plausible designs and daily load profiles, runs every case through a reference implementation that uses only the equation functions of C57_91_Functions.c (a line-by-line port of OverloadModel.CalculateTempsForLoadCycle() and DoOverloadCalculations()), then through the native engine in every mode. For each mode, it reports the worst-case and percentile deviations of the maximum hot-spot temperature, the maximum top-oil temperature and the aging factor, next to the measured speedup. Cases that the reference cannot finish are replaced by new draws, and listed with the reason. Cases whose top duct oil oscillates (see C57_91_OSCILLATION_STEPS) are kept, and their deviations are reported in a row of their own under each mode, with the same tolerances: the approximate modes hand those runs to the exact engine, and that row checks that they still agree with the reference. The exit status is non-zero if, in any mode, a worst-case deviation or a deviation at the checked percentile exceeds its tolerance, in either row.
+
+// usage: c57_91_validation [-n cases] [-s seed] [-r repeats] [-H hotspotTolerance] [-O topOilTolerance] [-A agingTolerance] [-p checkedPercentile] [-h worstHotspotTolerance] [-o worstTopOilTolerance] [-a worstAgingTolerance]
+
+#define _GNU_SOURCE
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "C57_91_Engine.h"
+
+// the step that the cases start with, min
+#define CASE_DELTA_T 0.5
+
+// the length of the profiles, hours
+#define PROFILE_HOURS 24
+#define PROFILE_POINTS (2 * PROFILE_HOURS)
+
+typedef struct {
+    
+    C57_91_Design design;
+    C57_91_State start;
+    C57_91_ProfilePoint profile[PROFILE_POINTS];
+    bool withOverexcitation;
+    
+} ValidationCase;
+
+// Why the reference run of a case could not be used (or, for ReferenceOscillated, why its deviations are reported separately)
+typedef enum {
+    
+    ReferenceValid = 0,
+    ReferenceBrokeDown,
+    ReferenceUnfinished,
+    ReferenceOscillated
+    
+} ReferenceOutcome;
+
+static const char *const ReferenceOutcomeNames[] = {
+    
+    "valid",
+    "G.27 asked for a reduced Δt that was NaN or longer than the current one",
+    "the run did not reach the end of the profile",
+    "the top duct oil oscillated from step to step"
+};
+
+// A discarded case: the case it was drawn for, its position in the sequence of drawn cases (from 0, for the seed) and the reason
+typedef struct {
+    
+    int caseIndex;
+    int draw;
+    ReferenceOutcome outcome;
+    
+} DiscardedCase;
+
+typedef struct {
+    
+    const char *name;
+    C57_91_Precision precision;
+    unsigned int approximations;
+    double deltaTScale; // the starting Δt, per unit of CASE_DELTA_T
+    bool checked; // false for a baseline, which is reported but never fails
+    
+} ValidationMode;
+
+// The first mode must be the exact native engine (the speedups are also reported relative to it). The "half-step" baseline is the exact engine with half the Δt: it shows how much the results of the Annex G equations themselves depend on the step length, which is the floor for any mode that changes Δt.
+static const ValidationMode Modes[] = {
+    
+    {"native", C57_91_DOUBLE, C57_91_APPROX_NONE, 1.0, true},
+    {"half-step", C57_91_DOUBLE, C57_91_APPROX_NONE, 0.5, false},
+    {"single", C57_91_SINGLE, C57_91_APPROX_NONE, 1.0, true},
+    {"mu-table", C57_91_DOUBLE, C57_91_APPROX_MU_TABLE, 1.0, true},
+    {"large-steps", C57_91_DOUBLE, C57_91_APPROX_LARGE_STEPS, 1.0, true},
+    {"all", C57_91_SINGLE, C57_91_APPROX_MU_TABLE | C57_91_APPROX_LARGE_STEPS, 1.0, true},
+};
+
+#define MODE_COUNT ((int)(sizeof(Modes) / sizeof(Modes[0])))
+
+static int CaseCount = 2000;
+static unsigned long long Seed = 91;
+static int Repeats = 3;
+static double HotspotTolerance = 0.5;
+static double TopOilTolerance = 0.5;
+// the default aging tolerance is about the same as the hot-spot tolerance: the aging factor changes by 15000 / (ΘH + 273)², about 10%, per °C
+static double AgingTolerance = 0.05;
+// the percentile of the deviations that the tolerances above apply to (100 is the worst case)
+static double CheckedPercentile = 99.0;
+// the tolerances for the worst case, which always apply: twice the percentile tolerances, to leave room for the few cases in which the equations are most sensitive to Δt (see the "half-step" baseline)
+static double WorstHotspotTolerance = 1.0;
+static double WorstTopOilTolerance = 1.0;
+static double WorstAgingTolerance = 0.1;
+
+static double Now(void) {
+    
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    
+    return (double)now.tv_sec + (double)now.tv_nsec / 1.0e9;
+}
+
+// MARK: - Random corpus
+
+static unsigned long long RandomState;
+
+// splitmix64, so that a seed gives the same corpus on every platform
+static double RandomUniform(double low, double high) {
+    
+    RandomState += 0x9E3779B97F4A7C15ull;
+    unsigned long long z = RandomState;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z = z ^ (z >> 31);
+    
+    return low + (high - low) * (double)(z >> 11) / 9007199254740992.0;
+}
+
+static int RandomIndex(int count) {
+    
+    const int result = (int)RandomUniform(0.0, (double)count);
+    
+    return result < count ? result : count - 1;
+}
+
+/// Create a plausible design: the losses, the tested temperatures and the time constants are drawn from ranges that are typical of power transformers, and are kept consistent with each other (the winding is hotter than the duct oil, the hot-spot is hotter than the oil next to it, and so on)
+static void RandomDesign(C57_91_Design *design) {
+    
+    memset(design, 0, sizeof(C57_91_Design));
+    
+    design->cType = (C57_91_CoolingType)RandomIndex(4);
+    design->fType = (C57_91_FluidType)RandomIndex(C57_91_FLUIDTYPE_LAST_ENTRY);
+    design->wType = (C57_91_ConductorType)RandomIndex(2);
+    design->x = C57_91_X[design->cType];
+    design->y = C57_91_Y[design->cType];
+    design->z = C57_91_Z[design->cType];
+    
+    design->lossK = RandomUniform(0.8, 1.0);
+    design->tau_W = RandomUniform(4.0, 10.0);
+    
+    design->theta_REF = RandomIndex(2) == 0 ? 75.0 : 85.0;
+    design->Pw = RandomUniform(10000.0, 200000.0);
+    design->Pe = design->Pw * RandomUniform(0.02, 0.20);
+    design->EHS = design->Pe / design->Pw * RandomUniform(1.5, 4.0);
+    design->Ps = design->Pw * RandomUniform(0.05, 0.30);
+    design->PC = design->Pw * RandomUniform(0.15, 0.60);
+    design->PC_OE = design->PC * RandomUniform(1.0, 1.3);
+    
+    const double topOilRise = RandomUniform(35.0, 55.0);
+    const double bottomOilRise = topOilRise * RandomUniform(0.35, 0.75);
+    const double windingRise = topOilRise + RandomUniform(5.0, 20.0);
+    
+    design->theta_A_R = RandomUniform(20.0, 30.0);
+    design->theta_TO_R = design->theta_A_R + topOilRise;
+    design->theta_BO_R = design->theta_A_R + bottomOilRise;
+    design->theta_TDO_R = design->theta_TO_R + RandomUniform(0.0, 5.0);
+    design->theta_W_R = design->theta_A_R + windingRise;
+    design->HHS = RandomUniform(0.85, 1.0);
+    design->theta_H_R = design->theta_W_R + RandomUniform(8.0, 25.0);
+    design->ratedAverageWindingRise = windingRise > 65.0 ? ceil(windingRise) : 65.0;
+    
+    // G.7 for the winding, and a top-oil time constant of 2 to 5 hours for the rest
+    design->MCp_W = MCp_W(design->Pw, design->Pe, design->tau_W, (design->theta_TDO_R + design->theta_BO_R) / 2.0, design->theta_W_R);
+    const double totalLoss = design->Pw + design->Pe + design->Ps + design->PC;
+    design->SumMCp = RandomUniform(120.0, 300.0) * totalLoss / topOilRise;
+    
+    C57_91_PrepareDesign(design);
+}
+
+/// Create a daily profile: a constant load and ambient for every hour, with step changes in the load on the hour and the ambient varying linearly over a daily cycle
+static void RandomProfile(C57_91_ProfilePoint *profile, double baseLoad, double peakLoad) {
+    
+    const double meanAmbient = RandomUniform(10.0, 35.0);
+    const double ambientSwing = RandomUniform(0.0, 8.0);
+    const double peakHour = RandomUniform(12.0, 20.0);
+    
+    double load = baseLoad;
+    for (int hour = 0; hour <= PROFILE_HOURS; hour++) {
+        
+        const double ambient = meanAmbient + ambientSwing * cos(2.0 * M_PI * (hour - 15.0) / 24.0);
+        const double newLoad = fabs(hour - peakHour) < 2.5 ? peakLoad * RandomUniform(0.9, 1.0) : baseLoad * RandomUniform(0.7, 1.1);
+        
+        C57_91_ProfilePoint before = {hour * 60.0, load, ambient};
+        C57_91_ProfilePoint after = {hour * 60.0, newLoad, ambient};
+        
+        if (hour == 0) {
+            
+            profile[0] = after;
+        }
+        else {
+            
+            // the last hour ends without a step change
+            profile[2 * hour - 1] = before;
+            if (hour < PROFILE_HOURS) {
+                
+                profile[2 * hour] = after;
+            }
+        }
+        
+        load = newLoad;
+    }
+}
+
+static void RandomCase(ValidationCase *validationCase) {
+    
+    RandomDesign(&validationCase->design);
+    RandomProfile(validationCase->profile, RandomUniform(0.3, 0.9), RandomUniform(1.0, 1.5));
+    validationCase->withOverexcitation = RandomIndex(4) == 0;
+    
+    validationCase->start = C57_91_TestedState(&validationCase->design);
+    validationCase->start.theta_A = validationCase->profile[0].theta_A;
+}
+
+// MARK: - Reference implementation
+
+// The values of a design that the reference calculates once per run, the same as OverloadModel.ComputeStepInvariants()
+typedef struct {
+    
+    double ratedPw;
+    double ratedPe;
+    double ratedPs;
+    double ratedHsPw;
+    double ratedHsPe;
+    double testedDAO;
+    double testedWO;
+    double testedAO;
+    double testedAveVisc;
+    double testedHotspotVisc;
+    double ratedStabilityVisc;
+    
+} ReferenceInvariants;
+
+static ReferenceInvariants ReferencePrepare(const C57_91_Design *design) {
+    
+    ReferenceInvariants result;
+    
+    const double theta_K = C57_91_StandardConductors[design->wType].Tk;
+    const double kSquared = design->lossK * design->lossK;
+    const double ratedCorrection = Kw(design->theta_REF, design->theta_A_R + design->ratedAverageWindingRise, theta_K);
+    result.ratedPw = design->Pw * kSquared * ratedCorrection;
+    result.ratedPe = design->Pe * kSquared / ratedCorrection;
+    result.ratedPs = design->Ps * kSquared / ratedCorrection;
+    
+    const double hsCorrection = Kw(design->theta_REF, design->theta_H_R, theta_K);
+    result.ratedHsPw = design->Pw * kSquared * hsCorrection;
+    result.ratedHsPe = result.ratedHsPw * design->EHS;
+    
+    result.testedDAO = (design->theta_TDO_R + design->theta_BO_R) / 2.0;
+    result.testedWO = design->theta_BO_R + Delta_Theta_WOoverBO(design->HHS, design->theta_BO_R, design->theta_TDO_R);
+    result.testedAO = (design->theta_TO_R + design->theta_BO_R) / 2.0;
+    
+    result.testedAveVisc = MU(design->fType, (design->theta_W_R + result.testedDAO) / 2.0);
+    result.testedHotspotVisc = MU(design->fType, (design->theta_H_R + result.testedWO) / 2.0);
+    result.ratedStabilityVisc = MU(design->fType, (design->theta_A_R + design->ratedAverageWindingRise + result.testedDAO) / 2.0);
+    
+    return result;
+}
+
+/// One step, with the equation functions of C57_91_Functions.c in the order of OverloadModel.CalculateTempsForLoadCycle()
+static void ReferenceStep(const C57_91_Design *design, const ReferenceInvariants *invariants, C57_91_State *state, double K, double theta_A_2, double delta_T, bool withOverexcitation) {
+    
+    const double theta_K = C57_91_StandardConductors[design->wType].Tk;
+    const double lossK = K * design->lossK;
+    
+    // G.4, G.5 & G.19
+    const double windingCorrection = Kw(design->theta_REF, state->theta_W, theta_K);
+    const double QGEN_W = Q_GEN_W(lossK, windingCorrection, design->Pe, design->Pw, delta_T);
+    const double QSTRAY = QS(lossK, windingCorrection, design->Ps, delta_T);
+    
+    // G.6
+    const double theta_DAO = (state->theta_TDO + state->theta_BO) / 2.0;
+    double QLOST = 0.0;
+    if (state->theta_W > theta_DAO) {
+        
+        QLOST = QLOST_W(design->cType, invariants->ratedPe, invariants->ratedPw, theta_DAO, invariants->testedDAO, state->theta_W, design->theta_W_R, delta_T, MU(design->fType, (state->theta_W + theta_DAO) / 2.0), invariants->testedAveVisc);
+    }
+    
+    // G.8 to G.11
+    const double theta_W_2 = Theta_W_2(QGEN_W, QLOST, design->MCp_W, fmax(state->theta_W, state->theta_BO));
+    const double riseDOoverBO = Delta_Theta_DOoverBO(QLOST, design->x, delta_T, invariants->ratedPw, invariants->ratedPe, design->theta_TDO_R, design->theta_BO_R);
+    double theta_TDO_2 = state->theta_BO + riseDOoverBO;
+    const double theta_WO = (theta_TDO_2 + 0.1) < state->theta_TO ? state->theta_TO : state->theta_BO + design->HHS * riseDOoverBO;
+    const double theta_H_fixed = fmax(fmax(state->theta_H, theta_W_2), theta_WO);
+    
+    // G.12 to G.15, with the hot-spot eddy loss corrected like the I2R loss (as in Losses.windingHotspotLoss)
+    const double QGEN_HS = Q_GEN_W(lossK, Kw(design->theta_REF, theta_H_fixed, theta_K), 0.0, design->Pw * (1.0 + design->EHS), delta_T);
+    
+    // G.16 & G.17
+    const double QLOST_H = QLOST_HS(design->cType, invariants->ratedHsPe, invariants->ratedHsPw, theta_H_fixed, design->theta_H_R, theta_WO, invariants->testedWO, delta_T, MU(design->fType, (theta_H_fixed + theta_WO) / 2.0), invariants->testedHotspotVisc);
+    const double theta_H_2 = Theta_H_2(QGEN_HS, QLOST_H, design->MCp_W, state->theta_H);
+    
+    // G.18, G.20 to G.26 (the core loss selection of G.18 is the same as OverloadModel.CalculateTempsForLoadCycle())
+    const double ratedCoreLoss = withOverexcitation ? fmax(design->PC, design->PC_OE) : design->PC;
+    const double ratedTotalLoss = PT(invariants->ratedPw, invariants->ratedPe, invariants->ratedPs, ratedCoreLoss);
+    const double theta_AO = (state->theta_TO + state->theta_BO) / 2.0;
+    const double QLOST_OIL = QLOST_O(theta_AO, state->theta_A, invariants->testedAO, design->theta_A_R, design->y, ratedTotalLoss, delta_T);
+    const double QCORE = QC(withOverexcitation ? design->PC : design->PC_OE, delta_T);
+    const double theta_AO_2 = Theta_AO_2(QLOST, QSTRAY, QCORE, QLOST_OIL, theta_AO, design->SumMCp);
+    const double riseToverB = Delta_Theta_ToverB(QLOST_OIL, ratedTotalLoss, delta_T, design->z, design->theta_TO_R, design->theta_BO_R);
+    const double theta_BO_2 = fmax(theta_A_2, Theta_BO(theta_AO_2, riseToverB));
+    theta_TDO_2 = fmax(theta_TDO_2, theta_BO_2);
+    
+    state->theta_A = theta_A_2;
+    state->theta_W = theta_W_2;
+    state->theta_H = theta_H_2;
+    state->theta_TDO = theta_TDO_2;
+    state->theta_TO = Theta_TO(theta_AO_2, riseToverB);
+    state->theta_BO = theta_BO_2;
+}
+
+/// Run a case with the reference step (the time loop and the G.27 step control of OverloadModel.DoOverloadCalculations())
+/// - Returns: ReferenceValid, ReferenceOscillated, or the reason that the run cannot be used as a reference. At very light loads, the winding or the hot-spot can fall below the oil next to it, and G.27 then asks for a "reduced" Δt that is NaN or longer than the current one. G.9 has no time constant (the top duct oil of a step follows from the state at the start of the step), and with some designs it overshoots and oscillates from one step to the next, with a growing amplitude: the maximum hot-spot of such a run depends on the phase of the oscillation, which no other Δt or precision can be expected to reproduce, so the engine redoes those runs exactly (see C57_91_RunApproximate()). The reference uses the same test as the engine.
+static ReferenceOutcome ReferenceRun(const ValidationCase *validationCase, C57_91_RunResult *result) {
+    
+    const C57_91_Design *design = &validationCase->design;
+    const C57_91_ProfilePoint *profile = validationCase->profile;
+    const ReferenceInvariants invariants = ReferencePrepare(design);
+    C57_91_State state = validationCase->start;
+    
+    result->maxHotspot = state.theta_H;
+    result->maxTopOil = state.theta_TO;
+    result->steps = 0;
+    
+    double currentDeltaT = CASE_DELTA_T;
+    double maxDeltaT = 0.0;
+    if (!TestStability(true, design->cType, design->tau_W, currentDeltaT, &maxDeltaT, NULL, NULL, NULL, NULL, NULL, NULL)) {
+        
+        currentDeltaT = maxDeltaT;
+    }
+    
+    double wdgTempR[2] = {design->theta_A_R + design->ratedAverageWindingRise, design->theta_H_R};
+    double oilTempR[2] = {invariants.testedDAO, invariants.testedWO};
+    double viscosityR[2] = {invariants.ratedStabilityVisc, invariants.testedHotspotVisc};
+    
+    double lastTime = -currentDeltaT;
+    double currentTime = 0.0;
+    const double endTime = profile[PROFILE_POINTS - 1].time;
+    double agingSum = 0.0;
+    bool valid = true;
+    double lastTopDuctOilChange = 0.0;
+    int reversals = 0;
+    bool oscillated = false;
+    
+    for (int segment = 0; segment < PROFILE_POINTS - 1; segment++) {
+        
+        const double segmentLength = fmax(profile[segment + 1].time - profile[segment].time, 1.0E-12);
+        const double loadSlope = (profile[segment + 1].K - profile[segment].K) / segmentLength;
+        const double ambientSlope = (profile[segment + 1].theta_A - profile[segment].theta_A) / segmentLength;
+        
+        while (currentTime < profile[segment + 1].time && currentTime < endTime) {
+            
+            const double K = profile[segment].K + loadSlope * (currentTime - profile[segment].time);
+            const double theta_A_2 = state.theta_A + ambientSlope * (currentTime - lastTime);
+            
+            const double lastTopDuctOil = state.theta_TDO;
+            ReferenceStep(design, &invariants, &state, K, theta_A_2, currentTime - lastTime, validationCase->withOverexcitation);
+            result->steps += 1;
+            
+            const double topDuctOilChange = state.theta_TDO - lastTopDuctOil;
+            reversals = topDuctOilChange * lastTopDuctOilChange < 0.0 && fabs(topDuctOilChange) > C57_91_OSCILLATION_AMPLITUDE ? reversals + 1 : 0;
+            oscillated = oscillated || reversals >= C57_91_OSCILLATION_STEPS;
+            lastTopDuctOilChange = topDuctOilChange;
+            
+            agingSum += exp(15000.0 / 383.0 - 15000.0 / (state.theta_H + 273.0)) * currentDeltaT;
+            result->maxHotspot = fmax(result->maxHotspot, state.theta_H);
+            result->maxTopOil = fmax(result->maxTopOil, state.theta_TO);
+            
+            const double theta_DAO = (state.theta_TDO + state.theta_BO) / 2.0;
+            const double theta_WO = state.theta_BO + Delta_Theta_WOoverBO(design->HHS, state.theta_BO, state.theta_TDO);
+            double wdgTemp1[2] = {state.theta_W, state.theta_H};
+            double oilTemp1[2] = {theta_DAO, theta_WO};
+            double viscosity1[2] = {MU(design->fType, (state.theta_W + theta_DAO) / 2.0), MU(design->fType, (state.theta_H + theta_WO) / 2.0)};
+            
+            if (!TestStability(false, design->cType, design->tau_W, currentDeltaT, &maxDeltaT, wdgTemp1, wdgTempR, oilTemp1, oilTempR, viscosity1, viscosityR)) {
+                
+                if (!(maxDeltaT < currentDeltaT)) {
+                    
+                    valid = false;
+                }
+                
+                currentDeltaT = maxDeltaT;
+            }
+            
+            lastTime = currentTime;
+            currentTime += currentDeltaT;
+        }
+    }
+    
+    result->agingFactor = currentTime > 0.0 ? agingSum / currentTime : 1.0;
+    result->finalState = state;
+    
+    if (!valid) {
+        
+        return ReferenceBrokeDown;
+    }
+    
+    if (currentTime < endTime) {
+        
+        return ReferenceUnfinished;
+    }
+    
+    return oscillated ? ReferenceOscillated : ReferenceValid;
+}
+
+// MARK: - Statistics
+
+static int CompareDoubles(const void *a, const void *b) {
+    
+    const double x = *(const double *)a;
+    const double y = *(const double *)b;
+    
+    return (x > y) - (x < y);
+}
+
+/// The percentile of a sorted array (nearest rank)
+static double Percentile(const double *sorted, int count, double percent) {
+    
+    int rank = (int)ceil(percent / 100.0 * count) - 1;
+    if (rank < 0) {
+        
+        rank = 0;
+    }
+    
+    return sorted[rank < count ? rank : count - 1];
+}
+
+typedef struct {
+    
+    double worst;
+    double p50;
+    double p95;
+    double p99;
+    double checked; // at CheckedPercentile
+    
+} DeviationSummary;
+
+static DeviationSummary Summarize(double *deviations, int count) {
+    
+    qsort(deviations, (size_t)count, sizeof(double), CompareDoubles);
+    
+    DeviationSummary result = {deviations[count - 1], Percentile(deviations, count, 50.0), Percentile(deviations, count, 95.0), Percentile(deviations, count, 99.0), Percentile(deviations, count, CheckedPercentile)};
+    
+    return result;
+}
+
+/// The time to run the whole corpus, s (the fastest of 'Repeats' passes)
+static double TimeCorpus(const ValidationCase *cases, const ValidationMode *mode, C57_91_RunResult *results) {
+    
+    double best = HUGE_VAL;
+    for (int pass = 0; pass < Repeats; pass++) {
+        
+        const double start = Now();
+        for (int i = 0; i < CaseCount; i++) {
+            
+            if (mode == NULL) {
+                
+                ReferenceRun(&cases[i], &results[i]);
+            }
+            else {
+                
+                C57_91_RunApproximate(&cases[i].design, &cases[i].start, cases[i].profile, PROFILE_POINTS, CASE_DELTA_T * mode->deltaTScale, cases[i].withOverexcitation, mode->precision, mode->approximations, NULL, 0.0, 0, &results[i]);
+            }
+        }
+        
+        best = fmin(best, Now() - start);
+    }
+    
+    return best;
+}
+
+// MARK: - Main
+
+int main(int argc, char *argv[]) {
+    
+    int option;
+    while ((option = getopt(argc, argv, "n:s:r:H:O:A:p:h:o:a:")) != -1) {
+        
+        switch (option) {
+            
+            case 'n': CaseCount = atoi(optarg); break;
+            case 's': Seed = strtoull(optarg, NULL, 10); break;
+            case 'r': Repeats = atoi(optarg); break;
+            case 'H': HotspotTolerance = atof(optarg); break;
+            case 'O': TopOilTolerance = atof(optarg); break;
+            case 'A': AgingTolerance = atof(optarg); break;
+            case 'p': CheckedPercentile = atof(optarg); break;
+            case 'h': WorstHotspotTolerance = atof(optarg); break;
+            case 'o': WorstTopOilTolerance = atof(optarg); break;
+            case 'a': WorstAgingTolerance = atof(optarg); break;
+            default:
+                fprintf(stderr, "usage: c57_91_validation [-n cases] [-s seed] [-r repeats] [-H hotspotTolerance] [-O topOilTolerance] [-A agingTolerance] [-p checkedPercentile] [-h worstHotspotTolerance] [-o worstTopOilTolerance] [-a worstAgingTolerance]\n");
+                return EXIT_FAILURE;
+        }
+    }
+    
+    if (CaseCount < 1 || Repeats < 1 || !(CheckedPercentile > 0.0 && CheckedPercentile <= 100.0)) {
+        
+        fprintf(stderr, "c57_91_validation: the number of cases and the number of repeats must be positive, and the percentile must be in (0, 100]\n");
+        return EXIT_FAILURE;
+    }
+    
+    ValidationCase *cases = malloc(sizeof(ValidationCase) * (size_t)CaseCount);
+    C57_91_RunResult *reference = malloc(sizeof(C57_91_RunResult) * (size_t)CaseCount);
+    C57_91_RunResult *results = malloc(sizeof(C57_91_RunResult) * (size_t)CaseCount);
+    double *hotspot = malloc(sizeof(double) * (size_t)CaseCount);
+    double *topOil = malloc(sizeof(double) * (size_t)CaseCount);
+    double *aging = malloc(sizeof(double) * (size_t)CaseCount);
+    bool *oscillating = malloc(sizeof(bool) * (size_t)CaseCount);
+    if (cases == NULL || reference == NULL || results == NULL || hotspot == NULL || topOil == NULL || aging == NULL || oscillating == NULL) {
+        
+        fprintf(stderr, "c57_91_validation: out of memory\n");
+        return EXIT_FAILURE;
+    }
+    
+    // the cases that the reference cannot finish are replaced by new draws, and listed; the ones that oscillate are kept, and marked
+    RandomState = Seed;
+    DiscardedCase *discarded = NULL;
+    int discardedCount = 0;
+    int oscillatingCount = 0;
+    int draw = 0;
+    for (int i = 0; i < CaseCount; i++) {
+        
+        RandomCase(&cases[i]);
+        ReferenceOutcome outcome;
+        while ((outcome = ReferenceRun(&cases[i], &reference[i])) != ReferenceValid && outcome != ReferenceOscillated) {
+            
+            DiscardedCase *newDiscarded = realloc(discarded, sizeof(DiscardedCase) * (size_t)(discardedCount + 1));
+            if (newDiscarded == NULL) {
+                
+                fprintf(stderr, "c57_91_validation: out of memory\n");
+                return EXIT_FAILURE;
+            }
+            
+            discarded = newDiscarded;
+            discarded[discardedCount] = (DiscardedCase){i, draw, outcome};
+            discardedCount += 1;
+            
+            draw += 1;
+            RandomCase(&cases[i]);
+        }
+        
+        oscillating[i] = outcome == ReferenceOscillated;
+        oscillatingCount += oscillating[i] ? 1 : 0;
+        draw += 1;
+    }
+    
+    const double referenceTime = TimeCorpus(cases, NULL, reference);
+    long referenceSteps = 0;
+    for (int i = 0; i < CaseCount; i++) {
+        
+        referenceSteps += reference[i].steps;
+    }
+    
+    printf("%d cases (seed %llu, %d discarded, %d oscillating), %.1f steps per case, reference %.3f s\n", CaseCount, Seed, discardedCount, oscillatingCount, (double)referenceSteps / CaseCount, referenceTime);
+    for (ReferenceOutcome outcome = ReferenceBrokeDown; outcome <= ReferenceUnfinished; outcome++) {
+        
+        int count = 0;
+        for (int d = 0; d < discardedCount; d++) {
+            
+            if (discarded[d].outcome == outcome) {
+                
+                if (count == 0) {
+                    
+                    printf("  discarded (%s): draws", ReferenceOutcomeNames[outcome]);
+                }
+                
+                printf(" %d (for case %d)", discarded[d].draw, discarded[d].caseIndex);
+                count += 1;
+            }
+        }
+        
+        if (count > 0) {
+            
+            printf("\n");
+        }
+    }
+    
+    if (oscillatingCount > 0) {
+        
+        printf("  kept (%s): cases", ReferenceOutcomeNames[ReferenceOscillated]);
+        for (int i = 0; i < CaseCount; i++) {
+            
+            if (oscillating[i]) {
+                
+                printf(" %d", i);
+            }
+        }
+        
+        printf("\n");
+    }
+    
+    printf("tolerances at p%g: hot-spot %.3g °C, top oil %.3g °C, aging %.3g (relative)\n", CheckedPercentile, HotspotTolerance, TopOilTolerance, AgingTolerance);
+    printf("tolerances for the worst case: hot-spot %.3g °C, top oil %.3g °C, aging %.3g (relative)\n\n", WorstHotspotTolerance, WorstTopOilTolerance, WorstAgingTolerance);
+    printf("%-12s %8s %9s %9s | %-31s | %-31s | %-31s | %s\n", "mode", "steps", "vs ref", "vs native", "max hot-spot, °C (p50 p95 p99 worst)", "max top oil, °C (p50 p95 p99 worst)", "aging, rel. (p50 p95 p99 worst)", "");
+    
+    double nativeTime = 0.0;
+    int failedRows = 0;
+    for (int m = 0; m < MODE_COUNT; m++) {
+        
+        const double modeTime = TimeCorpus(cases, &Modes[m], results);
+        if (m == 0) {
+            
+            nativeTime = modeTime;
+        }
+        
+        long steps = 0;
+        int fallbacks = 0;
+        for (int i = 0; i < CaseCount; i++) {
+            
+            steps += results[i].steps;
+            fallbacks += results[i].exactFallback ? 1 : 0;
+        }
+        
+        // the first row is the cases that settle, the second the ones whose top duct oil oscillates (if there are any)
+        for (int subset = 0; subset < (oscillatingCount > 0 ? 2 : 1); subset++) {
+            
+            int count = 0;
+            for (int i = 0; i < CaseCount; i++) {
+                
+                if (oscillating[i] != (subset == 1)) {
+                    
+                    continue;
+                }
+                
+                hotspot[count] = fabs(results[i].maxHotspot - reference[i].maxHotspot);
+                topOil[count] = fabs(results[i].maxTopOil - reference[i].maxTopOil);
+                aging[count] = fabs(results[i].agingFactor - reference[i].agingFactor) / reference[i].agingFactor;
+                count += 1;
+            }
+            
+            const DeviationSummary hotspotSummary = Summarize(hotspot, count);
+            const DeviationSummary topOilSummary = Summarize(topOil, count);
+            const DeviationSummary agingSummary = Summarize(aging, count);
+            
+            // NaN never passes
+            const bool passed = hotspotSummary.checked <= HotspotTolerance && topOilSummary.checked <= TopOilTolerance && agingSummary.checked <= AgingTolerance && hotspotSummary.worst <= WorstHotspotTolerance && topOilSummary.worst <= WorstTopOilTolerance && agingSummary.worst <= WorstAgingTolerance;
+            if (Modes[m].checked && !passed) {
+                
+                failedRows += 1;
+            }
+            
+            const char *status = !Modes[m].checked ? "baseline" : (passed ? "ok" : "FAIL");
+            if (subset == 0) {
+                
+                printf("%-12s %8.1f %8.2fx %8.2fx | %7.1e %7.1e %7.1e %7.1e | %7.1e %7.1e %7.1e %7.1e | %7.1e %7.1e %7.1e %7.1e | %s\n", Modes[m].name, (double)steps / CaseCount, referenceTime / modeTime, nativeTime / modeTime, hotspotSummary.p50, hotspotSummary.p95, hotspotSummary.p99, hotspotSummary.worst, topOilSummary.p50, topOilSummary.p95, topOilSummary.p99, topOilSummary.worst, agingSummary.p50, agingSummary.p95, agingSummary.p99, agingSummary.worst, status);
+            }
+            else {
+                
+                printf("%-12s %8s %4d exact fallbacks | %7.1e %7.1e %7.1e %7.1e | %7.1e %7.1e %7.1e %7.1e | %7.1e %7.1e %7.1e %7.1e | %s\n", "  oscillating", "", fallbacks, hotspotSummary.p50, hotspotSummary.p95, hotspotSummary.p99, hotspotSummary.worst, topOilSummary.p50, topOilSummary.p95, topOilSummary.p99, topOilSummary.worst, agingSummary.p50, agingSummary.p95, agingSummary.p99, agingSummary.worst, status);
+            }
+        }
+    }
+    
+    free(discarded);
+    free(cases);
+    free(reference);
+    free(results);
+    free(hotspot);
+    free(topOil);
+    free(aging);
+    free(oscillating);
+    
+    if (failedRows > 0) {
+        
+        fprintf(stderr, "c57_91_validation: %d row(s) exceeded the tolerances\n", failedRows);
+        return EXIT_FAILURE;
+    }
+    
+    return EXIT_SUCCESS;
+}